@@ -0,0 +1,197 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adaptive.h"
+
+#include "util.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <thread>
+
+// The host is overloaded beyond any of these
+static const double MaxOverrunShare = 0.02;  // of moves overrunning their time
+static const double MaxSteal        = 0.10;  // of cpu time
+static const double MaxPressure     = 10.0;  // % of time stalled on memory
+static const double MaxRunning      = 1.25;  // runnable threads per cpu
+
+// Read the first line of a procfs file, if it exists (Linux)
+static bool read_first_line(const char *fileName, char *buf, int size)
+{
+    FILE *in = fopen(fileName, "r");
+
+    if (!in)
+        return false;
+
+    const bool ok = fgets(buf, size, in) != nullptr;
+    fclose(in);
+    return ok;
+}
+
+AdaptiveConcurrency::AdaptiveConcurrency(const AdaptiveParams &ap)
+    : min(ap.min)
+    , max(ap.max)
+    , interval(ap.interval)
+    , cpus(std::max(1, (int)std::thread::hardware_concurrency()))
+    , active(ap.min)
+    , stopped(false)
+    , timeLosses(0)
+    , overruns(0)
+    , moves(0)
+    , runningSum(0)
+    , runningSamples(0)
+    , lastTotal(0)
+    , lastSteal(0)
+    , lastDecision(system_msec())
+{
+    // Prime the cpu time counters
+    read_host_load();
+}
+
+bool AdaptiveConcurrency::wait_active(int index)
+{
+    std::unique_lock lock(mtx);
+    cv.wait(lock, [&] { return stopped || index < active; });
+
+    return !stopped;
+}
+
+void AdaptiveConcurrency::record_game(bool timeLoss, int overrunMoves, int gameMoves)
+{
+    std::lock_guard lock(mtx);
+
+    timeLosses += timeLoss;
+    overruns += overrunMoves;
+    moves += gameMoves;
+}
+
+void AdaptiveConcurrency::stop()
+{
+    {
+        std::lock_guard lock(mtx);
+        stopped = true;
+    }
+
+    cv.notify_all();
+}
+
+// Load of the host since the last call. Unknown values are negative (no procfs).
+AdaptiveConcurrency::HostLoad AdaptiveConcurrency::read_host_load()
+{
+    HostLoad load = {.running = -1, .steal = -1, .pressure = -1};
+    char     buf[256];
+
+    if (runningSamples)
+        load.running = runningSum / runningSamples;
+    runningSum     = 0;
+    runningSamples = 0;
+
+    // cpu user nice system idle iowait irq softirq steal
+    uint64_t t[8];
+    if (read_first_line("/proc/stat", buf, sizeof(buf))
+        && sscanf(buf,
+                  "cpu %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64
+                  " %" SCNu64 " %" SCNu64 " %" SCNu64,
+                  &t[0],
+                  &t[1],
+                  &t[2],
+                  &t[3],
+                  &t[4],
+                  &t[5],
+                  &t[6],
+                  &t[7])
+               == 8) {
+        const uint64_t total = t[0] + t[1] + t[2] + t[3] + t[4] + t[5] + t[6] + t[7];
+
+        if (lastTotal && total > lastTotal)
+            load.steal = double(t[7] - lastSteal) / (total - lastTotal);
+
+        lastTotal = total;
+        lastSteal = t[7];
+    }
+
+    if (read_first_line("/proc/pressure/memory", buf, sizeof(buf)))
+        sscanf(buf, "some avg10=%lf", &load.pressure);
+
+    return load;
+}
+
+void AdaptiveConcurrency::tick()
+{
+    std::unique_lock lock(mtx);
+    char             buf[256];
+    int              running, threads;
+
+    // Sample the run queue, without counting the thread reading it
+    if (read_first_line("/proc/loadavg", buf, sizeof(buf))
+        && sscanf(buf, "%*f %*f %*f %d/%d", &running, &threads) == 2) {
+        runningSum += running - 1;
+        runningSamples++;
+    }
+
+    if (system_msec() - lastDecision < interval * 1000LL)
+        return;
+
+    const HostLoad load   = read_host_load();
+    const int      before = active;
+    std::string    reason;
+
+    if (timeLosses)
+        reason = format("%i time losses", timeLosses);
+    else if (overruns > MaxOverrunShare * moves)
+        reason = format("%i of %i moves overran their time", overruns, moves);
+    else if (load.steal > MaxSteal)
+        reason = format("steal time %.0f%%", load.steal * 100);
+    else if (load.pressure > MaxPressure)
+        reason = format("memory pressure %.1f%%", load.pressure);
+    else if (load.running > MaxRunning * cpus)
+        reason = format("run queue %.1f for %i cpus", load.running, cpus);
+
+    if (!reason.empty())
+        active = std::max(min, active - std::max(1, active / 4));
+    // Idle cores, or no way to know but games go well
+    else if (load.running < 0 ? moves > 0 : load.running + 1 <= cpus) {
+        active = std::min(max, active + 1);
+        reason = load.running < 0
+                     ? format("%i moves in time", moves)
+                     : format("run queue %.1f for %i cpus", load.running, cpus);
+    }
+
+    if (active != before) {
+        lastReason = format("%i -> %i: %s", before, active, reason);
+        printf("Adaptive concurrency: %s\n", lastReason.c_str());
+    }
+
+    const bool grown = active > before;
+    timeLosses = overruns = moves = 0;
+    lastDecision = system_msec();
+    lock.unlock();
+
+    if (grown)
+        cv.notify_all();
+}
+
+// Line for the tournament update
+std::string AdaptiveConcurrency::report()
+{
+    std::lock_guard lock(mtx);
+
+    return format("Adaptive concurrency: %i active of %i%s\n",
+                  active,
+                  max,
+                  lastReason.empty() ? "" : format(" (last change %s)", lastReason));
+}
@@ -0,0 +1,68 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "options.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// Adaptive concurrency (-adaptive): grows or shrinks the number of active workers within
+// [min, max], from the load of the host (run queue, steal time and memory pressure, read
+// from procfs where available) and from signals of the games played (time losses, and
+// moves that overran the time allotted). Workers beyond the active count are parked
+// between games, never stopped in the middle of one. It starts from the minimum, grows
+// by one worker per interval while the host has idle cores, and shrinks by a quarter as
+// soon as it is overloaded.
+class AdaptiveConcurrency
+{
+public:
+    AdaptiveConcurrency(const AdaptiveParams &ap);
+
+    // Park worker 'index' (from 0) while it is not active. Returns false once stopped.
+    bool wait_active(int index);
+
+    void        record_game(bool timeLoss, int overruns, int moves);
+    void        tick();  // called at regular intervals, by the main thread
+    void        stop();
+    std::string report();
+
+private:
+    struct HostLoad
+    {
+        double running;   // average number of runnable threads
+        double steal;     // fraction of cpu time stolen by the hypervisor
+        double pressure;  // share of time stalled on memory (PSI avg10), in %
+    };
+
+    const int               min, max, interval;
+    const int               cpus;
+    std::mutex              mtx;  // guards everything below
+    std::condition_variable cv;
+    int                     active;
+    bool                    stopped;
+    int                     timeLosses, overruns, moves;  // since the last decision
+    double                  runningSum;
+    int                     runningSamples;
+    uint64_t                lastTotal, lastSteal;  // from /proc/stat
+    int64_t                 lastDecision;
+    std::string             lastReason;
+
+    HostLoad read_host_load();
+};
@@ -0,0 +1,111 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "calibrate.h"
+
+#include "position.h"
+#include "util.h"
+
+#include <algorithm>
+#include <thread>
+
+// Number of random games played by one benchmark run, and number of runs (the fastest
+// run is kept, to filter out noise from other processes)
+static const int BenchGames = 40;
+static const int BenchRuns  = 3;
+
+// Plays BenchGames random renju games, checking every empty square for forbidden moves
+// before each black move. Returns the number of nodes (squares checked) visited, which
+// only depends on the seed.
+static int64_t bench_run(uint64_t seed)
+{
+    const int size  = 15;
+    int64_t   nodes = 0;
+    move_t    candidates[size * size];
+
+    for (int g = 0; g < BenchGames; g++) {
+        Position pos(size);
+
+        while (pos.get_moves_left() > 0) {
+            const Color turn  = pos.get_turn();
+            int         count = 0;
+
+            for (int x = 0; x < size; x++)
+                for (int y = 0; y < size; y++) {
+                    const move_t m = (move_t)((turn << 10) | POS(x, y));
+
+                    if (pos.is_legal_move(m) && !pos.check_forbidden_move(m))
+                        candidates[count++] = m;
+                    nodes++;
+                }
+
+            if (!count)
+                break;
+
+            pos.move(candidates[prng(seed) % count]);
+
+            if (pos.check_five_in_line_lastmove(turn == WHITE))
+                break;
+        }
+    }
+
+    return nodes;
+}
+
+double calibrate_speed(int threads)
+{
+    std::vector<double>      speed(threads, 0.0);
+    std::vector<std::thread> workers;
+
+    for (int i = 0; i < threads; i++)
+        workers.emplace_back([i, &speed] {
+            for (int r = 0; r < BenchRuns; r++) {
+                const int64_t start = system_msec();
+                const int64_t nodes = bench_run(0);
+                const int64_t time  = std::max<int64_t>(system_msec() - start, 1);
+
+                speed[i] = std::max(speed[i], (double)nodes / time);  // nodes/ms = knps
+            }
+        });
+
+    for (std::thread &th : workers)
+        th.join();
+
+    double sum = 0;
+    for (double s : speed)
+        sum += s;
+
+    return sum / threads;
+}
+
+void calibrate(CalibrateParams &cp, int threads, std::vector<EngineOptions> &eo)
+{
+    printf("Calibrating machine speed on %d thread(s)...\n", threads);
+
+    cp.speed  = calibrate_speed(threads);
+    cp.factor = cp.refSpeed / cp.speed;
+
+    printf("Calibration: speed %.0f knps, reference %.0f knps, time scale factor %.3f\n",
+           cp.speed,
+           cp.refSpeed,
+           cp.factor);
+
+    for (EngineOptions &e : eo) {
+        e.timeoutTurn  = (int64_t)(e.timeoutTurn * cp.factor);
+        e.timeoutMatch = (int64_t)(e.timeoutMatch * cp.factor);
+        e.increment    = (int64_t)(e.increment * cp.factor);
+    }
+}
@@ -0,0 +1,29 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include "options.h"
+
+#include <vector>
+
+// Runs a fixed, deterministic CPU benchmark (renju rule checking on random games) on
+// 'threads' threads at once, so that the machine is loaded as it will be during the
+// tournament. Returns the average speed of one thread, in kilo-nodes per second.
+double calibrate_speed(int threads);
+
+// Measure machine speed and derive cp.factor (reference speed / measured speed), then
+// scale the time controls of all engines by that factor.
+void calibrate(CalibrateParams &cp, int threads, std::vector<EngineOptions> &eo);
@@ -0,0 +1,293 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cgroup.h"
+
+#include "util.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+#ifdef __linux__
+    #include <dirent.h>
+    #include <fcntl.h>
+    #include <signal.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+
+// Period of the cpu.max quota (usec)
+static const int64_t QuotaPeriod = 100000;
+
+static std::once_flag cgroupInitFlag;
+static std::string    cgroupParent;  // directory in which engine cgroups are created
+static std::mutex     cgroupMtx;
+static int            cgroupCount = 0;
+static std::string    cgroupLeaf;  // cgroup this process moved to, empty if none
+
+static bool read_file(const std::string &fileName, std::string &content)
+{
+    FILE *f = fopen(fileName.c_str(), "r" FOPEN_TEXT);
+    if (!f)
+        return false;
+
+    char   buf[4096];
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    content.assign(buf, n);
+    return true;
+}
+
+static bool write_file(const std::string &fileName, const std::string &content)
+{
+    FILE *f = fopen(fileName.c_str(), "w" FOPEN_TEXT);
+    if (!f)
+        return false;
+
+    bool ok = fputs(content.c_str(), f) >= 0;
+    return fclose(f) == 0 && ok;
+}
+
+// Returns the cgroup v2 directory of this process, or an empty string if there is none
+static std::string cgroup_self_dir()
+{
+    std::string mountPoint, line;
+
+    // Find the cgroup2 mount point. Fields: id parent major:minor root mount-point
+    // options [optional fields] - fstype source super-options
+    if (FILE *f = fopen("/proc/self/mountinfo", "r" FOPEN_TEXT)) {
+        while (mountPoint.empty() && string_getline(line, f)) {
+            char mp[4096], fstype[64];
+            const char *sep = strstr(line.c_str(), " - ");
+
+            if (sep && sscanf(sep, " - %63s", fstype) == 1 && !strcmp(fstype, "cgroup2")
+                && sscanf(line.c_str(), "%*s %*s %*s %*s %4095s", mp) == 1)
+                mountPoint = mp;
+        }
+        fclose(f);
+    }
+
+    // Our own cgroup v2 is the line with hierarchy id 0: "0::/path"
+    std::string content;
+    if (mountPoint.empty() || !read_file("/proc/self/cgroup", content))
+        return "";
+
+    size_t pos = content.find("0::");
+    if (pos == std::string::npos || (pos > 0 && content[pos - 1] != '\n'))
+        return "";
+
+    size_t end = content.find('\n', pos);
+    return mountPoint + content.substr(pos + 3, end - pos - 3);
+}
+
+// Whether 'word' is one of the whitespace separated words of 'list'
+static bool has_word(const std::string &list, const char *word)
+{
+    const size_t n = strlen(word);
+
+    for (size_t pos = 0; (pos = list.find(word, pos)) != std::string::npos; pos += n)
+        if ((pos == 0 || isspace((unsigned char)list[pos - 1]))
+            && (pos + n == list.size() || isspace((unsigned char)list[pos + n])))
+            return true;
+
+    return false;
+}
+
+// Remove the leaf cgroup at exit. A cgroup can only be removed once empty, and we can
+// only move back to its parent once no child uses the cpu controller any more: so the
+// last instance to exit removes the leaves of all instances, and undoes '+cpu'.
+static void cgroup_remove_leaf()
+{
+    const std::string parent = cgroupLeaf.substr(0, cgroupLeaf.rfind('/'));
+    bool              others = false;
+
+    if (DIR *d = opendir(parent.c_str())) {
+        while (struct dirent *e = readdir(d)) {
+            const std::string child = parent + "/" + e->d_name;
+
+            if (e->d_type != DT_DIR || e->d_name[0] == '.' || child == cgroupLeaf)
+                continue;
+
+            // Only remove leaves of instances that exited before us: a live instance
+            // may have created its leaf, and not moved itself into it yet
+            const char *pidStr = string_prefix(e->d_name, "c-gomoku-cli.");
+            char       *end    = nullptr;
+            const long  pid    = pidStr ? strtol(pidStr, &end, 10) : 0;
+
+            if (pid <= 0 || *end || kill((pid_t)pid, 0) == 0 || errno != ESRCH
+                || rmdir(child.c_str()) < 0)
+                others = true;
+        }
+        closedir(d);
+    }
+
+    if (!others && write_file(parent + "/cgroup.subtree_control", "-cpu")
+        && write_file(parent + "/cgroup.procs", "0"))
+        rmdir(cgroupLeaf.c_str());
+}
+
+// Locate our cgroup, and enable the cpu controller for its children. A cgroup with
+// processes can not distribute resources to its children, so we first move ourselves
+// to a leaf cgroup if needed (like container runtimes do).
+static void cgroup_init()
+{
+    std::string self = cgroup_self_dir(), controllers;
+    const char *error = nullptr;
+
+    if (self.empty())
+        error = "no cgroup v2 hierarchy";
+    else if (!read_file(self + "/cgroup.controllers", controllers)
+             || !has_word(controllers, "cpu"))
+        error = "cpu controller not available";
+    else if (!write_file(self + "/cgroup.subtree_control", "+cpu")) {
+        std::string leaf = format("%s/c-gomoku-cli.%d", self, (int)getpid());
+
+        if ((mkdir(leaf.c_str(), 0755) < 0 && errno != EEXIST)
+            || !write_file(leaf + "/cgroup.procs", "0"))
+            error = "cgroup not writable";
+        else {
+            cgroupLeaf = leaf;
+            atexit(cgroup_remove_leaf);
+
+            if (!write_file(self + "/cgroup.subtree_control", "+cpu"))
+                error = "cgroup not writable";
+        }
+    }
+
+    if (error)
+        printf("warning: cannot use cgroups for cpu quotas (%s), running engines "
+               "without quota\n",
+               error);
+    else
+        cgroupParent = self;
+}
+
+CpuGroup::CpuGroup(int id) : threadId(id), procsFd(-1), quota(0), startTime(0) {}
+
+CpuGroup::~CpuGroup()
+{
+    destroy();
+}
+
+bool CpuGroup::create(double q)
+{
+    std::call_once(cgroupInitFlag, cgroup_init);
+
+    if (cgroupParent.empty())
+        return false;
+
+    destroy();
+
+    {
+        std::lock_guard lock(cgroupMtx);
+        path = format("%s/engine.%d.%d", cgroupParent, (int)getpid(), ++cgroupCount);
+    }
+
+    const int64_t quotaUsec = std::max<int64_t>((int64_t)(q * QuotaPeriod), 1000);
+    std::string   cpuMax    = format("%" PRId64 " %" PRId64, quotaUsec, QuotaPeriod);
+    std::string   readBack, stat;
+
+    // Verify that the quota is in place, and that cpu.stat reports usage for it
+    if (mkdir(path.c_str(), 0755) < 0 || !write_file(path + "/cpu.max", cpuMax)
+        || !read_file(path + "/cpu.max", readBack)
+        || readBack.compare(0, cpuMax.size(), cpuMax)
+        || !read_file(path + "/cpu.stat", stat)
+        || (procsFd = open((path + "/cgroup.procs").c_str(), O_WRONLY | O_CLOEXEC)) < 0) {
+        printf("[%d] warning: cannot set cpu quota in '%s': %s\n",
+               threadId,
+               path.c_str(),
+               strerror(errno));
+        destroy();
+        return false;
+    }
+
+    quota     = q;
+    startTime = system_msec();
+    return true;
+}
+
+void CpuGroup::attach_self() const
+{
+    if (procsFd >= 0 && write(procsFd, "0", 1) < 0)
+        _exit(EXIT_FAILURE);
+}
+
+void CpuGroup::kill() const
+{
+    if (!path.empty())
+        write_file(path + "/cgroup.kill", "1");  // Linux >= 5.14, best effort
+}
+
+void CpuGroup::destroy()
+{
+    if (path.empty())
+        return;
+
+    if (procsFd >= 0) {
+        close(procsFd);
+        procsFd = -1;
+    }
+
+    // Actual cpu usage must not exceed the quota (with some slack for accounting)
+    std::string   stat;
+    long long     usageUsec = 0;
+    const int64_t elapsed   = system_msec() - startTime;
+    const char   *usage;
+
+    if (read_file(path + "/cpu.stat", stat)
+        && (usage = strstr(stat.c_str(), "usage_usec"))
+        && sscanf(usage, "usage_usec %lld", &usageUsec) == 1 && elapsed > 1000
+        && usageUsec / 1000.0 > elapsed * quota * 1.1 + QuotaPeriod / 1000)
+        printf("[%d] warning: cpu quota of %g not enforced (%.1fs used in %.1fs)\n",
+               threadId,
+               quota,
+               usageUsec / 1e6,
+               elapsed / 1e3);
+
+    // Exited (zombie) processes do not keep the cgroup busy, but processes that were
+    // just killed may still be running for a short while
+    for (int retry = 0; rmdir(path.c_str()) < 0 && errno == EBUSY && retry < 50; retry++)
+        system_sleep(10);
+
+    path.clear();
+}
+
+#else
+
+CpuGroup::CpuGroup(int id) : threadId(id), procsFd(-1), quota(0), startTime(0) {}
+
+CpuGroup::~CpuGroup() {}
+
+bool CpuGroup::create([[maybe_unused]] double q)
+{
+    static std::once_flag warnFlag;
+    std::call_once(warnFlag, [] {
+        printf("warning: cpu quotas need cgroups (Linux), running engines without "
+               "quota\n");
+    });
+    return false;
+}
+
+void CpuGroup::attach_self() const {}
+
+void CpuGroup::kill() const {}
+
+void CpuGroup::destroy() {}
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Per-engine CPU budget, enforced by a cgroup v2 'cpu.max' quota (Linux only). Each
+// engine process gets its own cgroup, created as a sibling of the cgroup this process
+// runs in. When cgroups are not available or not writable, a warning is printed once
+// and engines run without quota.
+class CpuGroup
+{
+public:
+    explicit CpuGroup(int threadId);
+    CpuGroup(const CpuGroup &) = delete;
+    ~CpuGroup();
+
+    // Create a cgroup whose processes may use up to 'quota' cores (eg. 0.5 for half of
+    // a core). Returns false when the quota can not be enforced.
+    bool create(double quota);
+
+    // Move the calling process into the cgroup. Only async-signal-safe functions are
+    // used, as it is called in a forked child before exec.
+    void attach_self() const;
+
+    // Kill every process in the cgroup (including engine subprocesses)
+    void kill() const;
+
+    // Check that the quota has been honoured, then delete the cgroup. Must be called
+    // after the engine process has exited.
+    void destroy();
+
+    bool is_active() const { return !path.empty(); }
+
+private:
+    const int   threadId;
+    std::string path;       // cgroup directory, empty if none
+    int         procsFd;    // open 'cgroup.procs' of the cgroup, for attach_self()
+    double      quota;      // cores
+    int64_t     startTime;  // msec
+};
@@ -0,0 +1,401 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cluster.h"
+
+#include "util.h"
+
+#ifndef __MINGW32__
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <sys/time.h>
+    #include <unistd.h>
+#endif
+
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+
+std::string cluster_file_name(const std::string &dir, size_t batch, const char *name)
+{
+    return format("%s/batch.%zu.%s", dir, batch, name);
+}
+
+std::string cluster_output_name(const std::string &dir,
+                                size_t             batch,
+                                const std::string &node,
+                                JournalOutput      o)
+{
+    static const char *Outputs[NB_JOURNAL] = {"pgn", "sgf", "msg", "sample"};
+    return format("%s/batch.%zu.%s.%s", dir, batch, node, Outputs[o]);
+}
+
+#ifndef __MINGW32__
+// Interval (msec) between two looks at the directory, while other nodes hold all batches
+static const int64_t PollInterval = 2000;
+
+// Create a file, unless it exists, and sync it. Returns false if it exists.
+static bool create_exclusive(const std::string &path, const std::string &content)
+{
+    const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+
+    if (fd < 0) {
+        DIE_IF(0, errno != EEXIST);
+        return false;
+    }
+
+    FILE *f;
+    DIE_IF(0, !(f = fdopen(fd, "w")));
+    fputs(content.c_str(), f);
+    DIE_IF(0, !file_sync(f));
+    DIE_IF(0, fclose(f) != 0);
+    return true;
+}
+
+// First line of a file, if it exists
+static bool read_first_line(const std::string &path, std::string &line)
+{
+    FILE *f = fopen(path.c_str(), "r");
+
+    if (!f)
+        return false;
+
+    string_getline(line, f);
+    fclose(f);
+    return true;
+}
+
+static std::string node_name()
+{
+    char host[256] = "";
+    gethostname(host, sizeof(host) - 1);
+    return format("%s-%d", host, (int)getpid());
+}
+
+ClusterQueue::ClusterQueue(const ClusterParams &cl,
+                           const std::string   &config,
+                           JobQueue            *q,
+                           const SPRTParam     *s)
+    : dir(cl.dir)
+    , node(node_name())
+    , batchSize(cl.batch)
+    , batches((q->size() + cl.batch - 1) / cl.batch)
+    , lease(cl.lease)
+    , jq(q)
+    , sprt(s)
+    , doneBy(batches)
+    , busyUntil(batches)
+    , firstOpen(0)
+    , results(nullptr)
+    , over(false)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+
+    // The first node defines the tournament
+    std::string existing;
+    if (!create_exclusive(dir + "/config", config + "\n")
+        && (!read_first_line(dir + "/config", existing) || existing != config))
+        DIE("cluster directory %s holds a different tournament\n", dir.c_str());
+
+    DIE_IF(0, !(results = fopen((dir + "/results." + node).c_str(), "a")));
+
+    printf("Cluster node %s joined %s\n", node.c_str(), dir.c_str());
+    leaseThread = std::thread(&ClusterQueue::renew_leases, this);
+}
+
+ClusterQueue::~ClusterQueue()
+{
+    over = true;
+    leaseThread.join();
+
+    if (results)
+        fclose(results);
+}
+
+bool ClusterQueue::is_done(size_t b)
+{
+    // The name of the winner may not be written yet
+    return !doneBy[b].empty()
+        || (read_first_line(cluster_file_name(dir, b, "done"), doneBy[b])
+            && !doneBy[b].empty());
+}
+
+// Claim batch b, taking it over from a dead node if needed. Returns false if it is done,
+// or claimed by a live node.
+bool ClusterQueue::claim(size_t b)
+{
+    const std::string claimFile = cluster_file_name(dir, b, "claim");
+
+    if (time(nullptr) < busyUntil[b] || is_done(b))
+        return false;
+
+    if (create_exclusive(claimFile, node + "\n"))
+        return true;
+
+    // Claimed by another node: its lease runs from the last time it touched the file
+    struct stat st;
+    if (stat(claimFile.c_str(), &st) < 0)
+        return false;
+
+    if (time(nullptr) - st.st_mtime <= lease) {
+        busyUntil[b] = st.st_mtime + lease;
+        return false;
+    }
+
+    // Only one node can rename the stale claim away
+    const std::string staleFile = claimFile + ".stale." + node;
+    std::string       owner;
+
+    if (rename(claimFile.c_str(), staleFile.c_str()) < 0)
+        return false;
+
+    read_first_line(staleFile, owner);
+    unlink(staleFile.c_str());
+
+    if (is_done(b) || !create_exclusive(claimFile, node + "\n"))
+        return false;
+
+    printf("[cluster] took over batch %zu from %s\n", b, owner.c_str());
+    return true;
+}
+
+bool ClusterQueue::pop(RemoteJob &rj)
+{
+    std::unique_lock lock(mtx);
+
+    while (!over) {
+        for (Batch &batch : active)
+            if (batch.next < batch.end) {
+                rj.idx   = batch.next++;
+                rj.job   = jq->job_at(rj.idx);
+                rj.count = jq->size();
+                return true;
+            }
+
+        scan();
+
+        if (jq->finished()) {
+            over = true;
+            break;
+        }
+
+        // Claim the first batch that is neither done nor held by a live node
+        while (firstOpen < batches && is_done(firstOpen))
+            firstOpen++;
+
+        bool claimed = false;
+
+        for (size_t b = firstOpen; b < batches && !claimed; b++) {
+            bool mine = false;
+
+            for (const Batch &batch : active)
+                mine |= batch.index == b;
+
+            if (!mine && claim(b)) {
+                const size_t first = b * batchSize;
+                const size_t end   = std::min(first + batchSize, jq->size());
+
+                active.push_back({.index     = b,
+                                  .next      = first,
+                                  .end       = end,
+                                  .remaining = end - first,
+                                  .records   = std::vector<GameRecord>(end - first)});
+                claimed = true;
+            }
+        }
+
+        if (!claimed && firstOpen == batches) {
+            over = true;
+            break;
+        }
+
+        // Other nodes (or our other threads) hold the remaining batches: wait for them to
+        // finish, or to die
+        if (!claimed) {
+            lock.unlock();
+            system_sleep(PollInterval);
+            lock.lock();
+        }
+    }
+
+    return false;
+}
+
+void ClusterQueue::push(const GameRecord &r)
+{
+    std::lock_guard lock(mtx);
+
+    fprintf(results,
+            "game %zu %d\t%s\t%s\n",
+            r.idx,
+            r.outcome,
+            r.names[0].c_str(),
+            r.names[1].c_str());
+    DIE_IF(0, !file_sync(results));
+
+    for (auto it = active.begin(); it != active.end(); ++it)
+        if (r.idx >= it->index * batchSize && r.idx < it->end) {
+            it->records[r.idx - it->index * batchSize] = r;
+
+            if (--it->remaining == 0) {
+                complete(*it);
+                active.erase(it);
+            }
+            break;
+        }
+}
+
+// Write the outputs of a completed batch, then try to win it
+void ClusterQueue::complete(Batch &batch)
+{
+    std::string files[NB_JOURNAL];
+
+    for (int o = 0; o < NB_JOURNAL; o++) {
+        std::string data;
+
+        for (const GameRecord &r : batch.records)
+            data += o == JOURNAL_PGN   ? r.pgn
+                  : o == JOURNAL_SGF   ? r.sgf
+                  : o == JOURNAL_MSG   ? r.msg
+                                       : r.samples;
+
+        if (data.empty())
+            continue;
+
+        files[o] = cluster_output_name(dir, batch.index, node, (JournalOutput)o);
+
+        FILE *f;
+        DIE_IF(0, !(f = fopen(files[o].c_str(), "w")));
+        DIE_IF(0, fwrite(data.data(), 1, data.size(), f) != data.size());
+        DIE_IF(0, !file_sync(f));
+        DIE_IF(0, fclose(f) != 0);
+    }
+
+    // Another node may have completed it first, if it took the batch over from us
+    if (create_exclusive(cluster_file_name(dir, batch.index, "done"), node + "\n"))
+        doneBy[batch.index] = node;
+    else {
+        for (const std::string &file : files)
+            if (!file.empty())
+                unlink(file.c_str());
+    }
+
+    unlink(cluster_file_name(dir, batch.index, "claim").c_str());
+}
+
+// Count results of all nodes, for batches that they won
+void ClusterQueue::scan()
+{
+    std::error_code ec;
+
+    if (std::filesystem::exists(dir + "/stop", ec))
+        jq->stop();
+
+    for (const auto &entry : std::filesystem::directory_iterator(dir, ec)) {
+        const std::string name = entry.path().filename().string();
+        const char       *resultsNode;
+
+        if (!(resultsNode = string_prefix(name.c_str(), "results.")))
+            continue;
+
+        FILE *in = fopen(entry.path().string().c_str(), "r");
+        if (!in)
+            continue;
+
+        long       &offset = scanned[name];
+        std::string line;
+        size_t      n;
+        NodeResult  nr = {.node = resultsNode, .idx = 0, .outcome = 0, .names = {}};
+
+        // A line being written by another node is read next time
+        fseek(in, offset, SEEK_SET);
+        while ((n = string_getline(line, in)) > line.size()) {
+            const size_t tab1 = line.find('\t'), tab2 = line.find('\t', tab1 + 1);
+
+            if (sscanf(line.c_str(), "game %zu %d", &nr.idx, &nr.outcome) == 2
+                && nr.idx < jq->size() && tab2 != std::string::npos) {
+                nr.names[0] = line.substr(tab1 + 1, tab2 - tab1 - 1);
+                nr.names[1] = line.substr(tab2 + 1);
+                pending.push_back(nr);
+            }
+            offset = ftell(in);
+        }
+
+        fclose(in);
+    }
+
+    Result res = {};
+    size_t counted = 0;
+
+    for (auto it = pending.begin(); it != pending.end();) {
+        const size_t b = it->idx / batchSize;
+
+        if (!is_done(b))
+            ++it;
+        else {
+            if (doneBy[b] == it->node) {
+                const Job job = jq->job_at(it->idx);
+                jq->set_name(job.ei[0], it->names[0]);
+                jq->set_name(job.ei[1], it->names[1]);
+                jq->resume(it->idx, it->outcome, res);
+                counted++;
+            }
+            it = pending.erase(it);
+        }
+    }
+
+    if (counted) {
+        jq->print_results(1, 1);
+
+        if (sprt && sprt->done(res)) {
+            jq->stop();
+            create_exclusive(dir + "/stop", node + "\n");
+        }
+    }
+}
+
+void ClusterQueue::renew_leases()
+{
+    for (int64_t last = system_msec(); !over; system_sleep(100))
+        if (system_msec() - last >= lease * 1000 / 4) {
+            std::lock_guard lock(mtx);
+
+            for (const Batch &batch : active)
+                utimes(cluster_file_name(dir, batch.index, "claim").c_str(), nullptr);
+
+            last = system_msec();
+        }
+}
+
+#else
+
+ClusterQueue::ClusterQueue(const ClusterParams &,
+                           const std::string &,
+                           JobQueue *,
+                           const SPRTParam *)
+    : batchSize(0)
+    , batches(0)
+    , lease(0)
+{
+    DIE("-cluster is not supported on Windows\n");
+}
+
+ClusterQueue::~ClusterQueue() {}
+bool ClusterQueue::pop(RemoteJob &) { return false; }
+void ClusterQueue::push(const GameRecord &) {}
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "jobs.h"
+#include "journal.h"
+#include "options.h"
+#include "remote.h"
+#include "sprt.h"
+
+#include <atomic>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Files of a cluster directory:
+//   config                        tournament configuration, which all nodes must share
+//   batch.<b>.claim               batch b is being played by the node named in it, which
+//                                 touches the file to renew its lease
+//   batch.<b>.done                batch b was completed by the node named in it
+//   batch.<b>.<node>.<output>     outputs of batch b, in game order: pgn, sgf, msg or
+//                                 sample
+//   results.<node>                outcome of each game played by a node, with the names
+//                                 of its engines
+//   stop                          the tournament was stopped (SPRT)
+std::string cluster_file_name(const std::string &dir, size_t batch, const char *name);
+std::string cluster_output_name(const std::string &dir,
+                                size_t             batch,
+                                const std::string &node,
+                                JournalOutput      o);
+
+// Cluster queue: jobs of a tournament shared by any number of processes through a
+// directory, with no other communication (thread safe). Jobs are claimed by batches of
+// consecutive games, with files created atomically. A claim whose lease is not renewed
+// (the node died) is taken over by another node, and the first node to complete a batch
+// wins it. Results of all nodes are counted in the JobQueue, which only serves as a
+// tally.
+class ClusterQueue
+{
+public:
+    ClusterQueue(const ClusterParams &cl,
+                 const std::string   &config,
+                 JobQueue            *jq,
+                 const SPRTParam     *sprt);
+    ~ClusterQueue();
+
+    bool pop(RemoteJob &rj);  // false once all batches are done, or stopped
+    void push(const GameRecord &r);
+    bool done() const { return over; }
+    void stop() { over = true; }  // no more jobs, results are still written
+
+private:
+    // Batch claimed by this node
+    struct Batch
+    {
+        size_t                  index, next, end;  // next job to dispense, and end
+        size_t                  remaining;         // games not recorded yet
+        std::vector<GameRecord> records;           // [idx - first game of the batch]
+    };
+
+    // Result read from results.<node>, counted once its batch is done by that node
+    struct NodeResult
+    {
+        std::string node;
+        size_t      idx;
+        int         outcome;
+        std::string names[2];
+    };
+
+    const std::string dir, node;
+    const size_t      batchSize, batches;
+    const int         lease;  // seconds
+    JobQueue         *jq;
+    const SPRTParam  *sprt;
+
+    std::mutex                  mtx;  // guards everything below
+    std::vector<Batch>          active;
+    std::vector<std::string>    doneBy;     // [batch]: winner, once known
+    std::vector<time_t>         busyUntil;  // [batch]: lease of another node
+    size_t                      firstOpen;  // batches before are all done
+    std::map<std::string, long> scanned;    // results file -> offset read
+    std::vector<NodeResult>     pending;
+    FILE                       *results;
+    std::atomic<bool>           over;
+    std::thread                 leaseThread;
+
+    bool claim(size_t b);
+    void complete(Batch &batch);
+    bool is_done(size_t b);
+    void scan();
+    void renew_leases();
+};
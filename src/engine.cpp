@@ -14,429 +14,150 @@
  * program. If not, see <http://www.gnu.org/licenses/>.
  */
 
-#if defined(__MINGW32__)
-    #include <fcntl.h>
-    #include <io.h>
-    #include <windows.h>
-#elif defined(__linux__)
-    #define _GNU_SOURCE
-    #include <fcntl.h>
-    #include <sys/prctl.h>
-    #include <sys/wait.h>
-    #include <unistd.h>
-#else
-    #include <sys/wait.h>
-    #include <unistd.h>
-#endif
-
 #include "engine.h"
 #include "position.h"
+#include "shmchannel.h"
+#include "transport.h"
 #include "util.h"
 #include "workers.h"
 
+#include <atomic>
 #include <cassert>
 #include <climits>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
-#include <mutex>
-#include <signal.h>
 #include <sstream>
 #include <vector>
 
-#ifdef __MINGW32__
-// Argument quoting is non trivial on Windows: we need to take care of character
-// escaping, and better only add quotes when it is actually needed. Adopted from
-// <https://docs.microsoft.com/en-gb/archive/blogs/twistylittlepassagesallalike/everyone-quotes-command-line-arguments-the-wrong-way>
-static std::string argvQuote(std::string_view arg)
-{
-    std::string cmdline;
-
-    // Don't quote unless we actually need to do so -- hopefully
-    // avoid problems if programs won't parse quotes properly
-    if (!arg.empty() && arg.find_first_of(" \t\n\v\"") == arg.npos)
-        cmdline = arg;
-    else {
-        cmdline.push_back('"');
-
-        for (auto it = arg.begin();; ++it) {
-            unsigned numBlackslashes = 0;
-
-            while (it != arg.end() && *it == '\\') {
-                ++it;
-                ++numBlackslashes;
-            }
-
-            // Escape all backslashes, but let the terminating double quotation
-            // mark we add below be interpreted as a metacharacter.
-            if (it == arg.end()) {
-                cmdline.append(numBlackslashes * 2, '\\');
-                break;
-            }
-            // Escape all backslashes and the following double quotation mark.
-            else if (*it == '"')
-                cmdline.append(numBlackslashes * 2 + 1, '\\').push_back(*it);
-            // Backslashes aren't special here.
-            else
-                cmdline.append(numBlackslashes, '\\').push_back(*it);
-        }
-
-        cmdline.push_back('"');
-    }
-
-    return cmdline;  // NRVO
-}
+#ifdef __linux__
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
 #endif
 
 Engine::Engine(Worker *worker, bool debug, std::string *outmsg)
     : w(worker)
     , isDebug(debug)
-    , in(nullptr)
-    , out(nullptr)
+    , tp(nullptr)
     , messages(outmsg)
     , tolerance(0)
-    , pid(0)
+    , lineTime(0)
+    , startupWait(0)
+    , starting(false)
+    , linesSent(0)
+    , shm(nullptr)
+    , shmActive(false)
 {}
 
 Engine::~Engine()
 {
     terminate();
+    delete tp;
+    shm_release();
 }
 
-void Engine::spawn(const char *cwd, const char *run, char **argv, bool readStdErr)
+void Engine::start(const EngineOptions &eo)
 {
-    assert(argv[0]);
-
-#ifdef __MINGW32__
-    // Setup the global job handle and job info, then bind parent process to it.
-    // (This will only be called once)
-    [[maybe_unused]] static HANDLE handleJob = [this]() {
-        HANDLE hJob = CreateJobObject(NULL, NULL);
-        DIE_IF(w->id, !hJob);
-
-        JOBOBJECT_BASIC_LIMIT_INFORMATION    jobBasicInfo;
-        JOBOBJECT_EXTENDED_LIMIT_INFORMATION jobExtendedInfo;
-        ZeroMemory(&jobBasicInfo, sizeof(JOBOBJECT_BASIC_LIMIT_INFORMATION));
-        ZeroMemory(&jobExtendedInfo, sizeof(JOBOBJECT_EXTENDED_LIMIT_INFORMATION));
-
-        jobBasicInfo.LimitFlags               = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
-        jobExtendedInfo.BasicLimitInformation = jobBasicInfo;
-        DIE_IF(w->id,
-               !SetInformationJobObject(hJob,
-                                        JobObjectExtendedLimitInformation,
-                                        &jobExtendedInfo,
-                                        sizeof(JOBOBJECT_EXTENDED_LIMIT_INFORMATION)));
-
-        DIE_IF(w->id, !AssignProcessToJobObject(hJob, GetCurrentProcess()));
-        return hJob;
-    }();
-
-    // Setup structs needed to create process
-    SECURITY_ATTRIBUTES saAttr;
-    saAttr.nLength              = sizeof(SECURITY_ATTRIBUTES);
-    saAttr.bInheritHandle       = TRUE;
-    saAttr.lpSecurityDescriptor = NULL;
-    PROCESS_INFORMATION piProcInfo;
-    STARTUPINFOA        siStartInfo;
-    ZeroMemory(&piProcInfo, sizeof(PROCESS_INFORMATION));
-    ZeroMemory(&siStartInfo, sizeof(STARTUPINFOA));
-    siStartInfo.cb = sizeof(STARTUPINFOA);
-    siStartInfo.dwFlags |= STARTF_USESTDHANDLES;
-
-    // Construct full commandline using run and argv
-    std::string fullrun, fullcmd;
-    fullrun = format("%s%s", cwd, run + 1);  // we need an path relative to the cli
-
-    // Note: all arguments in argv needs to quoted
-    // Use an absolute path for engine argv[0]
-    char absPathBuf[4096];
-    DIE_IF(w->id,
-           !GetFullPathNameA(fullrun.c_str(), sizeof(absPathBuf), absPathBuf, nullptr));
-
-    fullcmd = argvQuote(absPathBuf);
-    for (size_t i = 1; argv[i]; i++)  // argv[0] == run
-        fullcmd += format(" %s", argvQuote(argv[i]));
-
-    // Pipe handler: read=0, write=1
-    HANDLE p_stdin[2], p_stdout[2];
-
-    // Process and pipe creation should be sequential to avoid handle inheritance bug
-    static std::mutex mtx;
-    {
-        std::lock_guard<std::mutex> lock(mtx);
-
-        // Create a pipe for child process's STDOUT
-        DIE_IF(w->id, !CreatePipe(&p_stdout[0], &p_stdout[1], &saAttr, 0));
-        DIE_IF(w->id, !SetHandleInformation(p_stdout[0], HANDLE_FLAG_INHERIT, 0));
-
-        // Create a pipe for child process's STDIN
-        DIE_IF(w->id, !CreatePipe(&p_stdin[0], &p_stdin[1], &saAttr, 0));
-        DIE_IF(w->id, !SetHandleInformation(p_stdin[1], HANDLE_FLAG_INHERIT, 0));
-
-        // Create the child process
-        siStartInfo.hStdOutput = p_stdout[1];
-        siStartInfo.hStdInput  = p_stdin[0];
-        if (readStdErr) {
-            HANDLE p_stderr;
-            DIE_IF(w->id,
-                   !DuplicateHandle(GetCurrentProcess(),
-                                    p_stdout[1],
-                                    GetCurrentProcess(),
-                                    &p_stderr,
-                                    0,
-                                    TRUE,
-                                    DUPLICATE_SAME_ACCESS));
-            siStartInfo.hStdError = p_stderr;
-        }
+    if (eo.cmd.empty())
+        DIE("[%d] missing command to start engine.\n", w->id);
 
-        const int flag = CREATE_NO_WINDOW | BELOW_NORMAL_PRIORITY_CLASS;
-        if (!CreateProcessA(fullrun.c_str(),  // application name
-                            fullcmd.data(),   // command line (non-const)
-                            nullptr,          // process security attributes
-                            nullptr,          // primary thread security attributes
-                            true,             // handles are inherited
-                            flag,             // creation flags
-                            nullptr,          // use parent's environment
-                            cwd,              // child process's current directory
-                            &siStartInfo,     // STARTUPINFO pointer
-                            &piProcInfo       // receives PROCESS_INFORMATION
-                            )) {
-            // Give a more elaborated error report on wrong engine path
-            DIE_OR_ERR(false, "[%d] failed to load engine \"%s\"\n", w->id, run);
-            DIE_IF(w->id, true);  // extra error message from OS
-        }
+    this->name      = eo.name;
+    this->tolerance = eo.tolerance;
 
-        // Close handles to the stdin and stdout pipes no longer needed
-        DIE_IF(w->id, !CloseHandle(p_stdin[0]));
-        DIE_IF(w->id, !CloseHandle(p_stdout[1]));
+    // Wait for our turn to start. The time spent waiting tells how loaded the machine
+    // is with other engines starting, so handshake deadlines are extended by as much.
+    if (!starting) {
+        startupWait = w->startup_enter();
+        starting    = true;
     }
 
-    // Keep the handle to the child process
-    this->pid      = piProcInfo.dwProcessId;
-    this->hProcess = piProcInfo.hProcess;
-    // Close the handle to the child's primary thread
-    DIE_IF(w->id, !CloseHandle(piProcInfo.hThread));
-
-    // Reopen stdin and stdout pipes using C style FILE
-    int stdin_fd  = _open_osfhandle((intptr_t)p_stdin[1], _O_TEXT);
-    int stdout_fd = _open_osfhandle((intptr_t)p_stdout[0], _O_TEXT);
-    DIE_IF(w->id, stdin_fd == -1);
-    DIE_IF(w->id, stdout_fd == -1);
-    DIE_IF(w->id, !(this->in = _fdopen(stdout_fd, "r")));
-    DIE_IF(w->id, !(this->out = _fdopen(stdin_fd, "w")));
-
-    // Bind child process to the global job, so child process is killed when
-    // parent process exits. (This is not needed actually, when parent process
-    // already belongs to one job, all subprocesses it creates will automatically
-    // be binded to the job by default).
-    // DIE_IF(w->id, !AssignProcessToJobObject(handleJob, this->hProcess));
+    // Previous transport (if any) has been terminated. It is only released here, as a
+    // force terminate from the main thread may race with a readln() in this thread.
+    delete tp;
+    shm_release();
+    linesSent = 0;
+
+    if (eo.host.empty())
+        tp = new PipeTransport(w->id);
+    else {
+#ifdef __MINGW32__
+        DIE("[%d] remote engines are not supported on Windows\n", w->id);
 #else
-    // Pipe diagram: Parent -> [1]into[0] -> Child -> [1]outof[0] -> Parent
-    // 'into' and 'outof' are pipes, each with 2 ends: read=0, write=1
-    int outof[2] = {0}, into[2] = {0};
-
-    #ifdef __linux__
-    DIE_IF(w->id, pipe2(outof, O_CLOEXEC) < 0);
-    DIE_IF(w->id, pipe2(into, O_CLOEXEC) < 0);
-    #else
-    DIE_IF(w->id, pipe(outof) < 0);
-    DIE_IF(w->id, pipe(into) < 0);
-    #endif
-
-    DIE_IF(w->id, (this->pid = fork()) < 0);
-
-    if (this->pid == 0) {
-    #ifdef __linux__
-        prctl(PR_SET_PDEATHSIG, SIGHUP);  // delegate zombie purge to the kernel
-    #endif
-        // Plug stdin and stdout
-        DIE_IF(w->id, dup2(into[0], STDIN_FILENO) < 0);
-        DIE_IF(w->id, dup2(outof[1], STDOUT_FILENO) < 0);
-
-        // For stderr we have 2 choices:
-        // - readStdErr=true: dump it into stdout, like doing '2>&1' in bash. This is
-        // useful, if we want to see error messages from engines in their respective log
-        // file (notably assert() writes to stderr). Of course, such error messages should
-        // not be UCI commands, otherwise we will be fooled into parsing them as such.
-        // - readStdErr=false: do nothing, which means stderr is inherited from the parent
-        // process. Typcically, this means all engines write their error messages to the
-        // terminal (unless redirected otherwise).
-        if (readStdErr)
-            DIE_IF(w->id, dup2(outof[1], STDERR_FILENO) < 0);
-
-    #ifndef __linux__
-        // Ugly (and slow) workaround for non-Linux POSIX systems that lack the ability to
-        // atomically set O_CLOEXEC when creating pipes.
-        for (int fd = 3; fd < sysconf(FOPEN_MAX); close(fd++))
-            ;
-    #endif
-
-        // Set cwd as current directory, and execute run with argv[]
-        DIE_IF(w->id, chdir(cwd) < 0);
-        DIE_IF(w->id, execvp(run, argv) < 0);
+        tp = new TcpTransport(w->id, eo.host.c_str(), eo.token, tolerance);
+#endif
     }
-    else {
-        assert(this->pid > 0);
 
-        // in the parent process
-        DIE_IF(w->id, close(into[0]) < 0);
-        DIE_IF(w->id, close(outof[1]) < 0);
+    // Spawn engine process and plug channel
+    tp->set_cpu_quota(eo.cpuQuota);
+    tp->spawn(eo.cmd.c_str(), w->log != NULL);
 
-        DIE_IF(w->id, !(this->in = fdopen(outof[0], "r")));
-        DIE_IF(w->id, !(this->out = fdopen(into[1], "w")));
-    }
-#endif
+    // parse engine ABOUT infomation
+    parse_about(eo.cmd.c_str());
+
+    // Offer the fast path, which the engine accepts (or not) before its next OK
+    if (eo.fastPath && eo.host.empty())
+        shm_offer();
 }
 
-static void engine_parse_cmd(const char               *cmd,
-                             std::string              &cwd,
-                             std::string              &run,
-                             std::vector<std::string> &args)
+bool Engine::is_ok() const
 {
-    // Isolate the first token being the command to run.
-    std::string token;
-
-    // Read a token from source string, returns pointer to the tail string.
-    auto readToken = [&token](const char *src) {
-        if (*src == '"') {
-            // Argument with spaces is assumed to be (esacped) quoted
-            const char *next = string_tok_esc(token, src, '"', '\\');
-            // Skip next space between argv[i] and argv[i+1]
-            return next + (next && *next == ' ');
-        }
-        else
-            return string_tok_esc(token, src, ' ', '\\');
-    };
-
-    // Read argv[0] (engine path)
-    const char *tail = readToken(cmd);
-
-    // Split token into (cwd, run). Possible cases:
-    // (a) unqualified path, like "demolito" (which evecvp() will search in PATH)
-    // (b) qualified path (absolute starting with "/", or relative starting with "./" or
-    // "../") For (b), we want to separate into executable and directory, so instead of
-    // running
-    // "../Engines/demolito" from the cwd, we execute run="./demolito" from
-    // cwd="../Engines"
-    cwd                   = "./";
-    run                   = token;
-    const char *lastSlash = strrchr(token.c_str(), '/');
-
-    if (lastSlash) {
-        cwd = std::string(token, 0, (size_t)(lastSlash - token.c_str()));
-        run = format("./%s", lastSlash + 1);
-    }
-
-    // Collect the arguments into a vec of string, args[]
-    args.push_back(run);  // argv[0] is the executed command
-
-    while ((tail = readToken(tail)))
-        args.push_back(token);
+    return tp && tp->is_running();
 }
 
-void Engine::start(const char *cmd, const char *engine_name, int64_t engine_tolerance)
+bool Engine::is_crashed() const
 {
-    if (!*cmd)
-        DIE("[%d] missing command to start engine.\n", w->id);
-
-    this->name      = engine_name;
-    this->tolerance = engine_tolerance;
-
-    // Parse cmd into (cwd, run, args): we want to execute run from cwd with args.
-    std::string              cwd, run;
-    std::vector<std::string> args;
-    engine_parse_cmd(cmd, cwd, run, args);
-
-    // execvp() needs NULL terminated char **, not vec of string. Prepare a char **, whose
-    // elements point to the C-string buffers of the elements of args, with the required
-    // NULL at the end.
-    char **argv = new char *[args.size() + 1] { nullptr };
-
-    for (size_t i = 0; i < args.size(); i++) {
-        argv[i] = args[i].data();
-    }
-
-    // Spawn child process and plug pipes
-    spawn(cwd.c_str(), run.c_str(), argv, w->log != NULL);
-
-    delete[] argv;
-
-    // parse engine ABOUT infomation
-    parse_about(cmd);
+    return is_ok() && !tp->is_connected();
 }
 
 void Engine::terminate(bool force)
 {
     // Engine was not instanciated with start()
-    if (!pid)
+    if (!is_ok())
         return;
 
     if (!force) {
+        // Stopped before its first game
+        startup_done();
+
         // Order the engine to quit, and grant (tolerance) deadline for obeying
         w->deadline_set(name.c_str(), system_msec() + tolerance, "exit");
         writeln("END");
     }
 
-#ifdef __MINGW32__
-    // On windows, wait for tolerance milliseconds, then force
-    // terminate child process if it fails to exit in time
-    int64_t waitTime = force ? 0 : tolerance;
-    DWORD   result   = WaitForSingleObject(hProcess, waitTime);
-    DIE_IF(w->id, result == WAIT_FAILED);
-    if (result == WAIT_TIMEOUT)
-        DIE_IF(w->id, !TerminateProcess(hProcess, 0));
-    DIE_IF(w->id, !CloseHandle(hProcess));
-#else
-    if (force) {
-        if (waitpid(pid, NULL, WNOHANG) == 0)
-            DIE_IF(w->id, kill(pid, SIGTERM) < 0);
-    }
-    else {
-        // On unix/linux, wait until deadline
-        waitpid(pid, NULL, 0);
-    }
-#endif
+    tp->terminate(force, tolerance);
 
     if (!force)
         w->deadline_clear();
-
-    if (in)
-        DIE_IF(w->id, fclose(in) < 0);
-    if (out)
-        DIE_IF(w->id, fclose(out) < 0);
-
-    // Reset pid, in, out
-    pid = 0;
-    in = out = nullptr;
 }
 
 // returns false when engine timeout or crash, and after that
 // is_crashed() can be used to check if the engine has crashed
 bool Engine::readln(std::string &line)
 {
-    if (!in)  // Check if engine has crashed
+    if (!tp || !tp->is_connected())  // Check if engine has crashed
         return false;
 
-    if (!string_getline(line, in)) {
+    if (!tp->readln(line, lineTime)) {
         // When timeout, main thread will terminate the engine subprocess by force
         // We wait for main thread to complete the termination callback
         w->wait_callback_done();
 
-        // Pipe returning EOF means engine crashed
-        // Instead of dying instantly, close pipe to flag engine died and return false
-        if (pid) {  // If it is terminated by timeout, process is already closed
-            DIE_IF(w->id, fclose(in) < 0);
-            DIE_IF(w->id, fclose(out) < 0);
-            in = out = nullptr;
-        }
+        // Channel returning EOF means engine crashed
+        // Instead of dying instantly, close channel to flag engine died and return false
+        if (tp->is_running())  // If terminated by timeout, channel is already closed
+            tp->close_channel();
         return false;
     }
 
     if (w->log) {
-        int64_t t = system_msec();
         DIE_IF(w->id,
-               fprintf(w->log, "%" PRId64 ": %s -> %s\n", t, name.c_str(), line.c_str())
+               fprintf(w->log,
+                       "%" PRId64 ": %s -> %s\n",
+                       lineTime,
+                       name.c_str(),
+                       line.c_str())
                    < 0);
     }
 
@@ -445,18 +166,15 @@ bool Engine::readln(std::string &line)
 
 void Engine::writeln(const char *buf)
 {
-    if (!out)  // Check if engine has crashed
+    if (!tp || !tp->is_connected())  // Check if engine has crashed
         return;
 
-    DIE_IF(w->id, fputs(buf, out) < 0);
-    DIE_IF(w->id, fputc('\n', out) < 0);
+    linesSent++;
 
-    // We take fflush error as engine crashed signal
-    if (fflush(out) < 0) {
-        // Instead of dying instantly, close pipe to flag engine died
-        DIE_IF(w->id, fclose(in) < 0);
-        DIE_IF(w->id, fclose(out) < 0);
-        in = out = nullptr;
+    // We take write error as engine crashed signal
+    if (!tp->writeln(buf)) {
+        // Instead of dying instantly, close channel to flag engine died
+        tp->close_channel();
     }
 
     if (w->log) {
@@ -469,8 +187,9 @@ void Engine::writeln(const char *buf)
 
 bool Engine::wait_for_ok(bool fatalError)
 {
-    std::string line;
-    w->deadline_set(name.c_str(), system_msec() + tolerance, "start", [=] {
+    std::string   line;
+    const int64_t timeLimit = system_msec() + tolerance + (starting ? startupWait : 0);
+    w->deadline_set(name.c_str(), timeLimit, "start", [=] {
         if (!fatalError)
             terminate(true);
     });
@@ -496,7 +215,14 @@ bool Engine::wait_for_ok(bool fatalError)
     } while (line != "OK");
 
     w->deadline_clear();
-    return line == "OK";
+    startup_done();
+
+    if (line == "OK") {
+        shm_settle();
+        return true;
+    }
+
+    return false;
 }
 
 bool Engine::bestmove(int64_t     &timeLeft,
@@ -505,7 +231,8 @@ bool Engine::bestmove(int64_t     &timeLeft,
                       Info        &info,
                       int          moveply)
 {
-    const int64_t start          = system_msec();
+    // The clock starts when the engine receives the command
+    const int64_t start          = system_msec() + tp->send_delay();
     const int64_t matchTimeLimit = start + timeLeft;
     int64_t       turnTimeLimit  = matchTimeLimit;
     int64_t       turnTimeLeft   = timeLeft;
@@ -515,9 +242,10 @@ bool Engine::bestmove(int64_t     &timeLeft,
         turnTimeLeft  = std::min(timeLeft, maxTurnTime);
     }
 
-    w->deadline_set(name.c_str(), turnTimeLimit + tolerance, "move", [=] {
-        terminate(true);
-    });
+    w->deadline_set(name.c_str(),
+                    turnTimeLimit + tolerance + tp->send_delay(),
+                    "move",
+                    [=] { terminate(true); });
     // the maximum move overhead allowed is half of the tolerance
     int64_t     moveOverhead = tolerance / 2;
     bool        result       = false;
@@ -527,7 +255,7 @@ bool Engine::bestmove(int64_t     &timeLeft,
         if (!readln(line))
             goto Exit;
 
-        const int64_t now = system_msec();
+        const int64_t now = lineTime;
         info.time         = now - start;
         timeLeft          = std::max<int64_t>(matchTimeLimit - now, 0);
         turnTimeLeft      = turnTimeLimit - now;
@@ -571,6 +299,228 @@ Exit:
     return result;
 }
 
+// Offer a shared memory channel to the engine, with 'INFO shm_channel <path>'
+void Engine::shm_offer()
+{
+#ifdef __linux__
+    static std::atomic<int> channelCount = 0;
+
+    shmPath = format("/dev/shm/c-gomoku-cli.%d.%d", (int)getpid(), ++channelCount);
+
+    int fd;
+    DIE_IF(w->id,
+           (fd = open(shmPath.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600)) < 0);
+    DIE_IF(w->id, ftruncate(fd, sizeof(ShmChannel)) < 0);
+
+    void *p =
+        mmap(nullptr, sizeof(ShmChannel), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    DIE_IF(w->id, p == MAP_FAILED);
+    DIE_IF(w->id, close(fd) < 0);
+
+    // The file is zero filled: only the header needs to be set
+    shm          = (ShmChannel *)p;
+    shm->magic   = ShmChannelMagic;
+    shm->version = ShmChannelVersion;
+
+    writeln(format("INFO shm_channel %s", shmPath).c_str());
+#endif
+}
+
+// The engine has answered OK after the offer: it has accepted it, or never will
+void Engine::shm_settle()
+{
+#ifdef __linux__
+    if (!shm || shmActive)
+        return;
+
+    // The engine has mapped the file (or not): it is no longer needed
+    unlink(shmPath.c_str());
+    shmPath.clear();
+
+    shmActive = shm->engineAck.load() == ShmChannelVersion;
+    if (!shmActive)
+        shm_release();
+
+    if (isDebug)
+        printf("Engine %s %s the shared memory fast path\n",
+               name.c_str(),
+               shmActive ? "uses" : "does not support");
+#endif
+}
+
+void Engine::shm_release()
+{
+#ifdef __linux__
+    if (!shmPath.empty()) {
+        unlink(shmPath.c_str());
+        shmPath.clear();
+    }
+
+    if (shm) {
+        DIE_IF(w->id, munmap(shm, sizeof(ShmChannel)) < 0);
+        shm = nullptr;
+    }
+
+    shmActive = false;
+#endif
+}
+
+// Read engine output that is already available, without blocking. Returns false if the
+// engine crashed or was terminated.
+bool Engine::drain_output(int moveply, Info &info)
+{
+    std::string line;
+
+    // The deadline callback may terminate the engine, and close its channel, from the
+    // deadline service thread: it does so under the deadline lock
+    auto ready = [this] {
+        std::lock_guard lock(w->deadline.mtx);
+        return tp->is_connected() && tp->input_ready();
+    };
+
+    while (ready()) {
+        if (!readln(line))
+            return false;
+
+        if (const char *tail; process_common_output(line.c_str(), tail) == OT_MESSAGE) {
+            if (messages)
+                *messages += format("%i) %s: %s\n", moveply, name, tail);
+
+            parse_thinking_message(tail, info);
+        }
+    }
+
+    std::lock_guard lock(w->deadline.mtx);
+    return tp->is_connected();
+}
+
+bool Engine::bestmove_fast(const Position &pos,
+                           bool            useTurn,
+                           int64_t        &timeLeft,
+                           int64_t         maxTurnTime,
+                           move_t         &best,
+                           Info           &info)
+{
+#ifdef __linux__
+    const int     moveCount = pos.get_move_count();
+    const move_t *hist      = pos.get_hist_moves();
+    const int     moveply   = moveCount + 1;
+
+    auto post = [&](ShmMessageType type, Pos p = 0, int32_t arg = 0, int64_t value = 0) {
+        const ShmMessage m = {.type  = type,
+                              .lines = (uint32_t)linesSent,
+                              .x     = (int16_t)(p ? CoordX(p) : 0),
+                              .y     = (int16_t)(p ? CoordY(p) : 0),
+                              .arg   = arg,
+                              .value = value};
+
+        // Only one request is in flight, and it always fits in the ring
+        if (!shm->toEngine.push(m))
+            DIE("[%d] engine %s: shared memory ring overflow\n", w->id, name.c_str());
+
+        if (w->log)
+            DIE_IF(w->id,
+                   fprintf(w->log,
+                           "%" PRId64 ": %s <= %d %d,%d %d %" PRId64 "\n",
+                           system_msec(),
+                           name.c_str(),
+                           m.type,
+                           m.x,
+                           m.y,
+                           m.arg,
+                           m.value)
+                       < 0);
+    };
+
+    // Build the request: the equivalent of INFO time_left, then BEGIN, TURN or BOARD
+    post(SHM_TIME_LEFT, 0, 0, timeLeft);
+
+    if (moveCount == 0)
+        post(SHM_BEGIN);
+    else if (useTurn)
+        post(SHM_TURN, PosFromMove(hist[moveCount - 1]));
+    else {
+        // Same stone numbering as the BOARD command: the side that moved last is 2
+        const Color lastColor = ColorFromMove(hist[moveCount - 1]);
+
+        for (int i = 0; i < moveCount; i++)
+            post(SHM_BOARD,
+                 PosFromMove(hist[i]),
+                 ColorFromMove(hist[i]) == lastColor ? 2 : 1);
+
+        post(SHM_DONE);
+    }
+
+    const int64_t start          = system_msec();
+    const int64_t matchTimeLimit = start + timeLeft;
+    const int64_t turnTimeLimit =
+        maxTurnTime > 0 ? start + std::min(timeLeft, maxTurnTime) : matchTimeLimit;
+    const int64_t moveOverhead = tolerance / 2;
+    bool          stopped      = false;
+    bool          result       = false;
+
+    w->deadline_set(name.c_str(), turnTimeLimit + tolerance, "move", [=] {
+        terminate(true);
+    });
+    shm->toEngine.publish();
+
+    // Wait for the answer. Between waits, handle text output (MESSAGE lines, or EOF if
+    // the engine crashed), and ask the engine to stop when its time is up.
+    ShmMessage m;
+
+    for (;;) {
+        if (shm->toCli.pop(m, 20)) {
+            if (m.type != SHM_BEST)
+                continue;
+
+            const int64_t now = system_msec();
+            info.time         = now - start;
+            info.depth        = m.arg;
+            info.score        = (int)m.value;
+            best              = pos.get_turn() << 10;
+
+            // A square out of the board is sent as a wall square, which is illegal
+            if (m.x >= 0 && m.y >= 0 && m.x < pos.get_size() && m.y < pos.get_size())
+                best |= POS(m.x, m.y);
+
+            if (!stopped)
+                timeLeft = std::max<int64_t>(matchTimeLimit - now, 0);
+
+            if (w->log)
+                DIE_IF(w->id,
+                       fprintf(w->log,
+                               "%" PRId64 ": %s => %d,%d\n",
+                               now,
+                               name.c_str(),
+                               m.x,
+                               m.y)
+                           < 0);
+
+            result = true;
+            break;
+        }
+
+        if (!drain_output(moveply, info)) {
+            w->wait_callback_done();
+            break;
+        }
+
+        if (!stopped && system_msec() > turnTimeLimit + moveOverhead) {
+            // For turn timeout, explicitly mark time left as negetive
+            writeln("YXSTOP");
+            timeLeft = INT64_MIN;
+            stopped  = true;
+        }
+    }
+
+    w->deadline_clear();
+    return result;
+#else
+    (void)pos, (void)useTurn, (void)timeLeft, (void)maxTurnTime, (void)best, (void)info;
+    return false;
+#endif
+}
+
 static void parse_and_display_engine_about(const Worker    *w,
                                            std::string_view line,
                                            std::string     &engine_name)
@@ -642,7 +592,7 @@ static void parse_and_display_engine_about(const Worker    *w,
 void Engine::parse_about(const char *fallbackName)
 {
     w->deadline_set(!name.empty() ? name.c_str() : fallbackName,
-                    system_msec() + tolerance,
+                    system_msec() + tolerance + (starting ? startupWait : 0),
                     "about");
     writeln("ABOUT");
 
@@ -664,6 +614,15 @@ void Engine::parse_about(const char *fallbackName)
         name = fallbackName;
 }
 
+// Engine has answered its first START (or is being stopped): leave startup phase
+void Engine::startup_done()
+{
+    if (starting) {
+        w->startup_leave();
+        starting = false;
+    }
+}
+
 // process MESSAGE, UNKNOWN, ERROR, DEBUG messages
 // @param tail_out Pointer to receive the start position of output without prefix.
 Engine::OutputType Engine::process_common_output(const char *line, const char *&tail)
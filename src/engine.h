@@ -15,15 +15,16 @@
  */
 
 #pragma once
-#ifndef __MINGW32__
-    #include <sys/types.h>
-#endif
+#include "options.h"
+#include "position.h"
 
 #include <cstdio>
 #include <cstdint>
 #include <string>
 
 class Worker;
+class Transport;
+struct ShmChannel;
 
 // Elements remembered from parsing info lines (for writing PGN comments)
 struct Info
@@ -42,7 +43,7 @@ public:
     Engine(const Engine &) = delete;  // disable copy
     ~Engine();
 
-    void start(const char *cmd, const char *name, int64_t tolerance);
+    void start(const EngineOptions &eo);
     void terminate(bool force = false);
 
     bool readln(std::string &line);
@@ -55,22 +56,32 @@ public:
                   Info        &info,
                   int          moveply);
 
-    bool is_ok() const { return pid != 0; }
-    bool is_crashed() const { return pid && (!in || !out); }
+    // Shared memory fast path (see shmchannel.h), once negotiated with the engine.
+    // Replaces INFO time_left, BEGIN/TURN/BOARD and bestmove() for one move.
+    bool has_fast_path() const { return shmActive; }
+    bool bestmove_fast(const Position &pos,
+                       bool            useTurn,
+                       int64_t        &timeLeft,
+                       int64_t         maxTurnTime,
+                       move_t         &best,
+                       Info           &info);
+
+    bool is_ok() const;
+    bool is_crashed() const;
 
 private:
     Worker *const w;
     const bool    isDebug;
-    FILE         *in, *out;
+    Transport    *tp;
     std::string  *messages;
     int64_t       tolerance;
-
-#ifdef __MINGW32__
-    long  pid;
-    void *hProcess;
-#else
-    pid_t pid;
-#endif
+    int64_t       lineTime;     // time at which the last line read was produced
+    int64_t       startupWait;  // time waited for a startup slot (msec)
+    bool          starting;     // in startup phase, until the first OK
+    uint64_t      linesSent;    // lines written to the engine since start()
+    ShmChannel   *shm;          // offered fast path channel (null if none)
+    std::string   shmPath;      // file backing shm, until the engine has answered
+    bool          shmActive;    // fast path acknowledged by the engine
 
     enum OutputType {
         OT_DIRECT,   // No prefix
@@ -81,8 +92,12 @@ private:
         OT_SUGGEST,  // Output with prefix "SUGGEST"
     };
 
-    void       spawn(const char *cwd, const char *run, char **argv, bool readStdErr);
     void       parse_about(const char *fallbackName);
+    void       startup_done();
+    void       shm_offer();
+    void       shm_settle();
+    void       shm_release();
+    bool       drain_output(int moveply, Info &info);
     OutputType process_common_output(const char *line, const char *&tail_out);
     void       parse_thinking_message(const char *line, Info &info);
 };
@@ -0,0 +1,306 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// engine-host: spawns engines on behalf of remote c-gomoku-cli instances, and relays
+// their Gomocup protocol over TCP. See TcpTransport for the wire protocol. Each
+// connection is served by a forked session process, which owns exactly one engine.
+// Clients must send the shared secret of the host first, if it has one, and may only
+// spawn engines from its engine directory, if it has one. Both are required to listen
+// on other interfaces than loopback.
+
+#include "transport.h"
+#include "util.h"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <climits>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+// Interval (msec) between keepalive messages
+static const int64_t KeepaliveInterval = 2000;
+
+static std::string token;      // shared secret, empty if none
+static std::string engineDir;  // real path of the engine directory, empty if none
+
+class Session
+{
+public:
+    Session(int sock, int id);
+    [[noreturn]] void run();
+
+private:
+    const int         id;
+    const int         sock;
+    FILE             *in, *out;
+    std::mutex        outMtx;
+    PipeTransport     engine;
+    std::atomic<bool> exited;
+
+    void send(const std::string &line);
+    void relay_engine_output();
+    void keepalive();
+};
+
+Session::Session(int s, int i) : id(i), sock(s), engine(i), exited(false)
+{
+    // The engine must not inherit the connection
+    int sockOut;
+    DIE_IF(id, fcntl(sock, F_SETFD, FD_CLOEXEC) < 0);
+    DIE_IF(id, (sockOut = fcntl(sock, F_DUPFD_CLOEXEC, 0)) < 0);
+    DIE_IF(id, !(in = fdopen(sock, "r")));
+    DIE_IF(id, !(out = fdopen(sockOut, "w")));
+}
+
+// Compare secrets in constant time, so that timing does not leak how much matched
+static bool token_matches(const char *secret)
+{
+    const size_t  n    = strlen(secret);
+    unsigned char diff = n != token.size();
+
+    for (size_t i = 0; i < token.size(); i++)
+        diff |= (unsigned char)(secret[i < n ? i : 0] ^ token[i]);
+
+    return !diff;
+}
+
+// Engines must resolve to a file of the engine directory, if any. Unqualified commands
+// would be searched in PATH, so they are refused.
+static bool engine_allowed(const char *cmd)
+{
+    if (engineDir.empty())
+        return true;
+
+    std::string              cwd, run;
+    std::vector<std::string> args;
+    transport_parse_cmd(cmd, cwd, run, args);
+
+    char path[PATH_MAX];
+
+    return string_prefix(run.c_str(), "./")
+           && realpath((cwd + "/" + run.substr(2)).c_str(), path)
+           && string_prefix(path, (engineDir + "/").c_str());
+}
+
+void Session::send(const std::string &line)
+{
+    std::lock_guard lock(outMtx);
+
+    // Write errors mean the client is gone: the main loop will see EOF and exit
+    fputs(line.c_str(), out);
+    fputc('\n', out);
+    fflush(out);
+}
+
+void Session::relay_engine_output()
+{
+    std::string line;
+    int64_t     stamp;
+
+    while (engine.readln(line, stamp))
+        send(format("<%" PRId64 " %s", stamp, line));
+
+    // Engine closed its stdout: signal it to the client, and stop sending. The session
+    // lives on until the client hangs up.
+    exited = true;
+    send("EXIT");
+    shutdown(sock, SHUT_WR);
+}
+
+void Session::keepalive()
+{
+    while (!exited) {
+        system_sleep(KeepaliveInterval);
+        send(format("ALIVE %" PRId64, system_msec()));
+    }
+}
+
+[[noreturn]] void Session::run()
+{
+    std::string line;
+    bool        authenticated = token.empty();
+
+    while (string_getline(line, in)) {
+        long long   sent;
+        int         readStdErr;
+        double      quota;
+        const char *tail;
+
+        // The secret comes first, if the host has one
+        if ((tail = string_prefix(line.c_str(), "AUTH ")))
+            authenticated = token.empty() || token_matches(tail);
+
+        if (!authenticated) {
+            printf("[%d] authentication failed\n", id);
+            fflush(stdout);
+            send("DENIED");
+            break;
+        }
+
+        if (tail)
+            continue;
+
+        if (sscanf(line.c_str(), "PING %lld", &sent) == 1)
+            send(format("PONG %lld %" PRId64, sent, system_msec()));
+        else if (line[0] == '>') {
+            if (engine.is_connected() && !exited && !engine.writeln(line.c_str() + 1))
+                engine.close_channel();
+        }
+        else if (sscanf(line.c_str(), "QUOTA %lf", &quota) == 1)
+            engine.set_cpu_quota(quota);
+        else if (sscanf(line.c_str(), "SPAWN %d", &readStdErr) == 1
+                 && (tail = strchr(line.c_str() + 6, ' '))
+                 && !engine.is_running()) {
+            if (!engine_allowed(tail + 1)) {
+                printf("[%d] refused '%s': not in the engine directory\n", id, tail + 1);
+                fflush(stdout);
+                send("DENIED");
+                break;
+            }
+
+            printf("[%d] spawn '%s'\n", id, tail + 1);
+            fflush(stdout);
+            engine.spawn(tail + 1, readStdErr);
+            send("SPAWNED");
+
+            std::thread(&Session::relay_engine_output, this).detach();
+            std::thread(&Session::keepalive, this).detach();
+        }
+        else {
+            printf("[%d] invalid command '%s'\n", id, line.c_str());
+            fflush(stdout);
+        }
+    }
+
+    // Client hung up (or timed out on us): exiting the session kills the engine, via
+    // PR_SET_PDEATHSIG on Linux and via EOF on its stdin elsewhere.
+    printf("[%d] session closed\n", id);
+    fflush(stdout);
+    _exit(EXIT_SUCCESS);
+}
+
+static void usage()
+{
+    printf("usage: engine-host [-bind ADDRESS] [-port PORT] [-token FILE] "
+           "[-engines DIR]\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, const char **argv)
+{
+    std::string bind_addr = "127.0.0.1", port = ENGINE_HOST_PORT;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-bind") && i + 1 < argc)
+            bind_addr = argv[++i];
+        else if (!strcmp(argv[i], "-port") && i + 1 < argc)
+            port = argv[++i];
+        else if (!strcmp(argv[i], "-token") && i + 1 < argc)
+            token = transport_read_token(argv[++i]);
+        else if (!strcmp(argv[i], "-engines") && i + 1 < argc)
+            engineDir = argv[++i];
+        else
+            usage();
+    }
+
+    // Relative engine commands are run from the engine directory
+    if (!engineDir.empty()) {
+        char path[PATH_MAX];
+        DIE_IF(0, !realpath(engineDir.c_str(), path) || chdir(path) < 0);
+        engineDir = path;
+    }
+
+    // Session processes are never waited for
+    signal(SIGCHLD, SIG_IGN);
+    signal(SIGPIPE, SIG_IGN);
+
+    struct addrinfo hints = {}, *res = nullptr;
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags    = AI_PASSIVE;
+
+    if (int err = getaddrinfo(bind_addr.c_str(), port.c_str(), &hints, &res))
+        DIE("cannot resolve '%s': %s\n", bind_addr.c_str(), gai_strerror(err));
+
+    // Anyone who can reach the port could run commands as this user
+    const bool loopback =
+        res->ai_family == AF_INET
+            ? ntohl(((struct sockaddr_in *)res->ai_addr)->sin_addr.s_addr) >> 24 == 127
+            : IN6_IS_ADDR_LOOPBACK(&((struct sockaddr_in6 *)res->ai_addr)->sin6_addr);
+
+    if (!loopback && (token.empty() || engineDir.empty()))
+        DIE("-bind %s needs -token and -engines\n", bind_addr.c_str());
+
+    int       listener;
+    const int one = 1;
+    DIE_IF(0,
+           (listener = socket(res->ai_family, res->ai_socktype, res->ai_protocol)) < 0);
+    DIE_IF(0, setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0);
+    DIE_IF(0, bind(listener, res->ai_addr, res->ai_addrlen) < 0);
+    DIE_IF(0, listen(listener, 64) < 0);
+    freeaddrinfo(res);
+
+    printf("engine-host listening on %s:%s\n", bind_addr.c_str(), port.c_str());
+    fflush(stdout);
+
+    for (int id = 1;; id++) {
+        struct sockaddr_storage peer;
+        socklen_t               peerLen = sizeof(peer);
+        int                     sock;
+
+        if ((sock = accept(listener, (struct sockaddr *)&peer, &peerLen)) < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            DIE_IF(0, true);
+        }
+
+        char peerName[NI_MAXHOST] = "?";
+        getnameinfo((struct sockaddr *)&peer,
+                    peerLen,
+                    peerName,
+                    sizeof(peerName),
+                    nullptr,
+                    0,
+                    NI_NUMERICHOST);
+        printf("[%d] connection from %s\n", id, peerName);
+        fflush(stdout);
+
+        pid_t pid;
+        DIE_IF(0, (pid = fork()) < 0);
+
+        if (pid == 0) {
+            DIE_IF(id, close(listener) < 0);
+            signal(SIGCHLD, SIG_DFL);
+
+            DIE_IF(id, setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) < 0);
+            DIE_IF(id, setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one)) < 0);
+
+            Session *session = new Session(sock, id);
+            session->run();
+        }
+
+        DIE_IF(0, close(sock) < 0);
+    }
+}
@@ -21,6 +21,7 @@
 #include "util.h"
 #include "workers.h"
 
+#include <algorithm>
 #include <climits>
 #include <cstring>
 #include <ctime>
@@ -29,11 +30,13 @@
 
 Game::Game(int rd, int gm, Worker *worker)
     : game_rule()
+    , time_factor()
     , round(rd)
     , game(gm)
     , ply()
     , state()
     , board_size()
+    , overruns()
     , w(worker)
 {}
 
@@ -178,8 +181,9 @@ int Game::play(const Options       &o,
     bool    canUseTurn[2]         = {false, false};
 
     // initialize game rule
-    this->game_rule  = (GameRule)(o.gameRule);
-    this->board_size = o.boardSize;
+    this->game_rule   = (GameRule)(o.gameRule);
+    this->board_size  = o.boardSize;
+    this->time_factor = o.calibrate ? o.cp.factor : 0;
 
     for (int color = BLACK; color <= WHITE; color++) {
         names[color] = engines[color ^ pos[0].get_turn() ^ reverse].name;
@@ -233,33 +237,51 @@ int Game::play(const Options       &o,
         // Prepare timeLeft[ei]
         compute_time_left(*eo[ei], timeLeft[ei]);
 
-        // output game/turn info
-        gomocup_turn_info_command(*eo[ei], timeLeft[ei], engines[ei]);
-
-        // trigger think!
-        if (pos[ply].get_move_count() == 0) {
-            engines[ei].writeln("BEGIN");
+        std::string   bestmove;
+        Info          moveInfo = {};
+        bool          ok;
+        const int64_t allotted = eo[ei]->timeoutTurn
+                                     ? std::min(eo[ei]->timeoutTurn, timeLeft[ei])
+                                     : timeLeft[ei];
+
+        if (engines[ei].has_fast_path()) {
+            // Request and answer through shared memory, without text formatting
+            ok = engines[ei].bestmove_fast(pos[ply],
+                                           o.useTURN && canUseTurn[ei],
+                                           timeLeft[ei],
+                                           eo[ei]->timeoutTurn,
+                                           played,
+                                           moveInfo);
             canUseTurn[ei] = true;
         }
         else {
-            if (o.useTURN && canUseTurn[ei]) {  // use TURN to trigger think
-                engines[ei].writeln(
-                    format("TURN %s", pos[ply].move_to_gomostr(played)).c_str());
-            }
-            else {  // use BOARD to trigger think
-                send_board_command(pos[ply], engines[ei]);
+            // output game/turn info
+            gomocup_turn_info_command(*eo[ei], timeLeft[ei], engines[ei]);
+
+            // trigger think!
+            if (pos[ply].get_move_count() == 0) {
+                engines[ei].writeln("BEGIN");
                 canUseTurn[ei] = true;
             }
-        }
+            else {
+                if (o.useTURN && canUseTurn[ei]) {  // use TURN to trigger think
+                    engines[ei].writeln(
+                        format("TURN %s", pos[ply].move_to_gomostr(played)).c_str());
+                }
+                else {  // use BOARD to trigger think
+                    send_board_command(pos[ply], engines[ei]);
+                    canUseTurn[ei] = true;
+                }
+            }
 
-        std::string bestmove;
-        Info        moveInfo = {};
-        const bool  ok       = engines[ei].bestmove(timeLeft[ei],
-                                             eo[ei]->timeoutTurn,
-                                             bestmove,
-                                             moveInfo,
-                                             pos[ply].get_move_count() + 1);
+            ok = engines[ei].bestmove(timeLeft[ei],
+                                      eo[ei]->timeoutTurn,
+                                      bestmove,
+                                      moveInfo,
+                                      pos[ply].get_move_count() + 1);
+        }
         this->info.push_back(moveInfo);
+        overruns += moveInfo.time > allotted;
 
         if (!ok) {  // engine crashed/hard timeout in bestmove()
             DIE_OR_ERR(o.fatalError,
@@ -282,7 +304,9 @@ int Game::play(const Options       &o,
             break;
         }
 
-        played = pos[ply].gomostr_to_move(bestmove);
+        // The fast path already answered with a move
+        if (!engines[ei].has_fast_path())
+            played = pos[ply].gomostr_to_move(bestmove);
 
         // Check if move is legal
         if (!pos[ply].is_legal_move(played)) {
@@ -290,7 +314,8 @@ int Game::play(const Options       &o,
                    w->id,
                    engines[ei].name.c_str(),
                    ply,
-                   bestmove.c_str());
+                   engines[ei].has_fast_path() ? pos[ply].move_to_gomostr(played).c_str()
+                                               : bestmove.c_str());
             state = STATE_ILLEGAL_MOVE;
             break;
         }
@@ -450,6 +475,8 @@ std::string Game::export_pgn(size_t gameIdx) const
     out += format("[Result \"%s\"]\n", result);
     out += format("[Termination \"%s\"]\n", reason);
     out += format("[PlyCount \"%i\"]\n", ply);
+    if (time_factor > 0)
+        out += format("[TimeFactor \"%.3f\"]\n", time_factor);
 
     out += result;
     out += "\n\n";
@@ -488,6 +515,8 @@ std::string Game::export_sgf(size_t gameIdx) const
     decode_state(result, reason, ResultTxt);
     out += format("RE[%s]", result);
     out += format("TE[%s]", reason);
+    if (time_factor > 0)
+        out += format("GC[time control scaled by %.3f]", time_factor);
     out.push_back('\n');
 
     // Print the moves
@@ -543,17 +572,17 @@ std::string Game::export_sgf(size_t gameIdx) const
     return out;
 }
 
-void Game::export_samples_csv(FILE *out) const
+void Game::export_samples_csv(std::string &out) const
 {
     for (size_t i = 0; i < samples.size(); i++) {
         std::string pos_str = samples[i].pos.to_opening_str(OPENING_POS);
         std::string move_str =
             samples[i].pos.move_to_opening_str(samples[i].move, OPENING_POS);
-        fprintf(out, "%s,%s,%d\n", pos_str.c_str(), move_str.c_str(), samples[i].result);
+        out += format("%s,%s,%d\n", pos_str, move_str, samples[i].result);
     }
 }
 
-void Game::export_samples_bin(FILE *out, LZ4F_compressionContext_t lz4Ctx) const
+void Game::export_samples_bin(std::string &out) const
 {
     struct Entry
     {
@@ -569,8 +598,6 @@ void Game::export_samples_bin(FILE *out, LZ4F_compressionContext_t lz4Ctx) const
 
         static_assert(sizeof(EntryHead) == 4);
     } e;
-    const size_t bufSize = LZ4F_compressBound(sizeof(Entry), nullptr);
-    char         buf[bufSize];
 
     for (size_t i = 0; i < samples.size(); i++) {
         int           moveply    = samples[i].pos.get_move_count();
@@ -588,18 +615,11 @@ void Game::export_samples_bin(FILE *out, LZ4F_compressionContext_t lz4Ctx) const
         }
 
         const size_t entrySize = sizeof(Entry::EntryHead) + sizeof(uint16_t) * moveply;
-        if (lz4Ctx) {
-            size_t size =
-                LZ4F_compressUpdate(lz4Ctx, buf, bufSize, &e, entrySize, nullptr);
-            fwrite(buf, size, 1, out);
-        }
-        else {
-            fwrite(&e, entrySize, 1, out);
-        }
+        out.append((const char *)&e, entrySize);
     }
 }
 
-void Game::export_samples_binpack(FILE *out, LZ4F_compressionContext_t lz4Ctx) const
+void Game::export_samples_binpack(std::string &out) const
 {
     struct EntryHead
     {
@@ -671,20 +691,7 @@ void Game::export_samples_binpack(FILE *out, LZ4F_compressionContext_t lz4Ctx) c
                     moveSequence.data(),
                     sizeof(Move) * head.moveCount);
 
-        if (lz4Ctx) {
-            size_t compressBufSize = LZ4F_compressBound(entrySize, nullptr);
-            char   compressBuffer[compressBufSize];
-            size_t compressSize = LZ4F_compressUpdate(lz4Ctx,
-                                                      compressBuffer,
-                                                      compressBufSize,
-                                                      entryBuffer,
-                                                      entrySize,
-                                                      nullptr);
-            fwrite(compressBuffer, compressSize, 1, out);
-        }
-        else {
-            fwrite(entryBuffer, entrySize, 1, out);
-        }
+        out.append(entryBuffer, entrySize);
     };
 
     // Initialize entry data for a new sample
@@ -749,15 +756,12 @@ void Game::export_samples_binpack(FILE *out, LZ4F_compressionContext_t lz4Ctx) c
         flushEntry();
 }
 
-void Game::export_samples(FILE                     *out,
-                          SampleFormat              format,
-                          LZ4F_compressionContext_t lz4Ctx) const
+// Append samples to 'out', uncompressed, in the given format
+void Game::export_samples(std::string &out, SampleFormat format) const
 {
-    FileLock fl(out);
-
     switch (format) {
     case SAMPLE_FORMAT_CSV: export_samples_csv(out); break;
-    case SAMPLE_FORMAT_BIN: export_samples_bin(out, lz4Ctx); break;
-    case SAMPLE_FORMAT_BINPACK: export_samples_binpack(out, lz4Ctx); break;
+    case SAMPLE_FORMAT_BIN: export_samples_bin(out); break;
+    case SAMPLE_FORMAT_BINPACK: export_samples_binpack(out); break;
     }
 }
\ No newline at end of file
@@ -16,7 +16,6 @@
 
 #pragma once
 #include "engine.h"
-#include "extern/lz4frame.h"
 #include "options.h"
 #include "position.h"
 
@@ -62,7 +61,9 @@ public:
     std::vector<Sample>   samples;    // list of samples when generating training data
     GameRule              game_rule;  // rule is gomoku or renju, etc
     ForbiddenType         forbidden_type;  // forbidden type of the last move (in renju)
+    double                time_factor;     // time control scale factor, 0 if not set
     int                   round, game, ply, state, board_size;
+    int                   overruns;  // moves that took longer than the time allotted
     Worker *const         w;
 
     Game(int round, int game, Worker *worker);
@@ -78,9 +79,7 @@ public:
     decode_state(std::string &result, std::string &reason, const char *restxt[3]) const;
     std::string export_pgn(size_t gameIdx) const;
     std::string export_sgf(size_t gameIdx) const;
-    void        export_samples(FILE                     *out,
-                               SampleFormat              format,
-                               LZ4F_compressionContext_t lz4Ctx = nullptr) const;
+    void        export_samples(std::string &out, SampleFormat format) const;
 
 private:
     int  game_apply_rules(move_t lastmove);
@@ -92,7 +91,7 @@ private:
     void gomocup_game_info_command(const EngineOptions &eo,
                                    const Options       &option,
                                    Engine              &engine);
-    void export_samples_csv(FILE *out) const;
-    void export_samples_bin(FILE *out, LZ4F_compressionContext_t lz4Ctx) const;
-    void export_samples_binpack(FILE *out, LZ4F_compressionContext_t lz4Ctx) const;
+    void export_samples_csv(std::string &out) const;
+    void export_samples_bin(std::string &out) const;
+    void export_samples_binpack(std::string &out) const;
 };
@@ -17,111 +17,610 @@
 #include "jobs.h"
 
 #include "game.h"
+#include "rating.h"
+#include "schedule.h"
 #include "util.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 
-static void job_queue_init_pair(int               games,
-                                int               e1,
-                                int               e2,
-                                int               pair,
-                                int              &added,
-                                int               round,
-                                std::vector<Job> &jobs)
-{
-    for (int g = 0; g < games; g++) {
-        const Job j = {.ei      = {e1, e2},
-                       .pair    = pair,
-                       .round   = round,
-                       .game    = added++,
-                       .reverse = (bool)(g % 2)};
-        jobs.push_back(j);
-    }
-}
+// Jobs per block of rounds, which bounds how far games can complete out of index order
+static const size_t BlockJobs = 1024;
+
+// Jobs left per worker when the tail of the tournament starts: longest games go first
+static const size_t TailJobs = 2;
 
-JobQueue::JobQueue(int engines, int rounds, int games, bool gauntlet)
-    : idx(0)
+JobQueue::JobQueue(int       engines,
+                   int       rnd,
+                   int       g,
+                   bool      gauntlet,
+                   bool      repeat,
+                   int       n,
+                   Schedule *sched)
+    : requeuedCount(0)
+    , rounds(rnd)
+    , games(g)
+    , total(sched ? (size_t)sched->matches() * games
+                  : (size_t)rounds * games
+                        * (gauntlet ? engines - 1 : engines * (engines - 1) / 2))
+    , shards(n)
+    , round(0)
+    , dispensed(0)
     , completed(0)
+    , resumed(0)
+    , retiredJobs(0)
+    , stopped(false)
+    , batchPairs(nullptr)
+    , nextIdx(0)
+    , targetError(0)
+    , schedule(sched)
+    , openMatch(0)
 {
-    assert(engines >= 2 && rounds >= 1 && games >= 1);
+    assert(engines >= 2 && rounds >= 1 && games >= 1 && shards >= 1);
 
     // Prepare engine names: blank for now, will be discovered at run time (concurrently)
     names.resize(engines);
+    budgets.resize(engines);
 
     if (gauntlet) {
         // Gauntlet: N-1 pairs (0, e2) with 0 < e2
         for (int e2 = 1; e2 < engines; e2++) {
-            const Result r = {.ei = {0, e2}, .count = {0}};
+            const Result r = {.ei = {0, e2}, .count = {0}, .penta = {0}, .first = {0}};
             results.push_back(r);
         }
-
-        for (int r = 0; r < rounds; r++) {
-            int added = 0;  // number of games already added to the current round
-
-            for (int e2 = 1; e2 < engines; e2++)
-                job_queue_init_pair(games, 0, e2, e2 - 1, added, r, jobs);
-        }
     }
     else {
         // Round robin: N(N-1)/2 pairs (e1, e2) with e1 < e2
         for (int e1 = 0; e1 < engines - 1; e1++)
             for (int e2 = e1 + 1; e2 < engines; e2++) {
-                const Result r = {.ei = {e1, e2}, .count = {0}};
+                const Result r = {
+                    .ei = {e1, e2}, .count = {0}, .penta = {0}, .first = {0}};
                 results.push_back(r);
             }
+    }
 
-        for (int r = 0; r < rounds; r++) {
-            int pair  = 0;  // enumerate pairs in order
-            int added = 0;  // number of games already added to the current round
+    verdicts.resize(results.size());
 
-            for (int e1 = 0; e1 < engines - 1; e1++)
-                for (int e2 = e1 + 1; e2 < engines; e2++)
-                    job_queue_init_pair(games, e1, e2, pair++, added, r, jobs);
-        }
+    // Zero initialized counters, each shard starting on its own cache line
+    const size_t intsPerLine = 64 / sizeof(std::atomic<int>);
+    shardStride =
+        (results.size() * PairCounters + intsPerLine - 1) / intsPerLine * intsPerLine;
+    counts = new std::atomic<int>[shards * shardStride]();
+
+    // Game pairs are only scored when both games have the same engines, with colors
+    // swapped, which takes an even number of games per pair
+    halves = repeat && games % 2 == 0 ? new std::atomic<uint8_t>[(total + 1) / 2]()
+                                      : nullptr;
+
+    // Dispense whole rounds in blocks of about BlockJobs, and workers have no pair loaded
+    // yet
+    blockRounds = (int)std::max<size_t>(1, BlockJobs / (games * results.size()));
+    queues      = new PairQueue[results.size()]();
+    current.assign(shards, -1);
+
+    // Matches of a schedule get their pair once their players are known
+    if (schedule) {
+        init_batches();
+        matchNext.assign(schedule->matches(), 0);
+        matchScore.assign(schedule->matches(), 0);
+        matchGames.assign(schedule->matches(), 0);
     }
 
     startedTime = system_msec();
 }
 
-bool JobQueue::pop(Job &j, size_t &idx_in, size_t &count)
+JobQueue::~JobQueue()
 {
-    std::lock_guard lock(mtx);
+    delete[] counts;
+    delete[] halves;
+    delete[] queues;
+    delete[] batchPairs;
+}
+
+// Each round plays the pairs in order, with 'games' consecutive games per pair. With
+// information pairing, each batch of 'games' games has the pair it was assigned.
+Job JobQueue::job_at(size_t i) const
+{
+    const size_t perRound = (size_t)games * results.size();
+    const int    game     = (int)(i % perRound);
+    const int    pair     = batchPairs
+                                ? batchPairs[i / games].load(std::memory_order_relaxed)
+                                : game / games;
+
+    return {.ei      = {results[pair].ei[0], results[pair].ei[1]},
+            .pair    = pair,
+            .round   = (int)(i / perRound),
+            .game    = game,
+            .reverse = (bool)(game % games % 2)};
+}
+
+// End of the block of rounds starting at round 'r', counted in games of each pair
+size_t JobQueue::block_end(int r) const
+{
+    return (size_t)std::min(r + blockRounds, rounds) * games;
+}
+
+// Claim the next game of 'pair' in the block starting at round 'r', if any is left
+bool JobQueue::claim(int pair, int r, size_t &idx)
+{
+    std::atomic<size_t> &next     = queues[pair].next;
+    const size_t         perRound = (size_t)games * results.size();
+    const size_t         end      = block_end(r);
+    size_t               k        = next.load(std::memory_order_relaxed);
+
+    while (k < end)
+        if (next.compare_exchange_weak(k, k + 1, std::memory_order_relaxed)) {
+            idx = k / games * perRound + (size_t)pair * games + k % games;
+            return true;
+        }
+
+    return false;
+}
+
+// Expected duration of a game of 'pair': the time budget of its engines counts as one
+// game played, so that observed durations soon take over
+double JobQueue::expected_msec(int pair) const
+{
+    const Result &r     = results[pair];
+    const double  prior = (double)budgets[r.ei[0]] + budgets[r.ei[1]];
+    const int     n     = queues[pair].played.load(std::memory_order_relaxed);
+    const double  msec  = prior + queues[pair].playedMsec.load(std::memory_order_relaxed);
+
+    return std::max(1.0, msec / (n + 1));
+}
+
+// Pair with games left in the block starting at round 'r', or -1 if all pairs are dry:
+// either the one with the longest expected games, or the one with the most expected
+// work left per worker sticking to it
+int JobQueue::select_pair(int r, bool longest) const
+{
+    const size_t end      = block_end(r);
+    int          best     = -1;
+    double       bestWork = 0;
+
+    for (int p = 0; p < (int)results.size(); p++) {
+        const size_t next    = queues[p].next.load(std::memory_order_relaxed);
+        const size_t left    = end - std::min(next, end);
+        const int    workers = queues[p].workers.load(std::memory_order_relaxed) + 1;
+        const double work =
+            longest ? expected_msec(p) : left * expected_msec(p) / workers;
+
+        if (left && (best < 0 || work > bestWork)) {
+            best     = p;
+            bestWork = work;
+        }
+    }
+
+    return best;
+}
+
+// Worker sticking to 'pair' moves to 'p'
+void JobQueue::load_pair(int &pair, int p)
+{
+    if (pair >= 0)
+        queues[pair].workers.fetch_sub(1, std::memory_order_relaxed);
+    queues[p].workers.fetch_add(1, std::memory_order_relaxed);
+    pair = p;
+}
+
+// Pop the next job for worker 'shard'. Blocks of rounds are dispensed in order, so that
+// games complete roughly in index order, but within a block, a worker keeps playing the
+// pair it has loaded until that pair runs dry. Game indices, and hence openings and per
+// pair game counts, are the same as for dispensing jobs in global order.
+bool JobQueue::pop(int shard, Job &j, size_t &idx, size_t &count)
+{
+    int &pair = current[shard % shards];
+
+    // Jobs lost by remote workers come first
+    if (requeuedCount.load(std::memory_order_relaxed) && !stopped) {
+        std::lock_guard lock(requeueMtx);
+
+        if (!requeued.empty()) {
+            idx = requeued.back();
+            requeued.pop_back();
+            requeuedCount.store(requeued.size(), std::memory_order_relaxed);
+            dispensed.fetch_add(1, std::memory_order_relaxed);
+            j     = job_at(idx);
+            count = total;
+            return true;
+        }
+    }
+
+    if (batchPairs) {
+        count = total;
+        return schedule ? pop_match(j, idx) : pop_batch(j, idx);
+    }
+
+    while (!stopped.load(std::memory_order_relaxed)) {
+        const int r = round.load(std::memory_order_relaxed);
+
+        if (r >= rounds)
+            return false;
+
+        // In the tail, the longest games go first, whichever pair is loaded
+        if (dispensed.load(std::memory_order_relaxed) + TailJobs * shards >= total) {
+            const int p = select_pair(r, true);
+
+            if (p >= 0 && p != pair)
+                load_pair(pair, p);
+        }
+
+        if (pair >= 0 && claim(pair, r, idx)) {
+            if (!skip.empty() && skip[idx])
+                continue;
+
+            dispensed.fetch_add(1, std::memory_order_relaxed);
+            j     = job_at(idx);
+            count = total;
+            return true;
+        }
+
+        // Loaded pair ran dry: rebalance to another pair, or move on to the next block
+        // once all pairs are dry
+        const int p = select_pair(r, false);
+
+        if (p < 0) {
+            int expected = r;
+            round.compare_exchange_strong(expected,
+                                          r + blockRounds,
+                                          std::memory_order_relaxed);
+        }
+        else
+            load_pair(pair, p);
+    }
+
+    return false;
+}
+
+// Pair for the next batch of games, with information pairing: the one whose games most
+// reduce the sum of rating variances, counting games in flight as if they were played.
+// Returns -1 once all ratings are known within the target error.
+int JobQueue::select_batch_pair() const
+{
+    std::vector<Result> res(results.size());
+    std::vector<int>    pending(results.size());
+
+    for (size_t p = 0; p < results.size(); p++) {
+        res[p]     = aggregate((int)p);
+        pending[p] = std::max(0, queues[p].assigned - res[p].total());
+    }
+
+    const Ratings estimate = rating_estimate((int)names.size(), res, pending);
+
+    if (targetError > 0) {
+        double error = 0;
+
+        for (int ei = 0; ei < estimate.size(); ei++)
+            error = std::max(error, estimate.error(ei));
+
+        if (error <= targetError)
+            return -1;
+    }
+
+    int    best     = -1;
+    double bestGain = 0;
+
+    for (int p = 0; p < (int)results.size(); p++) {
+        const Result &r    = results[p];
+        const double  gain = rating_gain(estimate, r.ei[0], r.ei[1], games);
+
+        if (best < 0 || gain > bestGain) {
+            best     = p;
+            bestGain = gain;
+        }
+    }
+
+    return best;
+}
+
+// Pop the next job with information pairing. Jobs are dispensed in index order, and the
+// first job of a batch picks the pair of the whole batch, so that its games alternate
+// colors, and game pairs of -repeat keep the same engines. Once the target is reached,
+// jobs left are never played, and count as completed.
+bool JobQueue::pop_batch(Job &j, size_t &idx)
+{
+    std::lock_guard lock(pairingMtx);
+
+    while (!stopped.load(std::memory_order_relaxed) && nextIdx < total) {
+        std::atomic<int> &pair = batchPairs[nextIdx / games];
+
+        if (pair.load(std::memory_order_relaxed) < 0) {
+            const int p = select_batch_pair();
+
+            if (p < 0) {
+                size_t n = 0;
 
-    if (idx < jobs.size()) {
-        j      = jobs[idx];
-        idx_in = idx++;
-        count  = jobs.size();
+                for (; nextIdx < total; nextIdx++)
+                    n += skip.empty() || !skip[nextIdx];
+
+                printf("Ratings known within +/-%.1f Elo: %zu games left unplayed\n",
+                       targetError,
+                       n);
+                retiredJobs.fetch_add(n, std::memory_order_relaxed);
+                dispensed.fetch_add(n, std::memory_order_relaxed);
+                completed.fetch_add(n, std::memory_order_relaxed);
+                return false;
+            }
+
+            pair.store(p, std::memory_order_relaxed);
+        }
+
+        idx = nextIdx++;
+
+        if (!skip.empty() && skip[idx])
+            continue;
+
+        queues[pair.load(std::memory_order_relaxed)].assigned++;
+        dispensed.fetch_add(1, std::memory_order_relaxed);
+        j = job_at(idx);
         return true;
     }
 
     return false;
 }
 
-// Add game outcome, and return updated totals
-void JobQueue::add_result(int pair, int outcome, int count[3])
+// Pop the next job of a Swiss or knockout tournament, from the first match whose players
+// are known, and which has games left to dispense. Returns false if there is none for
+// now: later matches wait for the results of earlier ones.
+bool JobQueue::pop_match(Job &j, size_t &idx)
 {
-    std::lock_guard lock(mtx);
+    std::lock_guard lock(pairingMtx);
+
+    while (openMatch < schedule->matches() && matchNext[openMatch] == games)
+        openMatch++;
+
+    for (int m = openMatch; m < schedule->matches(); m++) {
+        std::atomic<int> &pair = batchPairs[m];
+        int               ei[2];
+
+        if (matchNext[m] == games || stopped.load(std::memory_order_relaxed))
+            continue;
+
+        if (pair.load(std::memory_order_relaxed) < 0) {
+            if (!schedule->players(m, ei))
+                continue;
+
+            // Round robin pairs (e1, e2), with e1 < e2, are numbered in order
+            const int e1 = std::min(ei[0], ei[1]), e2 = std::max(ei[0], ei[1]);
+            const int n  = (int)names.size();
+            const int p  = e1 * (2 * n - e1 - 1) / 2 + e2 - e1 - 1;
+
+            pair.store(p, std::memory_order_relaxed);
+        }
 
-    results[pair].count[outcome]++;
-    completed++;
+        while (matchNext[m] < games) {
+            idx = (size_t)m * games + matchNext[m]++;
 
-    for (size_t i = 0; i < 3; i++)
-        count[i] = results[pair].count[i];
+            if (skip.empty() || !skip[idx]) {
+                dispensed.fetch_add(1, std::memory_order_relaxed);
+                j = job_at(idx);
+                return true;
+            }
+        }
+    }
+
+    return false;
 }
 
-bool JobQueue::done()
+Result JobQueue::aggregate(int pair) const
 {
-    std::lock_guard lock(mtx);
+    Result r = results[pair];
+
+    for (int s = 0; s < shards; s++) {
+        const std::atomic<int> *c = &counts[s * shardStride + pair * PairCounters];
+
+        for (int i = 0; i < 3; i++)
+            r.count[i] += c[i].load(std::memory_order_relaxed);
+
+        for (int i = 0; i < 5; i++)
+            r.penta[i] += c[3 + i].load(std::memory_order_relaxed);
+
+        for (int i = 0; i < 3; i++)
+            r.first[i] += c[8 + i].load(std::memory_order_relaxed);
+    }
+
+    return r;
+}
+
+// Add game outcome, and its duration if known (msec > 0), and return updated totals of
+// its pair, and the number of jobs completed
+size_t JobQueue::add_result(int shard, size_t idx, int outcome, int64_t msec, Result &r)
+{
+    const Job         job  = job_at(idx);
+    const int         pair = job.pair;
+    std::atomic<int> *c    = &counts[shard % shards * shardStride + pair * PairCounters];
+
+    c[outcome].fetch_add(1, std::memory_order_relaxed);
+
+    if (!job.reverse)
+        c[8 + outcome].fetch_add(1, std::memory_order_relaxed);
+
+    if (msec > 0) {
+        queues[pair].playedMsec.fetch_add(msec, std::memory_order_relaxed);
+        queues[pair].played.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // The first game of a pair to finish leaves its outcome, and the second one scores
+    // the pair. Until then, the pair is in flight and counts for nothing.
+    if (halves) {
+        uint8_t first = 0;
+
+        if (!halves[idx / 2].compare_exchange_strong(first,
+                                                     (uint8_t)(outcome + 1),
+                                                     std::memory_order_acq_rel))
+            c[3 + first - 1 + outcome].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // A match is over once all its games are
+    if (schedule) {
+        std::lock_guard lock(pairingMtx);
+        const size_t    m = idx / games;
+
+        matchScore[m] += outcome;
+        if (++matchGames[m] == games) {
+            const int score[2] = {matchScore[m], 2 * games - matchScore[m]};
+            schedule->finish((int)m, results[pair].ei, score);
+        }
+    }
+
+    r = aggregate(pair);
+
+    return completed.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+// Count a job finished in a previous run, before workers are started. Returns updated
+// totals of its pair. A negative outcome is a job that was cancelled, and only counts as
+// completed.
+void JobQueue::resume(size_t idx, int outcome, Result &r)
+{
+    assert(idx < total);
+
+    if (skip.empty())
+        skip.resize(total);
+
+    if (skip[idx])
+        return;
+
+    skip[idx] = true;
+    resumed++;
+
+    if (batchPairs)
+        queues[job_at(idx).pair].assigned++;
+
+    dispensed.fetch_add(1, std::memory_order_relaxed);
+
+    if (outcome < 0)
+        completed.fetch_add(1, std::memory_order_relaxed);
+    else
+        add_result(0, idx, outcome, 0, r);
+}
+
+// Retire a decided pair: cancel its jobs not dispensed yet, which count as completed, and
+// return them in 'cancelled'. Games in progress still finish, and requeued ones are still
+// played. Returns false if the pair was already retired.
+bool JobQueue::retire(int                  pair,
+                      const std::string   &verdict,
+                      std::vector<size_t> &cancelled)
+{
+    if (queues[pair].retired.exchange(true))
+        return false;
+
+    {
+        std::lock_guard lock(mtx);
+        verdicts[pair] = verdict;
+    }
+
+    const size_t perRound = (size_t)games * results.size();
+    const size_t end      = (size_t)rounds * games;
+    size_t       n        = 0;
+
+    for (size_t k = queues[pair].next.exchange(end); k < end; k++) {
+        const size_t idx = k / games * perRound + (size_t)pair * games + k % games;
+
+        if (skip.empty() || !skip[idx]) {
+            cancelled.push_back(idx);
+            n++;
+        }
+    }
+
+    retiredJobs.fetch_add(n, std::memory_order_relaxed);
+    dispensed.fetch_add(n, std::memory_order_relaxed);
+    completed.fetch_add(n, std::memory_order_relaxed);
+    return true;
+}
+
+bool JobQueue::retired(int pair) const
+{
+    return queues[pair].retired.load(std::memory_order_relaxed);
+}
+
+// Play only the jobs of tournament shard 'index' (of 'count'): those whose index is equal
+// to it modulo 'count'. The others count as finished elsewhere.
+void JobQueue::select_shard(int index, int count)
+{
+    assert(0 <= index && index < count);
+
+    if (skip.empty())
+        skip.resize(total);
+
+    for (size_t idx = 0; idx < total; idx++)
+        if (idx % count != (size_t)index && !skip[idx]) {
+            skip[idx] = true;
+            resumed++;
+            dispensed.fetch_add(1, std::memory_order_relaxed);
+            completed.fetch_add(1, std::memory_order_relaxed);
+        }
+}
+
+// Switch to information pairing, before any job is dispensed, and stop once ratings are
+// known within +/- 'target' Elo (95% confidence), if 'target' > 0. Batches of 'games'
+// games are assigned to pairs as they are dispensed.
+void JobQueue::set_info_pairing(double target)
+{
+    init_batches();
+    targetError = target;
+}
+
+// Batches of 'games' games, with no pair assigned yet
+void JobQueue::init_batches()
+{
+    const size_t batches = (total + games - 1) / games;
+
+    batchPairs = new std::atomic<int>[batches];
+    for (size_t b = 0; b < batches; b++)
+        batchPairs[b].store(-1, std::memory_order_relaxed);
+}
+
+// Pair of a job finished in a previous run, with information pairing: the rest of its
+// batch is played by the same pair. Call before resume().
+void JobQueue::restore_pair(size_t idx, int pair)
+{
+    if (batchPairs)
+        batchPairs[idx / games].store(pair, std::memory_order_relaxed);
+}
+
+// Hand back a job dispensed to a remote worker, which was lost before finishing it
+void JobQueue::requeue(size_t idx)
+{
+    std::lock_guard lock(requeueMtx);
+
+    requeued.push_back(idx);
+    requeuedCount.store(requeued.size(), std::memory_order_relaxed);
+    dispensed.fetch_sub(1, std::memory_order_relaxed);
+}
 
-    assert(idx <= jobs.size());
-    return idx == jobs.size();
+// Take back a requeued job, whose result finally came in. Returns false if the job is not
+// in the queue (anymore).
+bool JobQueue::unqueue(size_t idx)
+{
+    std::lock_guard lock(requeueMtx);
+
+    auto it = std::find(requeued.begin(), requeued.end(), idx);
+    if (it == requeued.end())
+        return false;
+
+    requeued.erase(it);
+    requeuedCount.store(requeued.size(), std::memory_order_relaxed);
+    dispensed.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+// All jobs dispensed (though not necessarily completed)
+bool JobQueue::done() const
+{
+    return stopped || dispensed.load(std::memory_order_relaxed) >= total;
+}
+
+// All jobs completed
+bool JobQueue::finished() const
+{
+    return stopped || completed.load(std::memory_order_relaxed) >= total;
 }
 
 void JobQueue::stop()
 {
-    std::lock_guard lock(mtx);
-    idx = jobs.size();
+    stopped = true;
 }
 
 void JobQueue::set_name(int ei, std::string_view name)
@@ -132,16 +631,127 @@ void JobQueue::set_name(int ei, std::string_view name)
         names[ei] = name;
 }
 
-void JobQueue::print_results(size_t frequency)
+// Time an engine is expected to spend in a game, from its time control
+void JobQueue::set_time_budget(int ei, int64_t msec)
+{
+    budgets[ei] = msec;
+}
+
+// Print the verdict of each pair, or 'undecided' for pairs that were not retired
+void JobQueue::print_verdicts(const char *undecided)
+{
+    std::lock_guard lock(mtx);
+    std::string     out;
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result r = aggregate((int)i);
+
+        out += format("%s vs %s: %s after %i games\n",
+                      names[r.ei[0]],
+                      names[r.ei[1]],
+                      verdicts[i].empty() ? undecided : verdicts[i],
+                      r.total());
+    }
+
+    fputs(out.c_str(), stdout);
+}
+
+// Print the standings of a Swiss or knockout tournament
+void JobQueue::print_standings()
+{
+    std::lock_guard lock(mtx);
+    std::lock_guard pairingLock(pairingMtx);
+
+    fputs(schedule->standings(names).c_str(), stdout);
+}
+
+// Estimate ratings again, from the last estimate. Call with mtx held.
+void JobQueue::update_ratings()
+{
+    std::vector<Result> res(results.size());
+
+    for (size_t i = 0; i < results.size(); i++)
+        res[i] = aggregate((int)i);
+
+    ratings = rating_estimate((int)names.size(), res, {}, &ratings);
+}
+
+// Ratings of all engines, best first, each with the likelihood of being stronger than the
+// next one, and how many games it played, with what score
+std::string JobQueue::format_ratings() const
+{
+    std::vector<int>    order(names.size());
+    std::vector<int>    played(names.size(), 0);
+    std::vector<double> score(names.size(), 0);
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result r  = aggregate((int)i);
+        const double s1 = r.count[RESULT_WIN] + 0.5 * r.count[RESULT_DRAW];
+
+        for (int k = 0; k < 2; k++)
+            played[r.ei[k]] += r.total();
+
+        score[r.ei[0]] += s1;
+        score[r.ei[1]] += r.total() - s1;
+    }
+
+    for (size_t e = 0; e < order.size(); e++)
+        order[e] = (int)e;
+
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return ratings.elo[a] > ratings.elo[b];
+    });
+
+    std::string out = format("Ratings (first move %+.1f +/- %.1f Elo, draw Elo %.1f):\n",
+                             ratings.advantage,
+                             ratings.advantageError,
+                             ratings.drawElo);
+
+    for (size_t i = 0; i < order.size(); i++) {
+        const int e = order[i];
+
+        out += format("%3zu. %s: %+.1f +/- %.1f, %i games, score %.1f%%",
+                      i + 1,
+                      names[e],
+                      ratings.elo[e],
+                      ratings.error(e),
+                      played[e],
+                      played[e] ? 100 * score[e] / played[e] : 0.0);
+        out += i + 1 < order.size()
+                   ? format(", LOS %.1f%%\n", 100 * ratings.los(e, order[i + 1]))
+                   : "\n";
+    }
+
+    return out;
+}
+
+// Print the ratings of all engines
+void JobQueue::print_ratings()
 {
     std::lock_guard lock(mtx);
 
-    if (completed && completed % frequency == 0) {
+    update_ratings();
+    fputs(format_ratings().c_str(), stdout);
+}
+
+// Print the results of each pair, and the 'footer' lines, every 'frequency' jobs
+void JobQueue::print_results(size_t             frequency,
+                             size_t             completedJobs,
+                             const std::string &footer)
+{
+    if (completedJobs && completedJobs % frequency == 0) {
+        std::lock_guard lock(mtx);
         std::string out = "Tournament update:\n";
 
-        // Print out tournament results up to now
-        for (size_t i = 0; i < results.size(); i++) {
-            const Result r = results[i];
+        // Print out tournament results up to now: standings of a Swiss or knockout
+        // tournament, whose pairs change from round to round, else results of each pair
+        if (schedule) {
+            std::lock_guard pairingLock(pairingMtx);
+            out += schedule->standings(names);
+        }
+
+        for (size_t i = 0; !schedule && i < results.size(); i++) {
+            const Result r = aggregate((int)i);
 
             if (r.total()) {
                 char score[8] = "";
@@ -156,15 +766,48 @@ void JobQueue::print_results(size_t frequency)
                               r.count[RESULT_DRAW],
                               score,
                               r.total());
+
+                if (r.pairs())
+                    out += format("  Ptnml(0-2): %i, %i, %i, %i, %i\n",
+                                  r.penta[0],
+                                  r.penta[1],
+                                  r.penta[2],
+                                  r.penta[3],
+                                  r.penta[4]);
+
+                const PairElo e = pair_elo(r);
+                out += format("  Elo: %+.1f +/- %.1f, LOS: %.1f%%\n",
+                              e.elo,
+                              e.error,
+                              e.los * 100);
             }
         }
 
+        // Joint ratings of all engines, updated from the last estimate
+        update_ratings();
+        out += format_ratings();
+
+        // With information pairing, how far ratings are from the target error
+        if (batchPairs && !schedule) {
+            double error = 0;
+
+            for (int ei = 0; ei < ratings.size(); ei++)
+                error = std::max(error, ratings.error(ei));
+
+            out += format("Largest rating error: +/-%.1f Elo", error);
+            out += targetError > 0 ? format(" (target +/-%.1f)\n", targetError) : "\n";
+        }
+
         // Print out average match speed and estimated time to complete (ETA)
-        if (idx < jobs.size()) {
-            assert(idx > 0);
+        const size_t idx = dispensed.load(std::memory_order_relaxed);
+        const size_t unplayed =
+            resumed + retiredJobs.load(std::memory_order_relaxed);  // by this run
+
+        // No estimate before a game of this run is dispensed
+        if (idx < total && idx > unplayed) {
             int64_t elapsed = system_msec() - startedTime;
-            double  speed   = idx / std::max<double>(elapsed, 1.0);  // avoid divide by 0
-            int64_t eta     = int64_t((jobs.size() - idx) / speed);
+            double  speed   = (idx - unplayed) / std::max<double>(elapsed, 1.0);
+            int64_t eta     = int64_t((total - idx) / speed);
             int64_t etaHour = eta / 3600000;
             int64_t etaMinate = (eta % 3600000) / 60000;
             int64_t etaSecond = ((eta % 3600000) % 60000) / 1000;
@@ -177,6 +820,7 @@ void JobQueue::print_results(size_t frequency)
                           etaSecond);
         }
 
+        out += footer;
         fputs(out.c_str(), stdout);
     }
 }
@@ -16,19 +16,32 @@
 
 #pragma once
 
+#include "rating.h"
+
+#include <atomic>
+#include <cstdint>
 #include <mutex>
 #include <string>
 #include <string_view>
 #include <vector>
 
+class Schedule;
+
 // Result for each pair (e1, e2); e1 < e2. Stores trinomial count of game outcomes from
-// e1's point of view.
+// e1's point of view. With -repeat, games 2k and 2k+1 play the same opening with colors
+// swapped, and also form a game pair: its pentanomial count is by e1's score over both
+// games, in half points (0..4). A pair only counts once both of its games are finished.
+// Outcomes of the games where e1 moved first are also counted apart, which tells how
+// much moving first is worth.
 struct Result
 {
     int ei[2];
     int count[3];
+    int penta[5];
+    int first[3];  // outcomes of the games e1 played first
 
     int total() const { return count[0] + count[1] + count[2]; }
+    int pairs() const { return penta[0] + penta[1] + penta[2] + penta[3] + penta[4]; }
 };
 
 // Job: instruction to play a single game
@@ -39,26 +52,127 @@ struct Job
     bool reverse;      // if true, e1 plays second
 };
 
-// Job Queue: consumed by workers to play tournament (thread safe)
+// Job Queue: consumed by workers to play tournament (thread safe). Jobs are generated on
+// demand from their index, and dispensed with one atomic counter per pair. Each worker
+// sticks to the pair it has loaded, until that pair runs dry for the current block of
+// rounds, so that engines are rarely restarted. Results are counted in one shard per
+// worker, and only aggregated when read, so that the per-game path takes no lock and
+// shares no cache line. Jobs handed to remote workers can be requeued, when a worker is
+// lost before returning their result. A pair can be retired once decided (per pair
+// SPRT): its remaining jobs are cancelled, and workers move on to the other pairs.
+// A tournament can also be split into shards (-shard K/N), played by independent
+// processes, each of which only dispenses its own jobs.
+// The expected duration of a game of each pair is estimated from time controls, and
+// from games played so far. Workers that switch pairs go where the most work is left,
+// and near the end, the longest games are dispensed first, so that they do not finish
+// last while other workers sit idle.
+// With information pairing, pairs are not fixed in advance: jobs are dispensed in index
+// order, by batches of 'games' games, and each new batch goes to the pair whose games
+// would most reduce the uncertainty of the joint rating estimate, as results come in.
+// Rounds then only bound the total number of games.
+// Swiss and knockout tournaments play one batch of 'games' games per match of their
+// Schedule, which says who plays once earlier results are in. Until then, workers find
+// no job, and retry later.
 class JobQueue
 {
 public:
-    JobQueue(int engines, int rounds, int games, bool gauntlet);
+    JobQueue(int       engines,
+             int       rounds,
+             int       games,
+             bool      gauntlet,
+             bool      repeat,
+             int       shards,
+             Schedule *schedule = nullptr);
+    ~JobQueue();
 
-    bool pop(Job &j, size_t &idx, size_t &count);
-    void add_result(int pair, int outcome, int count[3]);
-    bool done();
-    void stop();
+    bool   pop(int shard, Job &j, size_t &idx, size_t &count);
+    size_t add_result(int shard, size_t idx, int outcome, int64_t msec, Result &r);
+    void   resume(size_t idx, int outcome, Result &r);
+    bool   retire(int pair, const std::string &verdict, std::vector<size_t> &cancelled);
+    bool   retired(int pair) const;
+    void   select_shard(int index, int count);
+    void   set_info_pairing(double target);
+    void   restore_pair(size_t idx, int pair);
+    void   requeue(size_t idx);
+    bool   unqueue(size_t idx);
+    bool   done() const;
+    bool   finished() const;
+    void   stop();
+    Job    job_at(size_t idx) const;
+    size_t size() const { return total; }
+    int    pair_count() const { return (int)results.size(); }
+    Result result(int pair) const { return aggregate(pair); }
 
     void set_name(int ei, std::string_view name);
-    void print_results(size_t frequency);
+    void set_time_budget(int ei, int64_t msec);
+    void print_results(size_t             frequency,
+                       size_t             completed,
+                       const std::string &footer = "");
+    void print_verdicts(const char *undecided);
+    void print_standings();
+    void print_ratings();
 
-public:
-    std::mutex               mtx;
-    std::vector<Job>         jobs;
-    std::vector<Result>      results;
+private:
+    // Game outcomes, pair scores, then outcomes of the games e1 played first
+    static constexpr int PairCounters = 3 + 5 + 3;
+
+    // Per pair dispatch state, on its own cache line
+    struct alignas(64) PairQueue
+    {
+        std::atomic<size_t>  next;  // next game of the pair, counted across rounds
+        std::atomic<int>     workers;     // number of workers sticking to the pair
+        std::atomic<bool>    retired;     // remaining games cancelled
+        std::atomic<int>     played;      // games whose duration is known
+        std::atomic<int64_t> playedMsec;  // total duration of these games
+        int                  assigned;    // games dispensed or resumed (info pairing)
+    };
+
+    std::mutex               mtx;      // guards names, verdicts and printing
+    std::mutex               requeueMtx;
+    std::vector<size_t>      requeued;  // jobs to dispense again, guarded by requeueMtx
+    std::atomic<size_t>      requeuedCount;
+    std::vector<Result>      results;  // pairs, with counts aggregated on read
     std::vector<std::string> names;
-    size_t                   idx;        // next job index
-    size_t                   completed;  // number of jobs completed
+    std::vector<std::string> verdicts;  // [pair]: why it was retired, guarded by mtx
+    std::vector<int64_t>     budgets;   // [engine]: expected msec spent in a game
+    Ratings                  ratings;   // last estimate, guarded by mtx
+    const int                rounds, games;
+    const size_t             total;  // number of jobs
+    const int                shards;
+    int                      blockRounds;  // rounds dispensed together
+    PairQueue               *queues;    // [pair]
+    std::vector<int>         current;   // [shard]: pair loaded by each worker, or -1
+    std::vector<bool>        skip;      // [idx]: finished in a previous run, if resumed
+    size_t                   shardStride;  // ints per shard, padded to a cache line
+    std::atomic<int>        *counts;       // [shard][pair][outcome, then pair score]
+    std::atomic<uint8_t>    *halves;       // [idx/2]: outcome+1 of first game finished
+    std::atomic<int>         round;        // first round of the block being dispensed
+    std::atomic<size_t>      dispensed;    // number of jobs dispensed
+    std::atomic<size_t>      completed;    // number of jobs completed
+    size_t                   resumed;      // number of jobs finished in a previous run
+    std::atomic<size_t>      retiredJobs;  // number of jobs cancelled, never played
+    std::atomic<bool>        stopped;
+    std::mutex               pairingMtx;   // guards batches and assigned counts
+    std::atomic<int>        *batchPairs;   // [idx/games]: pair of each batch, or -1
+    size_t                   nextIdx;      // next job to dispense, with info pairing
+    double                   targetError;  // Elo, 0 to play all jobs
+    Schedule                *schedule;     // Swiss or knockout, or nullptr
+    std::vector<int>         matchNext;    // [match]: next game, guarded by pairingMtx
+    std::vector<int>         matchScore;   // [match]: half points of ei[0] of its pair
+    std::vector<int>         matchGames;   // [match]: games finished
+    int                      openMatch;    // first match with games left to dispense
     int64_t                  startedTime;
+
+    size_t block_end(int r) const;
+    bool   claim(int pair, int r, size_t &idx);
+    int    select_pair(int r, bool longest) const;
+    void   load_pair(int &pair, int p);
+    bool   pop_batch(Job &j, size_t &idx);
+    int    select_batch_pair() const;
+    bool   pop_match(Job &j, size_t &idx);
+    void   init_batches();
+    double expected_msec(int pair) const;
+    Result aggregate(int pair) const;
+    void   update_ratings();
+    std::string format_ratings() const;
 };
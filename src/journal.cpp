@@ -0,0 +1,227 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "journal.h"
+
+#include "util.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+static const char *JournalHeader = "c-gomoku-cli journal 1";
+
+Journal::Journal(const char        *fileName,
+                 bool               resume,
+                 const std::string &config,
+                 uint64_t          &seed,
+                 size_t             s)
+    : file(nullptr)
+    , stride(s)
+{
+    std::error_code ec;
+    const bool      exists = std::filesystem::file_size(fileName, ec) > 0 && !ec;
+
+    if (exists && !resume)
+        DIE("journal %s already exists, use -resume to continue it\n", fileName);
+
+    if (exists)
+        read(fileName, config, seed);
+
+    DIE_IF(0, !(file = fopen(fileName, "a" FOPEN_TEXT)));
+
+    if (!exists) {
+        // Random openings must be shuffled the same way when resuming
+        if (!seed)
+            seed = (uint64_t)system_msec();
+
+        write(JournalHeader);
+        write("config " + config);
+        write(format("seed %" PRIu64, seed));
+    }
+}
+
+Journal::~Journal()
+{
+    if (file)
+        fclose(file);
+}
+
+void Journal::read(const char *fileName, const std::string &config, uint64_t &seed)
+{
+    FILE *in;
+    DIE_IF(0, !(in = fopen(fileName, "r" FOPEN_TEXT)));
+
+    std::string line;
+    long        valid = 0;  // offset after the last complete line
+    bool        headerOk = false, configOk = false;
+    size_t      n;
+
+    while ((n = string_getline(line, in)) > 0) {
+        // The last line may have been cut short by a crash: ignore it
+        if (n == line.size())
+            break;
+
+        JournalGame g = {.idx     = 0,
+                         .opening = 0,
+                         .pair    = 0,
+                         .outcome = 0,
+                         .black   = -1,
+                         .moves   = 0};
+        unsigned    o;
+        size_t      count;
+        long        offset;
+        int         verdict = 0;  // offset of the verdict in a retire line
+        int         fields;
+
+        if (line == JournalHeader)
+            headerOk = true;
+        else if (const char *tail = string_prefix(line.c_str(), "config "))
+            configOk = config == tail;
+        else if (sscanf(line.c_str(), "seed %" SCNu64, &seed) == 1)
+            ;
+        // Older journals do not record black and moves
+        else if ((fields = sscanf(line.c_str(),
+                                  "game %zu %zu %d %d %d %d",
+                                  &g.idx,
+                                  &g.opening,
+                                  &g.pair,
+                                  &g.outcome,
+                                  &g.black,
+                                  &g.moves))
+                     == 4
+                 || fields == 6)
+            games.push_back(g);
+        else if (sscanf(line.c_str(), "output %u %zu %ld", &o, &count, &offset) == 3
+                 && o < NB_JOURNAL && count <= offsets[o].size() + 1) {
+            // Outputs may have been rewound on a previous resume
+            offsets[o].resize(count);
+            offsets[o].push_back(offset);
+        }
+        else if (sscanf(line.c_str(), "rewind %zu", &count) == 1)
+            forget(count);
+        else if (sscanf(line.c_str(), "retire %d %n", &g.pair, &verdict) == 1 && verdict)
+            verdicts[g.pair] = line.substr(verdict);
+        else
+            DIE("invalid line in journal %s: '%s'\n", fileName, line.c_str());
+
+        valid = ftell(in);
+    }
+
+    fclose(in);
+
+    if (!headerOk)
+        DIE("%s is not a c-gomoku-cli journal\n", fileName);
+    if (!configOk)
+        DIE("journal %s was written for a different tournament\n", fileName);
+
+    // Drop the incomplete line, if any, before appending
+    std::error_code ec;
+    std::filesystem::resize_file(fileName, valid, ec);
+    if (ec)
+        DIE("cannot truncate journal %s: %s\n", fileName, ec.message().c_str());
+}
+
+// Rewind outputs to the last game that reached all of them, and return the number of
+// games written in sequence so far. Games after that one are forgotten, and will be
+// played again.
+size_t Journal::resume_outputs(const std::string fileNames[NB_JOURNAL])
+{
+    size_t written = SIZE_MAX;
+
+    for (int o = 0; o < NB_JOURNAL; o++) {
+        if (fileNames[o].empty())
+            continue;
+
+        // Output added since the journal was created: nothing was written to it yet
+        std::error_code ec;
+        const long      size = (long)std::filesystem::file_size(fileNames[o], ec);
+        if (offsets[o].empty())
+            offsets[o].push_back(ec ? 0 : size);
+
+        // Records that did not reach the disk before a crash do not count
+        size_t count = offsets[o].size() - 1;
+        while (count > 0 && (ec || offsets[o][count] > size))
+            count--;
+
+        written = std::min(written, count);
+    }
+
+    // No output: all games recorded in the journal count
+    if (written == SIZE_MAX)
+        return 0;
+
+    if (forget(written))
+        write(format("rewind %zu", written));
+
+    for (int o = 0; o < NB_JOURNAL; o++) {
+        if (fileNames[o].empty())
+            continue;
+
+        std::error_code ec;
+        std::filesystem::resize_file(fileNames[o], offsets[o][written], ec);
+        if (ec && ec != std::errc::no_such_file_or_directory)
+            DIE("cannot truncate %s: %s\n", fileNames[o].c_str(), ec.message().c_str());
+
+        record_output((JournalOutput)o, written, offsets[o][written]);
+    }
+
+    return written;
+}
+
+// Forget games from the 'count'-th written onwards, and return whether there were any
+bool Journal::forget(size_t count)
+{
+    const size_t before = games.size();
+
+    games.erase(
+        std::remove_if(games.begin(),
+                       games.end(),
+                       [=](const JournalGame &g) { return g.idx / stride >= count; }),
+        games.end());
+
+    return games.size() < before;
+}
+
+void Journal::record_game(const JournalGame &g)
+{
+    write(format("game %zu %zu %d %d %d %d",
+                 g.idx,
+                 g.opening,
+                 g.pair,
+                 g.outcome,
+                 g.black,
+                 g.moves));
+}
+
+void Journal::record_retire(int pair, const std::string &verdict)
+{
+    write(format("retire %d %s", pair, verdict));
+}
+
+void Journal::record_output(JournalOutput o, size_t count, long offset)
+{
+    write(format("output %d %zu %ld", (int)o, count, offset));
+}
+
+void Journal::write(const std::string &line)
+{
+    std::lock_guard lock(mtx);
+
+    fputs(line.c_str(), file);
+    fputc('\n', file);
+    DIE_IF(0, !file_sync(file));
+}
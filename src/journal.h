@@ -0,0 +1,75 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cinttypes>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Outputs whose progress is recorded in the journal
+enum JournalOutput { JOURNAL_PGN, JOURNAL_SGF, JOURNAL_MSG, JOURNAL_SAMPLE, NB_JOURNAL };
+
+// Outcome of a game cancelled before it was played, because its pair was retired
+enum { GAME_CANCELLED = -1 };
+
+// Game recorded as finished in the journal
+struct JournalGame
+{
+    size_t idx, opening;   // game index, and position of its opening (Openings)
+    int    pair, outcome;  // outcome may be GAME_CANCELLED
+    int    black, moves;   // as in GameRecord, black is -1 if unknown
+};
+
+// Journal: append only log of a tournament in progress, synced to disk after each record,
+// from which an interrupted run can be resumed. It records the tournament configuration,
+// the opening seed, each finished game, the verdict of each pair retired by its SPRT, and
+// the file offset after each record written in sequence to each output. On resume, a
+// game counts as finished only if it reached all outputs, and outputs are truncated back
+// to the last such game.
+class Journal
+{
+public:
+    Journal(const char        *fileName,
+            bool               resume,
+            const std::string &config,
+            uint64_t          &seed,
+            size_t             stride = 1);
+    ~Journal();
+
+    size_t resume_outputs(const std::string fileNames[NB_JOURNAL]);
+    const std::vector<JournalGame> &finished() const { return games; }
+    const std::map<int, std::string> &retired() const { return verdicts; }
+
+    void record_game(const JournalGame &g);
+    void record_retire(int pair, const std::string &verdict);
+    void record_output(JournalOutput o, size_t count, long offset);
+
+private:
+    std::mutex                 mtx;
+    FILE                      *file;
+    const size_t               stride;  // games are written every 'stride' indexes
+    std::vector<JournalGame>   games;                // finished games, read on resume
+    std::vector<long>          offsets[NB_JOURNAL];  // [output][count], read on resume
+    std::map<int, std::string> verdicts;  // [pair]: SPRT verdict of retired pairs
+
+    void read(const char *fileName, const std::string &config, uint64_t &seed);
+    bool forget(size_t count);
+    void write(const std::string &line);
+};
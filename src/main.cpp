@@ -17,19 +17,34 @@
  * this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "adaptive.h"
+#include "calibrate.h"
+#include "cluster.h"
 #include "engine.h"
 #include "extern/lz4frame.h"
 #include "game.h"
 #include "jobs.h"
+#include "journal.h"
+#include "merge.h"
 #include "openings.h"
 #include "options.h"
+#include "remote.h"
+#include "schedule.h"
 #include "seqwriter.h"
+#include "server.h"
+#include "simulate.h"
+#include "spsa.h"
 #include "sprt.h"
+#include "transport.h"
 #include "util.h"
 #include "workers.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
 #include <signal.h>
 #include <thread>
@@ -38,11 +53,27 @@ static Options                    options;
 static std::vector<EngineOptions> eo;
 static Openings                  *openings;
 static JobQueue                  *jq;
+static Schedule                  *schedule;
+static Coordinator               *coordinator;
+static RemoteQueue               *remote;
+static ClusterQueue              *cluster;
+static TournamentServer          *server;
+static Journal                   *journal;
 static SeqWriter                 *pgnSeqWriter;
 static SeqWriter                 *sgfSeqWriter;
 static SeqWriter                 *msgSeqWriter;
+static SeqWriter                 *sampleSeqWriter;
 static std::vector<Worker *>      workers;
+static StartupGovernor           *startupGovernor;
+static DeadlineService           *deadlines;
+static CoreBudget                *coreBudget;
+static AdaptiveConcurrency       *adaptive;
+static SPSA                      *spsa;
 static FILE                      *sampleFile;
+static volatile sig_atomic_t      signals;   // SIGINT or SIGTERM received
+static std::atomic<bool>          playing;   // signals are handled by the main loop
+static std::atomic<int>           running;   // worker threads not finished yet
+static std::atomic<bool>          draining;  // no game is started any more
 static LZ4F_compressionContext_t  sampleFileLz4Ctx;
 
 // Compression preference for binary samples
@@ -76,8 +107,16 @@ static void close_sample_file(bool signal_exit)
     }
 }
 
+// Once games are played, signals are handled by the main loop: the first one drains the
+// games in progress, and the second one stops at once. Before that, there is nothing to
+// lose.
 static void signal_handler([[maybe_unused]] int signal)
 {
+    if (playing) {
+        signals = signals + 1;
+        return;
+    }
+
     if (sampleFile) {
         printf("Saving sample file...\n");
     }
@@ -85,12 +124,58 @@ static void signal_handler([[maybe_unused]] int signal)
     _Exit(EXIT_SUCCESS);
 }
 
+// First signal: start no more games, and let those in progress finish
+static void start_drain()
+{
+    printf("Stopping: games in progress have %d s to finish, signal again to stop now\n",
+           options.drain);
+
+    draining = true;
+
+    if (server)
+        server->stop();
+    else if (remote)
+        remote->stop();
+    else if (cluster)
+        cluster->stop();
+    else
+        jq->stop();
+}
+
+// Second signal, or games in progress still running past the drain time: write out the
+// games finished, and exit without waiting for the others
+static void hard_stop()
+{
+    printf("Stopping now, games in progress are lost\n");
+
+    for (SeqWriter *sw : {pgnSeqWriter, sgfSeqWriter, msgSeqWriter, sampleSeqWriter})
+        if (sw)
+            sw->flush();
+
+    if (sampleFile) {
+        printf("Saving sample file...\n");
+    }
+    close_sample_file(true);
+    fflush(stdout);
+    _Exit(EXIT_FAILURE);
+}
+
 static void main_destroy(void)
 {
+    delete deadlines;
+    deadlines = nullptr;
+
     for (Worker *worker : workers)
         delete worker;
     workers.clear();
 
+    // Results may still come in until the coordinator is closed
+    delete coordinator;
+    coordinator = nullptr;
+    delete server;
+    delete remote;
+    delete cluster;
+
     close_sample_file(false);
 
     if (pgnSeqWriter)
@@ -99,31 +184,527 @@ static void main_destroy(void)
         delete sgfSeqWriter;
     if (msgSeqWriter)
         delete msgSeqWriter;
+    if (sampleSeqWriter)
+        delete sampleSeqWriter;
 
+    delete journal;
     delete openings;
     delete jq;
+    delete schedule;
+    delete startupGovernor;
+    delete coreBudget;
+    delete adaptive;
+}
+
+// Write samples of a game to the sample file, compressed in the stream if needed
+static void write_samples(const std::string &data)
+{
+    FileLock fl(sampleFile);
+
+    if (options.sp.compress) {
+        std::vector<char> buf(LZ4F_compressBound(data.size(), &LZ4Pref));
+        const size_t      size = LZ4F_compressUpdate(sampleFileLz4Ctx,
+                                                     buf.data(),
+                                                     buf.size(),
+                                                     data.data(),
+                                                     data.size(),
+                                                     nullptr);
+        fwrite(buf.data(), 1, size, sampleFile);
+    }
+    else
+        fwrite(data.data(), 1, data.size(), sampleFile);
+}
+
+// Compress samples of a game into an LZ4 frame of its own. Concatenated frames are a
+// valid LZ4 stream, and unlike a single stream, can be written in any order.
+static std::string compress_frame(const std::string &data)
+{
+    std::string  frame(LZ4F_compressFrameBound(data.size(), &LZ4Pref), '\0');
+    const size_t size = LZ4F_compressFrame(frame.data(),
+                                           frame.size(),
+                                           data.data(),
+                                           data.size(),
+                                           &LZ4Pref);
+
+    DIE_IF(0, LZ4F_isError(size));
+    frame.resize(size);
+    return frame;
+}
+
+// Everything that defines the job list and where results go: a journal can only be
+// resumed by the same tournament
+static std::string journal_config()
+{
+    std::string config = format("rounds=%d games=%d gauntlet=%d repeat=%d openings=%s "
+                                "random=%d pgn=%s sgf=%s msg=%s sample=%s,%d,%d",
+                                options.rounds,
+                                options.games,
+                                options.gauntlet,
+                                options.repeat,
+                                options.openings,
+                                options.random,
+                                options.pgn,
+                                options.sgf,
+                                options.msg,
+                                options.sp.fileName,
+                                (int)options.sp.format,
+                                options.sp.compress);
+
+    for (const EngineOptions &e : eo)
+        config += format(" engine=%s", e.cmd);
+
+    // Pruning decides the opening of each game pair as results come in
+    if (options.op.prune)
+        config += format(" prune=%d,%g", options.op.prune, options.op.split);
+
+    if (options.pp.mode != PAIRING_FIXED)
+        config += format(" pairing=%s%s",
+                         pairing_name(options.pp),
+                         options.pp.doubleElim ? ",double" : "");
+
+    if (options.shardCount > 1)
+        config += format(" shard=%d/%d", options.shardIndex + 1, options.shardCount);
+
+    return config;
+}
+
+// Read every file under dir once, so that engines find their executables and weight
+// files in the page cache, instead of all hitting the disk at the same time.
+static void prewarm_directory(const std::string &dir)
+{
+    namespace fs = std::filesystem;
+
+    const int64_t     start = system_msec();
+    std::error_code   ec;
+    std::vector<char> buf(1 << 20);
+    size_t            files = 0, bytes = 0;
+
+    for (fs::recursive_directory_iterator
+             it(dir, fs::directory_options::skip_permission_denied, ec),
+         end;
+         !ec && it != end;
+         it.increment(ec)) {
+        if (!it->is_regular_file(ec))
+            continue;
+
+        if (FILE *f = fopen(it->path().string().c_str(), "r" FOPEN_BINARY)) {
+            for (size_t n; (n = fread(buf.data(), 1, buf.size(), f)) > 0;)
+                bytes += n;
+            fclose(f);
+            files++;
+        }
+    }
+
+    printf("Prewarmed %s: %zu files, %.1f MB in %.1fs\n",
+           dir.c_str(),
+           files,
+           bytes / 1048576.0,
+           (system_msec() - start) / 1000.0);
+}
+
+// Options of a tournament played for a coordinator: its command line, but for the
+// resources of this machine, given by 'local'
+static void parse_coordinator_args(const std::vector<std::string> &coordinatorArgs,
+                                   const Options                  &local,
+                                   Options                        &o,
+                                   std::vector<EngineOptions>     &e)
+{
+    std::vector<const char *> args = {"c-gomoku-cli"};
+    for (const std::string &arg : coordinatorArgs)
+        args.push_back(arg.c_str());
+
+    o = Options();
+    e.clear();
+    options_parse((int)args.size(), args.data(), o, e);
+
+    o.connect     = local.connect;
+    o.coordinator = false;
+    o.concurrency = local.concurrency;
+    o.startLimit  = local.startLimit;
+    o.drain       = local.drain;
+    o.cores       = local.cores;
+    o.ap          = local.ap;
+    o.cp          = local.cp;
+    o.calibrate   = local.calibrate;
+    o.prewarm     = local.prewarm;
+    o.log         = local.log;
+    o.debug       = local.debug;
+}
+
+// Worker mode: play the tournament of the coordinator, as defined by its command line,
+// but with the resources of this machine
+static void connect_coordinator()
+{
+    const Options local = options;
+    remote              = new RemoteQueue(local.connect, local.concurrency);
+
+    if (remote->done())
+        DIE("cannot connect to coordinator '%s'\n", local.connect.c_str());
+
+    parse_coordinator_args(remote->coordinator_args(), local, options, eo);
+}
+
+// Server mode: play the tournaments of the spool directory, each started by a copy of
+// this executable
+static void start_server(const char *argv0)
+{
+    std::error_code   ec;
+    const std::string exe  = std::filesystem::read_symlink("/proc/self/exe", ec).string();
+    const std::string self = ec ? std::filesystem::absolute(argv0, ec).string() : exe;
+
+    server = new TournamentServer(options.sv,
+                                  self,
+                                  options.concurrency,
+                                  [](const std::vector<std::string> &args,
+                                     Options                        &o,
+                                     std::vector<EngineOptions>     &e) {
+                                      parse_coordinator_args(args, options, o, e);
+                                  });
+}
+
+static void create_workers()
+{
+    deadlines = new DeadlineService();
+
+    for (int i = 0; i < options.concurrency; i++) {
+        std::string logName;
+
+        if (options.log) {
+            logName = format("c-gomoku-cli.%i.log", i + 1);
+        }
+
+        workers.push_back(new Worker(i, logName.c_str(), startupGovernor, deadlines));
+    }
+}
+
+// Choose the opening of a job
+static void prepare_job(RemoteJob &rj, int threadId)
+{
+    const size_t openingIdx = options.repeat ? rj.idx / 2 : rj.idx;
+    rj.openingRound         = openings->next(rj.opening, openingIdx, threadId);
+}
+
+// Skipped games still take their turn in sequence, and their LZ4 frame
+static void skip_outputs(size_t seq)
+{
+    for (SeqWriter *sw : {pgnSeqWriter, sgfSeqWriter, msgSeqWriter})
+        if (sw)
+            sw->push(seq, "");
+
+    if (sampleSeqWriter)
+        sampleSeqWriter->push(seq, options.sp.compress ? compress_frame("") : "");
+}
+
+// Retire a pair whose SPRT is decided. Its cancelled games are recorded as such, so
+// that outputs written in sequence go on past them.
+static void retire_pair(int pair, const char *verdict)
+{
+    std::vector<size_t> cancelled;
+
+    if (!jq->retire(pair, verdict, cancelled))
+        return;
+
+    if (journal)
+        journal->record_retire(pair, verdict);
+
+    for (size_t idx : cancelled) {
+        const size_t openingIdx = options.repeat ? idx / 2 : idx;
+
+        if (journal)
+            journal->record_game({.idx     = idx,
+                                  .opening = openings->position(openingIdx),
+                                  .pair    = pair,
+                                  .outcome = GAME_CANCELLED,
+                                  .black   = -1,
+                                  .moves   = 0});
+
+        skip_outputs(idx / options.shardCount);
+    }
+}
+
+// Record a finished game, played by a local thread or a remote worker: write its
+// outputs, and update results
+static void record_game(int id, int shard, const Job &job, const GameRecord &r)
+{
+    const size_t idx        = r.idx;
+    const size_t seq        = idx / options.shardCount;  // in outputs of this shard
+    const size_t openingIdx = options.repeat ? idx / 2 : idx;
+    const int    wld        = r.outcome;
+
+    for (int i = 0; i < 2; i++)
+        jq->set_name(job.ei[i], r.names[i]);
+
+    // Record the game as finished before its outputs, which may be rewound on resume
+    if (journal)
+        journal->record_game({.idx     = idx,
+                              .opening = openings->position(openingIdx),
+                              .pair    = job.pair,
+                              .outcome = wld,
+                              .black   = r.black,
+                              .moves   = r.moves});
+
+    openings->add_result(openingIdx, wld, r.black, r.moves);
+
+    if (!options.gauntlet || !options.saveLoseOnly || wld == RESULT_LOSS) {
+        // Write to PGN file
+        if (pgnSeqWriter)
+            pgnSeqWriter->push(seq, r.pgn);
+
+        // Write to SGF file
+        if (sgfSeqWriter)
+            sgfSeqWriter->push(seq, r.sgf);
+
+        // Write engine messages to TXT file
+        if (msgSeqWriter)
+            msgSeqWriter->push(seq, r.msg);
+
+        // Write to Sample file
+        if (!sampleSeqWriter && sampleFile)
+            write_samples(r.samples);
+        else if (sampleSeqWriter && options.sp.compress)
+            sampleSeqWriter->push(seq, compress_frame(r.samples));
+        else if (sampleSeqWriter)
+            sampleSeqWriter->push(seq, r.samples);
+    }
+    else
+        skip_outputs(seq);
+
+    // Write to stdout a one line summary of the game
+    printf("[%d] Finished game %zu %s\n", id, idx + 1, r.summary.c_str());
+
+    // Pair update
+    Result       res;
+    const size_t completed = jq->add_result(shard, idx, wld, r.duration, res);
+    printf("Score of %s vs %s: %d - %d - %d  [%.3f] %d\n",
+           r.names[0].c_str(),
+           r.names[1].c_str(),
+           res.count[RESULT_WIN],
+           res.count[RESULT_LOSS],
+           res.count[RESULT_DRAW],
+           (res.count[RESULT_WIN] + 0.5 * res.count[RESULT_DRAW]) / res.total(),
+           res.total());
+
+    if (res.pairs())
+        printf("Ptnml(0-2): %d, %d, %d, %d, %d\n",
+               res.penta[0],
+               res.penta[1],
+               res.penta[2],
+               res.penta[3],
+               res.penta[4]);
+
+    // SPRT update, independently for each pair
+    if (options.sprt && !jq->retired(job.pair))
+        if (const char *verdict = options.sprtParam.verdict(res))
+            retire_pair(job.pair, verdict);
+
+    // SPSA update, once both games of a pair are in
+    if (spsa)
+        spsa->add_result(idx, wld);
+
+    // Tournament update
+    jq->print_results((size_t)options.games,
+                      completed,
+                      adaptive ? adaptive->report() : "");
 }
 
 static void main_init(int argc, const char **argv)
 {
     signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+#ifndef __MINGW32__
+    // A dead engine (or engine host) must show up as a write error, not kill us
+    signal(SIGPIPE, SIG_IGN);
+#endif
     atexit(main_destroy);
 
     options_parse(argc, argv, options, eo);
 
-    jq = new JobQueue((int)eo.size(), options.rounds, options.games, options.gauntlet);
+    // Simulated SPRT runs play no game
+    if (options.sim.enabled) {
+        simulate_sprt(options);
+        return;
+    }
+
+    if (!options.connect.empty())
+        connect_coordinator();
+
+    // Scale time controls to the speed of this machine, under tournament load
+    if (options.calibrate)
+        calibrate(options.cp, options.concurrency, eo);
+
+    // Prewarm the directory of each local engine (once per directory)
+    if (options.prewarm) {
+        std::vector<std::string> dirs;
+
+        for (const EngineOptions &e : eo) {
+            std::string              cwd, run;
+            std::vector<std::string> args;
+            transport_parse_cmd(e.cmd.c_str(), cwd, run, args);
+
+            // Engines found in PATH have no directory of their own
+            if (e.host.empty() && !cwd.empty() && cwd != "./"
+                && std::find(dirs.begin(), dirs.end(), cwd) == dirs.end()) {
+                dirs.push_back(cwd);
+                prewarm_directory(cwd);
+            }
+        }
+    }
+
+    if (options.startLimit > 0)
+        startupGovernor = new StartupGovernor(options.startLimit);
+
+    // Games of local workers cost the cores of their engines, within the budget
+    std::vector<int> costs, caps;
+    bool             capped = false;
+
+    for (const EngineOptions &e : eo) {
+        costs.push_back(e.cpuQuota > 0 ? (int)ceil(e.cpuQuota)
+                                       : std::max(1, e.numThreads));
+        caps.push_back(e.maxInstances);
+        capped |= e.maxInstances > 0;
+    }
+
+    if (options.cores || capped)
+        coreBudget = new CoreBudget(options.cores, costs, caps);
+
+    if (options.ap.enabled)
+        adaptive = new AdaptiveConcurrency(options.ap);
+
+    // Outputs, journal and job queue all belong to the coordinator
+    if (remote) {
+        create_workers();
+        return;
+    }
+
+    // Or to the coordinator of each tournament, in server mode
+    if (!options.sv.dir.empty()) {
+        start_server(argv[0]);
+        create_workers();
+        return;
+    }
+
+    // Each shard writes files of its own, merged afterwards by 'merge'
+    if (options.shardCount > 1)
+        for (std::string *fileName : {&options.pgn,
+                                      &options.sgf,
+                                      &options.msg,
+                                      &options.sp.fileName,
+                                      &options.journal})
+            if (!fileName->empty())
+                *fileName = shard_file_name(*fileName, options.shardIndex);
+
+    // Open the journal first: it decides the opening seed, and rewinds outputs
+    size_t written = 0;
+
+    if (!options.journal.empty()) {
+        journal = new Journal(options.journal.c_str(),
+                              options.resume,
+                              journal_config(),
+                              options.srand,
+                              options.shardCount);
+
+        const std::string outputs[NB_JOURNAL] = {options.pgn,
+                                                 options.sgf,
+                                                 options.msg,
+                                                 options.sp.fileName};
+        written = journal->resume_outputs(outputs);
+    }
+
+    // Swiss and knockout tournaments decide pairs as results come in
+    if (options.pp.mode == PAIRING_SWISS || options.pp.mode == PAIRING_KNOCKOUT)
+        schedule = new Schedule(options.pp, (int)eo.size(), options.rounds);
+
+    jq = new JobQueue((int)eo.size(),
+                      options.rounds,
+                      options.games,
+                      options.gauntlet,
+                      options.repeat,
+                      options.concurrency
+                          + (options.coordinator ? options.rp.maxWorkers : 0),
+                      schedule);
+
+    if (options.pp.mode == PAIRING_INFO)
+        jq->set_info_pairing(options.pp.target);
+
+    if (options.shardCount > 1)
+        jq->select_shard(options.shardIndex, options.shardCount);
+
+    // Each game pair is an iteration of SPSA
+    if (options.spsa.enabled)
+        spsa = new SPSA(options.spsa,
+                        options.rounds * options.games / 2,
+                        options.resume,
+                        options.srand);
+
+    // Engine names given on the command line are known before any game is played, as
+    // needed to report pairs finished in a previous run
+    for (size_t i = 0; i < eo.size(); i++)
+        if (!eo[i].name.empty())
+            jq->set_name((int)i, eo[i].name);
+
+    // Time an engine is expected to use per game, before durations are observed: assume
+    // that a quarter of the board gets filled
+    const int moves = options.boardSize * options.boardSize / 8;
+
+    for (size_t i = 0; i < eo.size(); i++)
+        jq->set_time_budget((int)i,
+                            eo[i].timeoutMatch
+                                ? eo[i].timeoutMatch + eo[i].increment * moves
+                                : eo[i].timeoutTurn * moves);
+
     openings = new Openings(options.openings.c_str(), options.random, options.srand);
 
+    if (!options.op.report.empty() || options.op.prune)
+        openings->enable_stats(options.op, options.repeat);
+
+    // Cluster nodes write their outputs to the cluster directory, merged afterwards
+    if (!options.cl.dir.empty()) {
+        cluster = new ClusterQueue(options.cl,
+                                   journal_config(),
+                                   jq,
+                                   options.sprt ? &options.sprtParam : nullptr);
+        create_workers();
+        return;
+    }
+
+    // Each output records its progress in the journal, if any
+    auto onWrite = [](JournalOutput o) -> SeqWriteCallback {
+        if (!journal)
+            return nullptr;
+        return [o](size_t count, long offset) {
+            journal->record_output(o, count, offset);
+        };
+    };
+
     if (!options.pgn.empty())
-        pgnSeqWriter = new SeqWriter(options.pgn.c_str(), "a" FOPEN_TEXT);
+        pgnSeqWriter = new SeqWriter(options.pgn.c_str(),
+                                     "a" FOPEN_TEXT,
+                                     written,
+                                     onWrite(JOURNAL_PGN));
 
     if (!options.sgf.empty())
-        sgfSeqWriter = new SeqWriter(options.sgf.c_str(), "a" FOPEN_TEXT);
+        sgfSeqWriter = new SeqWriter(options.sgf.c_str(),
+                                     "a" FOPEN_TEXT,
+                                     written,
+                                     onWrite(JOURNAL_SGF));
 
     if (!options.msg.empty())
-        msgSeqWriter = new SeqWriter(options.msg.c_str(), "a" FOPEN_TEXT);
+        msgSeqWriter = new SeqWriter(options.msg.c_str(),
+                                     "a" FOPEN_TEXT,
+                                     written,
+                                     onWrite(JOURNAL_MSG));
 
-    if (!options.sp.fileName.empty()) {
+    // With a journal or shards, samples are written in sequence too, so that they can be
+    // rewound or merged
+    if (!options.sp.fileName.empty() && (journal || options.shardCount > 1)) {
+        sampleSeqWriter =
+            new SeqWriter(options.sp.fileName.c_str(),
+                          options.sp.format != SAMPLE_FORMAT_CSV ? "a" FOPEN_BINARY
+                                                                 : "a" FOPEN_TEXT,
+                          written,
+                          onWrite(JOURNAL_SAMPLE));
+    }
+    else if (!options.sp.fileName.empty()) {
         if (options.sp.compress) {
             DIE_IF(0,
                    !(sampleFile = fopen(options.sp.fileName.c_str(), "w" FOPEN_BINARY)));
@@ -145,64 +726,154 @@ static void main_init(int argc, const char **argv)
         }
     }
 
-    // Prepare Workers[]
-    for (int i = 0; i < options.concurrency; i++) {
-        std::string logName;
+    // Count games finished in a previous run
+    if (journal && !journal->finished().empty()) {
+        Result res = {};
 
-        if (options.log) {
-            logName = format("c-gomoku-cli.%i.log", i + 1);
+        for (const JournalGame &g : journal->finished()) {
+            jq->restore_pair(g.idx, g.pair);
+            jq->resume(g.idx, g.outcome, res);
+
+            if (g.outcome != GAME_CANCELLED) {
+                const size_t openingIdx = options.repeat ? g.idx / 2 : g.idx;
+                openings->restore(openingIdx, g.opening);
+                openings->add_result(openingIdx, g.outcome, g.black, g.moves);
+            }
+        }
+
+        printf("Resume from journal %s: %zu games finished\n",
+               options.journal.c_str(),
+               journal->finished().size());
+
+        // Pairs retired in a previous run keep their verdict, whatever games finished
+        // after it
+        for (const auto &[pair, verdict] : journal->retired())
+            retire_pair(pair, verdict.c_str());
+
+        for (int pair = 0; options.sprt && pair < jq->pair_count(); pair++) {
+            const Result r = jq->result(pair);
+
+            if (r.total() && !jq->retired(pair))
+                if (const char *verdict = options.sprtParam.verdict(r))
+                    retire_pair(pair, verdict);
         }
+    }
 
-        workers.push_back(new Worker(i, logName.c_str()));
+    // Serve jobs to remote workers, on shards of their own
+    if (options.coordinator) {
+        std::vector<std::string> args(argv + 1, argv + argc);
+        coordinator = new Coordinator(options.rp.bind,
+                                      options.rp.port,
+                                      args,
+                                      jq,
+                                      options.concurrency,
+                                      options.rp.maxWorkers,
+                                      [](RemoteJob &rj) { prepare_job(rj, 0); },
+                                      [](int shard, const Job &job, const GameRecord &r) {
+                                          record_game(shard + 1, shard, job, r);
+                                      });
     }
+
+    create_workers();
+}
+
+static bool tournament_over()
+{
+    return server        ? server->done()
+           : remote      ? remote->done()
+           : cluster     ? cluster->done()
+           : coordinator ? jq->finished()
+                         : jq->done();
+}
+
+// Next job to play: from the coordinator in worker mode, from any of its tournaments in
+// server mode ('t'), from the cluster directory in cluster mode, else from the local
+// queue
+static bool next_job(Worker *w, RemoteJob &rj, TournamentServer::Tournament *&t)
+{
+    if (draining)
+        return false;
+
+    if (server)
+        return (t = server->pop(rj));
+
+    if (remote)
+        return remote->pop(rj);
+
+    if (cluster) {
+        if (!cluster->pop(rj))
+            return false;
+
+        prepare_job(rj, w->id);
+        return true;
+    }
+
+    while (!jq->pop(w->id - 1, rj.job, rj.idx, rj.count)) {
+        // Jobs of a lost remote worker are requeued, until all results are in, and
+        // matches of a Swiss or knockout tournament wait for earlier results
+        if (coordinator ? jq->finished() : jq->done())
+            return false;
+        system_sleep(coordinator ? 1000 : 100);
+    }
+
+    prepare_job(rj, w->id);
+    return true;
 }
 
 static void thread_start(Worker *w)
 {
-    std::string opening_str, messages;
-    Job         job   = {};
-    Engine engines[2] = {{w, options.debug, !options.msg.empty() ? &messages : nullptr},
-                         {w, options.debug, !options.msg.empty() ? &messages : nullptr}};
-    int    ei[2]      = {-1, -1};  // eo[ei[0]] plays eo[ei[1]]: initialize with invalid
-                                   // values to start
-    size_t idx = 0, count = 0;     // game idx and count (shared across workers)
-
-    while (jq->pop(job, idx, count)) {
+    std::string  messages;
+    std::string *msgs       = server || !options.msg.empty() ? &messages : nullptr;
+    RemoteJob    rj         = {};
+    Engine       engines[2] = {{w, options.debug, msgs}, {w, options.debug, msgs}};
+    int          ei[2]      = {-1, -1};  // eo[ei[0]] plays eo[ei[1]]: initialize with
+                                         // invalid values to start
+
+    // Tournament of the job in server mode, and of the previous one
+    TournamentServer::Tournament *t = nullptr, *last = nullptr;
+
+    // Parked workers (adaptive concurrency) wait between games
+    while ((!adaptive || adaptive->wait_active(w->id - 1)) && next_job(w, rj, t)) {
+        const Job   &job = rj.job;
+        const size_t idx = rj.idx;  // game idx (shared across workers)
+
+        // Options of the tournament: the one of this process, or one of the server
+        const Options                    &o        = t ? t->options : options;
+        const std::vector<EngineOptions> &tourEo   = t ? t->eo : eo;
+        const bool                        switched = t != last;
+        last                                       = t;
+
+        // Wait for the cores of both engines (and their instance caps)
+        if (coreBudget)
+            coreBudget->acquire(job.ei);
+
         // Clear all previous engine messages and write game index
-        if (!options.msg.empty()) {
+        messages.clear();
+        if (!o.msg.empty()) {
             messages = "----------------------------------------\n";
             messages += format("Game ID: %zu\n", idx + 1);
         }
 
         // Engine stop/start, as needed
         for (int i = 0; i < 2; i++) {
-            if (job.ei[i] != ei[i]) {
+            if (job.ei[i] != ei[i] || switched) {
                 ei[i] = job.ei[i];
                 engines[i].terminate();
-                engines[i].start(eo[ei[i]].cmd.c_str(),
-                                 eo[ei[i]].name.c_str(),
-                                 eo[ei[i]].tolerance);
-                jq->set_name(ei[i], engines[i].name);
+                engines[i].start(tourEo[ei[i]]);
             }
             // Re-init engine if it crashed/timeout previously
             else if (!engines[i].is_ok() || engines[i].is_crashed()) {
                 engines[i].terminate();
-                engines[i].start(eo[ei[i]].cmd.c_str(),
-                                 eo[ei[i]].name.c_str(),
-                                 eo[ei[i]].tolerance);
+                engines[i].start(tourEo[ei[i]]);
             }
         }
 
-        // Choose opening position
-        size_t openingRound =
-            openings->next(opening_str, options.repeat ? idx / 2 : idx, w->id);
-
         // Play 1 game
         Game  game(job.round, job.game, w);
         Color color = BLACK;  // black play first in gomoku/renju by default
 
-        if (!game.load_opening(opening_str, options, openingRound, color)) {
-            DIE("[%d] illegal OPENING '%s'\n", w->id, opening_str.c_str());
+        if (!game.load_opening(rj.opening, o, rj.openingRound, color)) {
+            DIE("[%d] illegal OPENING '%s'\n", w->id, rj.opening.c_str());
         }
 
         const int blackIdx = color ^ job.reverse;
@@ -211,125 +882,174 @@ static void thread_start(Worker *w)
         printf("[%d] Started game %zu of %zu (%s vs %s)\n",
                w->id,
                idx + 1,
-               count,
+               rj.count,
                engines[blackIdx].name.c_str(),
                engines[whiteIdx].name.c_str());
 
-        if (!options.msg.empty())
+        if (!o.msg.empty())
             messages += format("Engines: %s x %s\n",
                                engines[blackIdx].name,
                                engines[whiteIdx].name);
 
-        const EngineOptions *eoPair[2] = {&eo[ei[0]], &eo[ei[1]]};
-        const int            wld       = game.play(options, engines, eoPair, job.reverse);
+        const EngineOptions *eoPair[2] = {&tourEo[ei[0]], &tourEo[ei[1]]};
+        EngineOptions        variant[2];
+
+        // SPSA plays the plus and minus variants of the tuned options
+        if (spsa) {
+            variant[0] = tourEo[ei[0]];
+            variant[1] = tourEo[ei[1]];
+            spsa->perturb(idx, variant);
+            eoPair[0] = &variant[0];
+            eoPair[1] = &variant[1];
+        }
+
+        const int64_t started = system_msec();
+        const int     wld     = game.play(o, engines, eoPair, job.reverse);
 
-        if (!options.gauntlet || !options.saveLoseOnly || wld == RESULT_LOSS) {
-            // Write to PGN file
-            if (pgnSeqWriter)
-                pgnSeqWriter->push(idx, game.export_pgn(idx + 1));
+        // Render the outputs that the tournament writes
+        GameRecord r;
+        r.idx      = idx;
+        r.outcome  = wld;
+        r.duration = system_msec() - started;
+        r.moves    = (int)game.info.size();
+        r.black    = blackIdx;
 
-            // Write to SGF file
-            if (sgfSeqWriter)
-                sgfSeqWriter->push(idx, game.export_sgf(idx + 1));
+        if (coreBudget)
+            coreBudget->release(job.ei);
 
-            // Write engine messages to TXT file
-            if (msgSeqWriter)
-                msgSeqWriter->push(idx, messages);
+        if (adaptive)
+            adaptive->record_game(game.state == STATE_TIME_LOSS,
+                                  game.overruns,
+                                  (int)game.info.size());
+        r.names[0] = engines[0].name;
+        r.names[1] = engines[1].name;
 
-            // Write to Sample file
-            if (sampleFile)
-                game.export_samples(sampleFile, options.sp.format, sampleFileLz4Ctx);
+        if (!o.gauntlet || !o.saveLoseOnly || wld == RESULT_LOSS) {
+            if (!o.pgn.empty())
+                r.pgn = game.export_pgn(idx + 1);
+            if (!o.sgf.empty())
+                r.sgf = game.export_sgf(idx + 1);
+            if (!o.msg.empty())
+                r.msg = messages;
+            if (!o.sp.fileName.empty())
+                game.export_samples(r.samples, o.sp.format);
         }
 
-        // Write to stdout a one line summary of the game
         const char *ResultTxt[3] = {"0-1", "1/2-1/2", "1-0"};  // Black-White
         std::string result, reason;
         game.decode_state(result, reason, ResultTxt);
+        r.summary = format("(%s vs %s): %s {%s}",
+                           engines[blackIdx].name,
+                           engines[whiteIdx].name,
+                           result,
+                           reason);
 
-        printf("[%d] Finished game %zu (%s vs %s): %s {%s}\n",
-               w->id,
-               idx + 1,
-               engines[blackIdx].name.c_str(),
-               engines[whiteIdx].name.c_str(),
-               result.c_str(),
-               reason.c_str());
-
-        // Pair update
-        int wldCount[3] = {0};
-        jq->add_result(job.pair, wld, wldCount);
-        const int n =
-            wldCount[RESULT_WIN] + wldCount[RESULT_LOSS] + wldCount[RESULT_DRAW];
-        printf("Score of %s vs %s: %d - %d - %d  [%.3f] %d\n",
-               engines[0].name.c_str(),
-               engines[1].name.c_str(),
-               wldCount[RESULT_WIN],
-               wldCount[RESULT_LOSS],
-               wldCount[RESULT_DRAW],
-               (wldCount[RESULT_WIN] + 0.5 * wldCount[RESULT_DRAW]) / n,
-               n);
-
-        // SPRT update
-        if (options.sprt && options.sprtParam.done(wldCount)) {
-            jq->stop();
+        // Workers send the game to the coordinator, which records it
+        if (t) {
+            printf("[%d] Finished game %zu of %s %s\n",
+                   w->id,
+                   idx + 1,
+                   t->name.c_str(),
+                   r.summary.c_str());
+            server->push(t, r);
+        }
+        else if (remote) {
+            printf("[%d] Finished game %zu %s\n", w->id, idx + 1, r.summary.c_str());
+            remote->push(r);
         }
+        // Cluster nodes write batches of games, with one LZ4 frame per game
+        else if (cluster) {
+            printf("[%d] Finished game %zu %s\n", w->id, idx + 1, r.summary.c_str());
 
-        // Tournament update
-        jq->print_results((size_t)options.games);
+            if (options.sp.compress)
+                r.samples = compress_frame(r.samples);
+            cluster->push(r);
+        }
+        else
+            record_game(w->id, w->id - 1, job, r);
     }
 
     for (int i = 0; i < 2; i++) {
         engines[i].terminate();
     }
+
+    running--;
 }
 
 int main(int argc, const char **argv)
 {
+    // Subcommand: merge the outputs of the shards of a tournament
+    if (argc > 1 && !strcmp(argv[1], "merge")) {
+        options_parse(argc - 1, argv + 1, options, eo);
+        merge_outputs(options, eo);
+        return 0;
+    }
+
     main_init(argc, argv);
 
+    if (options.sim.enabled)
+        return 0;
+
     // Start threads[]
     std::vector<std::thread> threads;
+    running = options.concurrency;
+    playing = true;
 
     for (int i = 0; i < options.concurrency; i++) {
         threads.emplace_back(thread_start, workers[i]);
     }
 
-    // Main thread loop: check deadline overdue at regular intervals
+    // Main thread loop: adapt concurrency and handle signals, until the tournament is
+    // over and all games are finished. Deadlines are enforced by the deadline service.
+    int64_t drainStart = 0;
+
     do {
         system_sleep(100);
 
-        // We want some tolerance on small delays here. Given a choice, it's
-        // best to wait for the worker thread to notice an overdue deadline,
-        // which it will handled nicely by counting the game as lost for the
-        // offending engine, and continue. Enforcing deadlines from the master
-        // thread is the last resort solution, because it is an unrecovrable
-        // error. At this point we are likely to face a completely unresponsive
-        // engine, where any attempt at I/O will block the master thread, on top
-        // of the already blocked worker. Hence, we must DIE().
-        for (int i = 0; i < options.concurrency; i++) {
-            int64_t overdue = workers[i]->deadline_overdue();
-            if (overdue > 0) {
-                workers[i]->deadline_callback_once();
-            }
-            else if (overdue > 3000) {
-                if (workers[i]->log)
-                    fprintf(workers[i]->log,
-                            "deadline: %s is unresponsive [%s] after %" PRId64 "\n",
-                            workers[i]->deadline.engineName.c_str(),
-                            workers[i]->deadline.description.c_str(),
-                            workers[i]->deadline.timeLimit);
-
-                DIE("[%d] engine %s is unresponsive to [%s]\n",
-                    workers[i]->id,
-                    workers[i]->deadline.engineName.c_str(),
-                    workers[i]->deadline.description.c_str());
-            }
+        if (adaptive)
+            adaptive->tick();
+
+        if (signals && !drainStart) {
+            drainStart = system_msec();
+            start_drain();
         }
-    } while (!jq->done());
+
+        if (signals > 1
+            || (drainStart && system_msec() - drainStart > options.drain * 1000))
+            hard_stop();
+
+        // Parked workers have no game left
+        if (adaptive && (drainStart || tournament_over()))
+            adaptive->stop();
+    } while (running > 0 || (!drainStart && !tournament_over()));
 
     // Join threads[]
     for (std::thread &th : threads) {
         th.join();
     }
 
+    // Final report of per pair SPRT, by the process that counts results
+    if (options.sprt && !remote && !cluster) {
+        printf("SPRT verdicts:\n");
+        jq->print_verdicts("undecided");
+    }
+
+    if (schedule && !remote) {
+        printf("Final standings:\n");
+        jq->print_standings();
+    }
+
+    if (spsa)
+        printf("%s", spsa->report().c_str());
+
+    if (openings && (!options.op.report.empty() || options.op.prune))
+        openings->write_report(options.op.report);
+
+    // Final ratings, which need no PGN round trip through an external tool
+    if (!remote && !cluster && !server) {
+        printf("Final ratings:\n");
+        jq->print_ratings();
+    }
+
     return 0;
 }
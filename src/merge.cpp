@@ -0,0 +1,398 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "merge.h"
+
+#include "cluster.h"
+#include "game.h"
+#include "jobs.h"
+#include "openings.h"
+#include "util.h"
+
+#include <cstring>
+#include <functional>
+
+// Separator line before the messages of each game, in the -msg file
+static const char *MsgSeparator = "----------------------------------------";
+
+using RecordCallback = std::function<void(size_t number, const std::string &record)>;
+
+// Reads the games of a text output (PGN, SGF or messages) one record at a time. A record
+// starts with a line that begins with 'start', and holds the game number after 'key'.
+class RecordReader
+{
+public:
+    RecordReader(const std::string &fileName, const char *start, const char *key);
+    ~RecordReader();
+
+    bool next();  // false at end of file
+
+    std::string record;
+    size_t      number;  // game index + 1
+
+private:
+    FILE       *in;
+    const char *start, *key;
+    std::string line;     // first line of the next record, once read
+    bool        pending;  // whether 'line' holds it
+};
+
+RecordReader::RecordReader(const std::string &fileName, const char *s, const char *k)
+    : number(0)
+    , start(s)
+    , key(k)
+    , pending(false)
+{
+    DIE_IF(0, !(in = fopen(fileName.c_str(), "r" FOPEN_TEXT)));
+
+    while (!pending && string_getline(line, in))
+        pending = string_prefix(line.c_str(), start);
+}
+
+RecordReader::~RecordReader()
+{
+    fclose(in);
+}
+
+bool RecordReader::next()
+{
+    if (!pending)
+        return false;
+
+    record  = line + "\n";
+    pending = false;
+
+    while (!pending && string_getline(line, in)) {
+        if (!(pending = string_prefix(line.c_str(), start)))
+            record += line + "\n";
+    }
+
+    const char *p = strstr(record.c_str(), key);
+    number        = p ? strtoull(p + strlen(key), nullptr, 10) : 0;
+    return true;
+}
+
+std::string shard_file_name(const std::string &fileName, int index)
+{
+    return format("%s.%d", fileName, index + 1);
+}
+
+// Merge the records of each shard into 'fileName', in game order. Each shard file is
+// already in game order. Returns the number of records.
+static size_t merge_records(const std::string    &fileName,
+                            int                   shards,
+                            const char           *start,
+                            const char           *key,
+                            const RecordCallback &onRecord)
+{
+    std::vector<RecordReader *> readers;
+    std::vector<bool>           live;
+
+    for (int i = 0; i < shards; i++) {
+        readers.push_back(new RecordReader(shard_file_name(fileName, i), start, key));
+        live.push_back(readers[i]->next());
+    }
+
+    FILE  *out;
+    size_t count = 0;
+    DIE_IF(0, !(out = fopen(fileName.c_str(), "w" FOPEN_TEXT)));
+
+    while (true) {
+        int first = -1;
+
+        for (int i = 0; i < shards; i++)
+            if (live[i] && (first < 0 || readers[i]->number < readers[first]->number))
+                first = i;
+
+        if (first < 0)
+            break;
+
+        const std::string &record = readers[first]->record;
+        DIE_IF(0, fwrite(record.data(), 1, record.size(), out) != record.size());
+
+        if (onRecord)
+            onRecord(readers[first]->number, record);
+
+        count++;
+        live[first] = readers[first]->next();
+    }
+
+    DIE_IF(0, fclose(out) != 0);
+
+    for (RecordReader *r : readers)
+        delete r;
+
+    return count;
+}
+
+static void read_exact(FILE *in, const std::string &fileName, std::string &out, size_t n)
+{
+    const size_t size = out.size();
+    out.resize(size + n);
+
+    if (fread(out.data() + size, 1, n, in) != n)
+        DIE("invalid LZ4 frame in %s\n", fileName.c_str());
+}
+
+static uint32_t read_le32(const std::string &s, size_t pos)
+{
+    const uint8_t *p = (const uint8_t *)s.data() + pos;
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Read one LZ4 frame, as is, by walking its header and block sizes. Returns false at end
+// of file.
+static bool read_lz4_frame(FILE *in, const std::string &fileName, std::string &frame)
+{
+    const int c = fgetc(in);
+    if (c == EOF)
+        return false;
+
+    // Magic number, FLG and BD bytes, optional content size and dictionary ID, checksum
+    frame.assign(1, (char)c);
+    read_exact(in, fileName, frame, 5);
+
+    if (read_le32(frame, 0) != 0x184D2204)
+        DIE("invalid LZ4 frame in %s\n", fileName.c_str());
+
+    const uint8_t flags = frame[4];
+    read_exact(in, fileName, frame, (flags & 0x08 ? 8 : 0) + (flags & 0x01 ? 4 : 0) + 1);
+
+    // Blocks (with an optional checksum each), end mark, and optional content checksum
+    while (true) {
+        const size_t pos = frame.size();
+        read_exact(in, fileName, frame, 4);
+
+        const uint32_t blockSize = read_le32(frame, pos);
+        if (!blockSize)
+            break;
+
+        const size_t dataSize = (blockSize & 0x7FFFFFFF) + (flags & 0x10 ? 4 : 0);
+        read_exact(in, fileName, frame, dataSize);
+    }
+
+    read_exact(in, fileName, frame, flags & 0x04 ? 4 : 0);
+    return true;
+}
+
+// Merge sample files. Compressed samples of a shard are written as one LZ4 frame per
+// game, which are interleaved in game order. Uncompressed samples have no game boundary,
+// so they are concatenated, shard after shard.
+static void merge_samples(const SampleParams &sp, int shards)
+{
+    const char *mode = sp.format != SAMPLE_FORMAT_CSV ? FOPEN_BINARY : FOPEN_TEXT;
+    std::vector<FILE *> ins;
+
+    for (int i = 0; i < shards; i++) {
+        const std::string fileName = shard_file_name(sp.fileName, i);
+        FILE             *in;
+        DIE_IF(0, !(in = fopen(fileName.c_str(), format("r%s", mode).c_str())));
+        ins.push_back(in);
+    }
+
+    FILE *out;
+    DIE_IF(0, !(out = fopen(sp.fileName.c_str(), format("w%s", mode).c_str())));
+
+    std::string data;
+
+    if (sp.compress) {
+        // Game idx is frame idx / shards of shard idx % shards
+        for (bool any = true; any;) {
+            any = false;
+
+            for (int i = 0; i < shards; i++)
+                if (read_lz4_frame(ins[i], shard_file_name(sp.fileName, i), data)) {
+                    DIE_IF(0, fwrite(data.data(), 1, data.size(), out) != data.size());
+                    any = true;
+                }
+        }
+    }
+    else {
+        std::vector<char> buf(1 << 20);
+
+        for (FILE *in : ins)
+            for (size_t n; (n = fread(buf.data(), 1, buf.size(), in)) > 0;)
+                DIE_IF(0, fwrite(buf.data(), 1, n, out) != n);
+    }
+
+    DIE_IF(0, fclose(out) != 0);
+
+    for (FILE *in : ins)
+        fclose(in);
+}
+
+// Concatenate the outputs of each batch of a cluster tournament, as written by the node
+// that completed it. Batch outputs are in game order.
+static void merge_cluster(const Options &o, size_t total)
+{
+    const std::string *fileNames[NB_JOURNAL] = {&o.pgn, &o.sgf, &o.msg, &o.sp.fileName};
+    FILE              *outs[NB_JOURNAL]      = {};
+
+    for (int i = 0; i < NB_JOURNAL; i++)
+        if (!fileNames[i]->empty())
+            DIE_IF(0, !(outs[i] = fopen(fileNames[i]->c_str(), "w" FOPEN_BINARY)));
+
+    const size_t      batches = (total + o.cl.batch - 1) / o.cl.batch;
+    size_t            merged  = 0;
+    std::vector<char> buf(1 << 20);
+    std::string       node;
+
+    for (size_t b = 0; b < batches; b++) {
+        FILE *in = fopen(cluster_file_name(o.cl.dir, b, "done").c_str(), "r");
+
+        if (!in)
+            continue;
+
+        string_getline(node, in);
+        fclose(in);
+        merged++;
+
+        for (int i = 0; i < NB_JOURNAL; i++) {
+            const std::string fileName =
+                cluster_output_name(o.cl.dir, b, node, (JournalOutput)i);
+
+            if (!outs[i] || !(in = fopen(fileName.c_str(), "r" FOPEN_BINARY)))
+                continue;
+
+            for (size_t n; (n = fread(buf.data(), 1, buf.size(), in)) > 0;)
+                DIE_IF(0, fwrite(buf.data(), 1, n, outs[i]) != n);
+            fclose(in);
+        }
+    }
+
+    for (FILE *out : outs)
+        if (out)
+            DIE_IF(0, fclose(out) != 0);
+
+    printf("Merged %zu of %zu batches from %s\n", merged, batches, o.cl.dir.c_str());
+}
+
+// Merge the outputs of each shard, counting games of the merged PGN
+static void merge_shards(const Options &o, const RecordCallback &countGame)
+{
+    if (!o.pgn.empty()) {
+        const size_t n =
+            merge_records(o.pgn, o.shardCount, "[Event \"", "[Event \"", countGame);
+        printf("Merged %zu games into %s\n", n, o.pgn.c_str());
+    }
+
+    if (!o.sgf.empty()) {
+        const size_t n = merge_records(o.sgf, o.shardCount, "(;", "GN[", nullptr);
+        printf("Merged %zu games into %s\n", n, o.sgf.c_str());
+    }
+
+    if (!o.msg.empty()) {
+        const size_t n =
+            merge_records(o.msg, o.shardCount, MsgSeparator, "Game ID: ", nullptr);
+        printf("Merged %zu games into %s\n", n, o.msg.c_str());
+    }
+
+    if (!o.sp.fileName.empty()) {
+        merge_samples(o.sp, o.shardCount);
+        printf("Merged samples into %s\n", o.sp.fileName.c_str());
+    }
+}
+
+// Value of a tag in a PGN record
+static std::string pgn_tag(const std::string &record, const char *name)
+{
+    const std::string tag   = format("[%s \"", name);
+    const size_t      start = record.find(tag);
+
+    if (start == std::string::npos)
+        return "";
+
+    const size_t end = record.find('"', start + tag.size());
+    return record.substr(start + tag.size(), end - start - tag.size());
+}
+
+void merge_outputs(const Options &o, const std::vector<EngineOptions> &eo)
+{
+    if (o.shardCount < 2 && o.cl.dir.empty())
+        DIE("merge needs the -shard K/N or -cluster option of the tournament\n");
+
+    JobQueue jq((int)eo.size(), o.rounds, o.games, o.gauntlet, o.repeat, 1);
+    Openings openings(o.openings.c_str(), o.random, o.srand);
+    Result   res = {};
+
+    // PGN results are from the point of view of colors: replay the opening to know which
+    // engine of the pair played black
+    auto countGame = [&](size_t number, const std::string &record) {
+        const size_t idx = number - 1;
+        const Job    job = jq.job_at(idx);
+
+        if (!number || job.round >= o.rounds)
+            DIE("invalid game number %zu in %s\n", number, o.pgn.c_str());
+
+        std::string  opening;
+        const size_t openingRound = openings.next(opening, o.repeat ? idx / 2 : idx, 0);
+        Game         game(job.round, job.game, nullptr);
+        Color        color = BLACK;
+
+        if (!game.load_opening(opening, o, openingRound, color))
+            DIE("illegal OPENING '%s'\n", opening.c_str());
+
+        const int         blackIdx = color ^ job.reverse;
+        const std::string result   = pgn_tag(record, "Result");
+        int               outcome;
+
+        jq.set_name(job.ei[blackIdx], pgn_tag(record, "Black"));
+        jq.set_name(job.ei[blackIdx ^ 1], pgn_tag(record, "White"));
+
+        if (result == "0-1")  // Black-White (see Game::export_pgn)
+            outcome = blackIdx == 0 ? RESULT_WIN : RESULT_LOSS;
+        else if (result == "1-0")
+            outcome = blackIdx == 0 ? RESULT_LOSS : RESULT_WIN;
+        else if (result == "1/2-1/2")
+            outcome = RESULT_DRAW;
+        else
+            return;
+
+        jq.resume(idx, outcome, res);
+    };
+
+    if (!o.cl.dir.empty()) {
+        merge_cluster(o, jq.size());
+
+        if (!o.pgn.empty()) {
+            RecordReader reader(o.pgn, "[Event \"", "[Event \"");
+
+            while (reader.next())
+                countGame(reader.number, reader.record);
+        }
+    }
+    else {
+        merge_shards(o, countGame);
+    }
+
+    if (o.pgn.empty()) {
+        printf("No PGN file: results are not recomputed\n");
+        return;
+    }
+
+    jq.print_results(1, 1);
+
+    if (o.sprt) {
+        std::vector<size_t> cancelled;
+
+        for (int pair = 0; pair < jq.pair_count(); pair++)
+            if (const char *verdict = o.sprtParam.verdict(jq.result(pair)))
+                jq.retire(pair, verdict, cancelled);
+
+        printf("SPRT verdicts:\n");
+        jq.print_verdicts("undecided");
+    }
+}
@@ -0,0 +1,30 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "options.h"
+
+#include <string>
+#include <vector>
+
+// Output file of tournament shard 'index' (0 based), for a file name of the command line
+std::string shard_file_name(const std::string &fileName, int index);
+
+// Merge the outputs of all shards (or cluster nodes) of a tournament, played with the
+// same options, in game order, and recompute the results of the tournament from the
+// merged PGN file
+void merge_outputs(const Options &o, const std::vector<EngineOptions> &eo);
@@ -16,11 +16,16 @@
 
 #include "openings.h"
 
+#include "game.h"
 #include "util.h"
 
+#include <algorithm>
 #include <cassert>
 #include <string>
 
+// How a game pair split, in LineStats::pairs
+enum { PAIR_DECISIVE, PAIR_SPLIT, PAIR_DRAWN };
+
 Openings::Openings(const char *fileName, bool random, uint64_t srand) : file(nullptr)
 {
     if (*fileName) {
@@ -37,18 +42,22 @@ Openings::Openings(const char *fileName, bool random, uint64_t srand) : file(nul
 
         index.pop_back();  // EOF offset must be removed
 
+        order.resize(index.size());
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = i;
+
         if (random) {
-            // Shuffle o.index[], which will be read sequentially from the beginning. This
+            // Shuffle o.order[], which will be read sequentially from the beginning. This
             // allows consistent treatment of random and !random, and guarantees no
             // repetition N-cycles in the random case, rather than sqrt(N) (birthday
             // paradox) if random seek each time.
             uint64_t seed = srand ? srand : (uint64_t)system_msec();
 
-            for (size_t i = index.size() - 1; i > 0; i--) {
+            for (size_t i = order.size() - 1; i > 0; i--) {
                 const size_t j   = prng(seed) % (i + 1);
-                long         tmp = index[i];
-                index[i]         = index[j];
-                index[j]         = tmp;
+                size_t       tmp = order[i];
+                order[i]         = order[j];
+                order[j]         = tmp;
             }
         }
 
@@ -72,13 +81,179 @@ size_t Openings::next(std::string &opening_str, size_t idx, int threadId)
 
     // Read opening string from file
     std::string line;
+    size_t      round;
 
     {
         std::lock_guard lock(mtx);
-        DIE_IF(threadId, fseek(file, index[idx % index.size()], SEEK_SET) < 0);
-        DIE_IF(threadId, !string_getline(line, file));
+        const size_t    position = slot_position(idx);
+        read_line(line, order[position % order.size()], threadId);
+        round = position / order.size();
     }
 
     opening_str = std::move(line);
-    return idx / index.size();
+    return round;
+}
+
+// Count results per line from now on, and drop lines with pruning
+void Openings::enable_stats(const OpeningParams &params, bool pairs)
+{
+    std::lock_guard lock(mtx);
+
+    op     = params;
+    repeat = pairs;
+    live   = order.size();
+    stats.assign(order.size(), LineStats{});
+}
+
+// Position of the opening of game idx, as passed to next(): with pruning, the one taken
+// by its game pair, if any yet
+size_t Openings::position(size_t idx)
+{
+    std::lock_guard lock(mtx);
+    auto            it = slots.find(idx);
+    return op.prune && it != slots.end() ? it->second.position : idx;
+}
+
+// Game pair idx took 'position' in a previous run, with pruning
+void Openings::restore(size_t idx, size_t position)
+{
+    std::lock_guard lock(mtx);
+
+    if (op.prune && !slots.count(idx)) {
+        slots[idx] = {.position = position, .games = 0, .outcome = 0};
+        cursor     = std::max(cursor, position + 1);
+    }
+}
+
+// Count a finished game of opening idx: 'outcome' is from the point of view of engine 0
+// of the pair, and 'black' is the engine that played black, or -1 if unknown
+void Openings::add_result(size_t idx, int outcome, int black, int moves)
+{
+    std::lock_guard lock(mtx);
+
+    if (stats.empty())
+        return;
+
+    auto       it = slots.find(idx);
+    const auto position = op.prune && it != slots.end() ? it->second.position : idx;
+    LineStats &ls       = stats[order[position % order.size()]];
+
+    if (black >= 0) {
+        ls.colors[black ? 2 - outcome : outcome]++;
+        ls.moves += moves;
+    }
+
+    if (!repeat)
+        return;
+
+    // Game pairs count once both games are finished
+    if (it == slots.end())
+        it = slots.emplace(idx, Slot{.position = idx, .games = 0, .outcome = 0}).first;
+
+    if (++it->second.games < 2) {
+        it->second.outcome = outcome;
+        return;
+    }
+
+    const int first = it->second.outcome;
+    slots.erase(it);
+
+    ls.pairs[first == RESULT_DRAW || outcome == RESULT_DRAW ? PAIR_DRAWN
+             : first == outcome                             ? PAIR_DECISIVE
+                                                            : PAIR_SPLIT]++;
+
+    // The last line in play is never dropped
+    const int pairs = ls.pairs[0] + ls.pairs[1] + ls.pairs[2];
+
+    if (op.prune && !ls.dropped && live > 1 && pairs >= op.prune
+        && ls.pairs[PAIR_SPLIT] >= op.split * pairs) {
+        ls.dropped = true;
+        live--;
+    }
+}
+
+// Write the results of each line played to 'fileName', if any, and print a summary
+void Openings::write_report(const std::string &fileName)
+{
+    std::lock_guard lock(mtx);
+    FILE           *out    = nullptr;
+    size_t          played = 0;
+
+    if (!fileName.empty()) {
+        DIE_IF(0, !(out = fopen(fileName.c_str(), "w" FOPEN_TEXT)));
+        fprintf(out,
+                "%6s %6s %6s %6s %6s %6s %6s %6s %6s %7s %-7s %s\n",
+                "line",
+                "games",
+                "black",
+                "draw",
+                "white",
+                "pairs",
+                "2-0",
+                "1-1",
+                "drawn",
+                "moves",
+                "status",
+                "opening");
+    }
+
+    for (size_t l = 0; l < stats.size(); l++) {
+        const LineStats &ls    = stats[l];
+        const int        games = ls.colors[0] + ls.colors[1] + ls.colors[2];
+        const int        pairs = ls.pairs[0] + ls.pairs[1] + ls.pairs[2];
+
+        if (!games && !pairs)
+            continue;
+
+        played++;
+
+        if (out) {
+            std::string opening;
+            read_line(opening, l, 0);
+            fprintf(out,
+                    "%6zu %6d %6d %6d %6d %6d %6d %6d %6d %7.1f %-7s %s\n",
+                    l + 1,
+                    games,
+                    ls.colors[RESULT_WIN],
+                    ls.colors[RESULT_DRAW],
+                    ls.colors[RESULT_LOSS],
+                    pairs,
+                    ls.pairs[PAIR_DECISIVE],
+                    ls.pairs[PAIR_SPLIT],
+                    ls.pairs[PAIR_DRAWN],
+                    games ? (double)ls.moves / games : 0.0,
+                    ls.dropped ? "dropped" : "-",
+                    opening.c_str());
+        }
+    }
+
+    if (out)
+        DIE_IF(0, fclose(out) != 0);
+
+    printf("Openings: %zu lines played, %zu dropped\n", played, stats.size() - live);
+}
+
+// Position of the opening of game pair idx: fixed, unless pruning, where a new pair takes
+// the next position of a line still in play
+size_t Openings::slot_position(size_t idx)
+{
+    if (!op.prune)
+        return idx;
+
+    auto it = slots.find(idx);
+
+    if (it != slots.end())
+        return it->second.position;
+
+    while (stats[order[cursor % order.size()]].dropped)
+        cursor++;
+
+    slots[idx] = {.position = cursor, .games = 0, .outcome = 0};
+    return cursor++;
+}
+
+void Openings::read_line(std::string &line, size_t l, int threadId)
+{
+    DIE_IF(threadId, fseek(file, index[l], SEEK_SET) < 0);
+    DIE_IF(threadId, !string_getline(line, file));
 }
@@ -16,11 +16,23 @@
 
 #pragma once
 
+#include "options.h"
+
+#include <cstdint>
 #include <cstdio>
+#include <map>
 #include <mutex>
 #include <string>
 #include <vector>
 
+// Openings: lines of the opening file, dispensed in a fixed sequence (thread safe). The
+// opening of a game is at position idx of the sequence (idx / 2 for game pairs with
+// -repeat), which cycles over the lines, in file or shuffled order.
+// Optionally, results are also counted per line: by color, by how game pairs split, and
+// game lengths, for a report. With pruning, lines whose game pairs are mostly split by
+// color (each engine won with the same color: the opening decides, not the engines)
+// are dropped, and positions are no longer fixed: each new game pair takes the next
+// position of a line that is still in play.
 class Openings
 {
 public:
@@ -29,8 +41,41 @@ public:
 
     size_t next(std::string &opening_str, size_t idx, int threadId);
 
+    void   enable_stats(const OpeningParams &op, bool repeat);
+    size_t position(size_t idx);
+    void   restore(size_t idx, size_t position);
+    void   add_result(size_t idx, int outcome, int black, int moves);
+    void   write_report(const std::string &fileName);
+
 private:
-    std::mutex        mtx;
-    FILE             *file;
-    std::vector<long> index;  // vector of file offsets
+    // Results of the games played from one line. Outcomes are from black's point of view,
+    // pairs are won twice by the same engine, split by color, or drawn at least once.
+    struct LineStats
+    {
+        int     colors[3];
+        int     pairs[3];
+        int64_t moves;
+        bool    dropped;
+    };
+
+    // Game pair in progress: its position, and the outcome of its first game
+    struct Slot
+    {
+        size_t position;
+        int    games, outcome;
+    };
+
+    std::mutex             mtx;
+    FILE                  *file;
+    std::vector<long>      index;  // file offset of each line
+    std::vector<size_t>    order;  // line at each position of the sequence, mod its size
+    std::vector<LineStats> stats;  // [line], empty if not enabled
+    std::map<size_t, Slot> slots;  // [idx]: game pairs in progress
+    OpeningParams          op;
+    bool                   repeat = false;
+    size_t                 cursor = 0;  // next position, with pruning
+    size_t                 live   = 0;  // lines not dropped
+
+    size_t slot_position(size_t idx);
+    void   read_line(std::string &line, size_t position, int threadId);
 };
@@ -16,13 +16,17 @@
 
 #include "options.h"
 
+#include "remote.h"
+#include "transport.h"
 #include "util.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cctype>
 #include <climits>
 #include <cstring>
 #include <iostream>
+#include <thread>
 
 // Gomocup time control is in format 'matchtime|turntime' or only 'matchtime'
 static void options_parse_tc_gomocup(const char *s, EngineOptions &eo)
@@ -65,6 +69,12 @@ static int options_parse_eo(int argc, const char **argv, int i, EngineOptions &e
         else if ((tail = string_prefix(argv[i], "name="))) {
             eo.name = tail;
         }
+        else if ((tail = string_prefix(argv[i], "host="))) {
+            eo.host = tail;
+        }
+        else if ((tail = string_prefix(argv[i], "token="))) {
+            eo.token = transport_read_token(tail);
+        }
         else if ((tail = string_prefix(argv[i], "tc="))) {
             options_parse_tc_gomocup(tail, eo);
         }
@@ -83,6 +93,15 @@ static int options_parse_eo(int argc, const char **argv, int i, EngineOptions &e
         else if ((tail = string_prefix(argv[i], "tolerance="))) {
             eo.tolerance = (int64_t)(atof(tail) * 1000);
         }
+        else if ((tail = string_prefix(argv[i], "cpuquota="))) {
+            eo.cpuQuota = atof(tail);
+        }
+        else if ((tail = string_prefix(argv[i], "fastpath="))) {
+            eo.fastPath = atoi(tail) != 0;
+        }
+        else if ((tail = string_prefix(argv[i], "instances="))) {
+            eo.maxInstances = atoi(tail);
+        }
         else if ((tail = string_prefix(argv[i], "option."))) {
             eo.options.push_back(tail);  // store "name=value" string
         }
@@ -117,6 +136,12 @@ static int options_parse_openings(int argc, const char **argv, int i, Options &o
         }
         else if ((tail = string_prefix(argv[i], "srand=")))
             o.srand = (uint64_t)atoll(tail);
+        else if ((tail = string_prefix(argv[i], "report=")))
+            o.op.report = tail;
+        else if ((tail = string_prefix(argv[i], "prune=")))
+            o.op.prune = atoi(tail);
+        else if ((tail = string_prefix(argv[i], "split=")))
+            o.op.split = atof(tail);
         else
             DIE("Illegal token in -openings: '%s'\n", argv[i]);
 
@@ -155,6 +180,14 @@ static int options_parse_sprt(int argc, const char **argv, int i, Options &o)
             o.sprtParam.alpha = atof(tail);
         else if ((tail = string_prefix(argv[i], "beta=")))
             o.sprtParam.beta = atof(tail);
+        else if ((tail = string_prefix(argv[i], "model="))) {
+            if (!strcmp(tail, "pentanomial"))
+                o.sprtParam.pentanomial = true;
+            else if (!strcmp(tail, "trinomial"))
+                o.sprtParam.pentanomial = false;
+            else
+                DIE("Illegal SPRT model: '%s'\n", tail);
+        }
         else
             DIE("Illegal token in -sprt: '%s'\n", argv[i]);
 
@@ -213,6 +246,252 @@ static int options_parse_sample(int argc, const char **argv, int i, Options &o)
     return i - 1;
 }
 
+static int options_parse_calibrate(int argc, const char **argv, int i, Options &o)
+{
+    o.calibrate = true;
+
+    while (i < argc && argv[i][0] != '-') {
+        const char *tail = NULL;
+
+        if ((tail = string_prefix(argv[i], "ref=")))
+            o.cp.refSpeed = atof(tail);
+        else
+            DIE("Illegal token in -calibrate: '%s'\n", argv[i]);
+
+        i++;
+    }
+
+    if (o.cp.refSpeed <= 0)
+        DIE("Invalid reference speed in -calibrate\n");
+
+    return i - 1;
+}
+
+static int options_parse_coordinator(int argc, const char **argv, int i, Options &o)
+{
+    o.coordinator = true;
+    o.rp.port     = COORDINATOR_PORT;
+
+    while (i < argc && argv[i][0] != '-') {
+        const char *tail = NULL;
+
+        if ((tail = string_prefix(argv[i], "bind=")))
+            o.rp.bind = tail;
+        else if ((tail = string_prefix(argv[i], "port=")))
+            o.rp.port = tail;
+        else if ((tail = string_prefix(argv[i], "workers=")))
+            o.rp.maxWorkers = atoi(tail);
+        else
+            DIE("Illegal token in -coordinator: '%s'\n", argv[i]);
+
+        i++;
+    }
+
+    if (o.rp.maxWorkers < 1)
+        DIE("Invalid number of workers in -coordinator\n");
+
+    return i - 1;
+}
+
+static int options_parse_server(int argc, const char **argv, int i, Options &o)
+{
+    if (i >= argc || argv[i][0] == '-')
+        DIE("-server needs a spool directory\n");
+
+    o.sv.dir = argv[i++];
+
+    while (i < argc && argv[i][0] != '-') {
+        const char *tail = NULL;
+
+        if ((tail = string_prefix(argv[i], "port=")))
+            o.sv.port = atoi(tail);
+        else
+            DIE("Illegal token in -server: '%s'\n", argv[i]);
+
+        i++;
+    }
+
+    if (o.sv.port < 1 || o.sv.port > 65535)
+        DIE("Invalid port in -server\n");
+
+    return i - 1;
+}
+
+static int options_parse_cluster(int argc, const char **argv, int i, Options &o)
+{
+    while (i < argc && argv[i][0] != '-') {
+        const char *tail = NULL;
+
+        if ((tail = string_prefix(argv[i], "dir=")))
+            o.cl.dir = tail;
+        else if ((tail = string_prefix(argv[i], "batch=")))
+            o.cl.batch = atoi(tail);
+        else if ((tail = string_prefix(argv[i], "lease=")))
+            o.cl.lease = atoi(tail);
+        else
+            DIE("Illegal token in -cluster: '%s'\n", argv[i]);
+
+        i++;
+    }
+
+    if (o.cl.dir.empty() || o.cl.batch < 1 || o.cl.lease < 1)
+        DIE("Invalid -cluster parameters\n");
+
+    return i - 1;
+}
+
+static int options_parse_adaptive(int argc, const char **argv, int i, Options &o)
+{
+    o.ap.enabled = true;
+
+    while (i < argc && argv[i][0] != '-') {
+        const char *tail = NULL;
+
+        if ((tail = string_prefix(argv[i], "min=")))
+            o.ap.min = atoi(tail);
+        else if ((tail = string_prefix(argv[i], "max=")))
+            o.ap.max = atoi(tail);
+        else if ((tail = string_prefix(argv[i], "interval=")))
+            o.ap.interval = atoi(tail);
+        else
+            DIE("Illegal token in -adaptive: '%s'\n", argv[i]);
+
+        i++;
+    }
+
+    if (o.ap.min < 1 || (o.ap.max && o.ap.max < o.ap.min) || o.ap.interval < 1)
+        DIE("Invalid -adaptive parameters\n");
+
+    return i - 1;
+}
+
+static int options_parse_pairing(int argc, const char **argv, int i, Options &o)
+{
+    if (i < argc && !strcmp(argv[i], "fixed"))
+        o.pp.mode = PAIRING_FIXED;
+    else if (i < argc && !strcmp(argv[i], "info"))
+        o.pp.mode = PAIRING_INFO;
+    else if (i < argc && !strcmp(argv[i], "swiss"))
+        o.pp.mode = PAIRING_SWISS;
+    else if (i < argc && !strcmp(argv[i], "knockout"))
+        o.pp.mode = PAIRING_KNOCKOUT;
+    else
+        DIE("Invalid -pairing mode: expected fixed, info, swiss or knockout\n");
+
+    i++;
+
+    while (i < argc && argv[i][0] != '-') {
+        const char *tail = NULL;
+
+        if ((tail = string_prefix(argv[i], "target=")))
+            o.pp.target = atof(tail);
+        else if (!strcmp(argv[i], "double") && o.pp.mode == PAIRING_KNOCKOUT)
+            o.pp.doubleElim = true;
+        else
+            DIE("Illegal token in -pairing: '%s'\n", argv[i]);
+
+        i++;
+    }
+
+    if (o.pp.target < 0)
+        DIE("Invalid -pairing target\n");
+
+    return i - 1;
+}
+
+static int options_parse_simulate(int argc, const char **argv, int i, Options &o)
+{
+    o.sim.enabled = true;
+
+    while (i < argc && argv[i][0] != '-') {
+        const char *tail = NULL;
+
+        if ((tail = string_prefix(argv[i], "elo=")))
+            o.sim.elo = atof(tail);
+        else if ((tail = string_prefix(argv[i], "draws=")))
+            o.sim.draws = atof(tail);
+        else if ((tail = string_prefix(argv[i], "bias=")))
+            o.sim.bias = atof(tail);
+        else if ((tail = string_prefix(argv[i], "runs=")))
+            o.sim.runs = atoi(tail);
+        else if ((tail = string_prefix(argv[i], "seed=")))
+            o.sim.seed = strtoull(tail, NULL, 10);
+        else
+            DIE("Illegal token in -simulate: '%s'\n", argv[i]);
+
+        i++;
+    }
+
+    if (o.sim.draws < 0 || o.sim.draws >= 1 || o.sim.runs < 1)
+        DIE("Invalid -simulate parameters\n");
+
+    return i - 1;
+}
+
+// param=NAME,START,MIN,MAX,C
+static SPSAParam parse_spsa_param(const char *spec)
+{
+    SPSAParam   p     = {};
+    const char *comma = strchr(spec, ',');
+    char        tail[4][64];
+
+    if (!comma || comma == spec
+        || sscanf(comma + 1,
+                  "%63[^,],%63[^,],%63[^,],%63s",
+                  tail[0],
+                  tail[1],
+                  tail[2],
+                  tail[3])
+               != 4)
+        DIE("Invalid -spsa param '%s': expected NAME,START,MIN,MAX,C\n", spec);
+
+    p.name    = std::string(spec, comma - spec);
+    p.start   = atof(tail[0]);
+    p.min     = atof(tail[1]);
+    p.max     = atof(tail[2]);
+    p.c       = atof(tail[3]);
+    p.integer = !strchr(tail[0], '.') && !strchr(tail[1], '.') && !strchr(tail[2], '.');
+
+    if (p.min >= p.max || p.start < p.min || p.start > p.max || p.c <= 0)
+        DIE("Invalid -spsa param '%s'\n", spec);
+
+    return p;
+}
+
+static int options_parse_spsa(int argc, const char **argv, int i, Options &o)
+{
+    o.spsa.enabled = true;
+
+    while (i < argc && argv[i][0] != '-') {
+        const char *tail = NULL;
+
+        if ((tail = string_prefix(argv[i], "file=")))
+            o.spsa.file = tail;
+        else if ((tail = string_prefix(argv[i], "param=")))
+            o.spsa.params.push_back(parse_spsa_param(tail));
+        else if ((tail = string_prefix(argv[i], "r=")))
+            o.spsa.r = atof(tail);
+        else if ((tail = string_prefix(argv[i], "A=")))
+            o.spsa.A = atof(tail);
+        else if ((tail = string_prefix(argv[i], "alpha=")))
+            o.spsa.alpha = atof(tail);
+        else if ((tail = string_prefix(argv[i], "gamma=")))
+            o.spsa.gamma = atof(tail);
+        else
+            DIE("Illegal token in -spsa: '%s'\n", argv[i]);
+
+        i++;
+    }
+
+    if (o.spsa.file.empty() || o.spsa.params.empty())
+        DIE("-spsa needs a checkpoint file, and at least one param\n");
+
+    if (o.spsa.r <= 0 || o.spsa.A < 0 || o.spsa.alpha <= 0 || o.spsa.gamma < 0)
+        DIE("Invalid -spsa parameters\n");
+
+    return i - 1;
+}
+
 static void check_rule_code(GameRule gr)
 {
     bool supported = false;
@@ -233,7 +512,7 @@ void options_parse(int                         argc,
                    std::vector<EngineOptions> &eo)
 {
     EngineOptions each;
-    bool          eachSet = false;
+    bool          eachSet = false, concurrencySet = false;
 
     for (int i = 1; i < argc; i++) {
         if (!strcmp(argv[i], "-repeat"))
@@ -246,8 +525,18 @@ void options_parse(int                         argc,
             o.saveLoseOnly = true;
         else if (!strcmp(argv[i], "-log"))
             o.log = true;
-        else if (!strcmp(argv[i], "-concurrency"))
-            o.concurrency = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-concurrency")) {
+            o.concurrency  = atoi(argv[++i]);
+            concurrencySet = true;
+        }
+        else if (!strcmp(argv[i], "-cores"))
+            o.cores = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-startlimit"))
+            o.startLimit = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-drain"))
+            o.drain = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-prewarm"))
+            o.prewarm = true;
         else if (!strcmp(argv[i], "-each")) {
             i       = options_parse_eo(argc, argv, i + 1, each);
             eachSet = true;
@@ -269,6 +558,35 @@ void options_parse(int                         argc,
             o.sgf = argv[++i];
         else if (!strcmp(argv[i], "-msg"))
             o.msg = argv[++i];
+        else if (!strcmp(argv[i], "-journal"))
+            o.journal = argv[++i];
+        else if (!strcmp(argv[i], "-resume"))
+            o.resume = true;
+        else if (!strcmp(argv[i], "-coordinator"))
+            i = options_parse_coordinator(argc, argv, i + 1, o);
+        else if (!strcmp(argv[i], "-connect"))
+            o.connect = argv[++i];
+        else if (!strcmp(argv[i], "-server"))
+            i = options_parse_server(argc, argv, i + 1, o);
+        else if (!strcmp(argv[i], "-weight"))
+            o.weight = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-cluster"))
+            i = options_parse_cluster(argc, argv, i + 1, o);
+        else if (!strcmp(argv[i], "-adaptive"))
+            i = options_parse_adaptive(argc, argv, i + 1, o);
+        else if (!strcmp(argv[i], "-pairing"))
+            i = options_parse_pairing(argc, argv, i + 1, o);
+        else if (!strcmp(argv[i], "-simulate"))
+            i = options_parse_simulate(argc, argv, i + 1, o);
+        else if (!strcmp(argv[i], "-spsa"))
+            i = options_parse_spsa(argc, argv, i + 1, o);
+        else if (!strcmp(argv[i], "-shard")) {
+            int k = 0, n = 0;
+            if (sscanf(argv[++i], "%d/%d", &k, &n) != 2 || k < 1 || k > n)
+                DIE("Invalid -shard '%s', expected K/N with 1 <= K <= N\n", argv[i]);
+            o.shardIndex = k - 1;
+            o.shardCount = n;
+        }
         else if (!strcmp(argv[i], "-resign"))
             i = options_parse_adjudication(argc,
                                            argv,
@@ -283,6 +601,8 @@ void options_parse(int                         argc,
             i = options_parse_sprt(argc, argv, i + 1, o);
         else if (!strcmp(argv[i], "-sample"))
             i = options_parse_sample(argc, argv, i + 1, o);
+        else if (!strcmp(argv[i], "-calibrate"))
+            i = options_parse_calibrate(argc, argv, i + 1, o);
         else if (!strcmp(argv[i], "-rule")) {
             o.gameRule = (GameRule)atoi(argv[++i]);
             check_rule_code(o.gameRule);
@@ -315,6 +635,12 @@ void options_parse(int                         argc,
             if (!each.name.empty())
                 eo[i].name = each.name;
 
+            if (!each.host.empty())
+                eo[i].host = each.host;
+
+            if (!each.token.empty())
+                eo[i].token = each.token;
+
             for (size_t j = 0; j < each.options.size(); j++)
                 eo[i].options.push_back(each.options[j]);
 
@@ -341,14 +667,121 @@ void options_parse(int                         argc,
 
             if (each.tolerance)
                 eo[i].tolerance = each.tolerance;
+
+            if (each.cpuQuota)
+                eo[i].cpuQuota = each.cpuQuota;
+
+            if (each.fastPath)
+                eo[i].fastPath = each.fastPath;
+
+            if (each.maxInstances)
+                eo[i].maxInstances = each.maxInstances;
         }
     }
 
+    // With a core budget, games are bounded by cores rather than by concurrency
+    if (o.cores < 0)
+        DIE("invalid cores %d\n", o.cores);
+
+    if (o.cores && !concurrencySet)
+        o.concurrency = o.cores;
+
+    // Adaptive concurrency creates workers up to its maximum, and parks the extra ones
+    if (o.ap.enabled) {
+        if (!o.ap.max)
+            o.ap.max = std::max(o.concurrency, o.ap.min);
+        o.concurrency = o.ap.max;
+    }
+
+    // A server gets its tournaments from its spool directory, and plays them with the
+    // engines of each tournament
+    if (!o.sv.dir.empty()) {
+        if (o.concurrency < 1)
+            DIE("-server needs a concurrency of at least 1\n");
+        if (o.cores || o.calibrate || !o.connect.empty())
+            DIE("-server cannot be combined with -cores, -calibrate or -connect\n");
+        return;
+    }
+
+    // Workers get the tournament from the coordinator
+    if (!o.connect.empty()) {
+        if (o.concurrency < 1)
+            DIE("-connect needs a concurrency of at least 1\n");
+        return;
+    }
+
+    if (o.weight <= 0)
+        DIE("Invalid -weight %g\n", o.weight);
+
+    // Simulated SPRT runs play no game, and use all cores unless told otherwise
+    if (o.sim.enabled) {
+        if (!o.sprt)
+            DIE("-simulate needs -sprt\n");
+
+        if (!concurrencySet)
+            o.concurrency = std::max(1, (int)std::thread::hardware_concurrency());
+
+        options_print(o, eo);
+        return;
+    }
+
     if (eo.size() < 2)
         DIE("at least 2 engines are needed\n");
 
-    if (eo.size() > 2 && o.sprt)
-        DIE("only 2 engines for SPRT\n");
+    if (o.concurrency < (o.coordinator ? 0 : 1))
+        DIE("invalid concurrency %d\n", o.concurrency);
+
+    // Cluster nodes can only stop the whole tournament, not retire a pair
+    if (eo.size() > 2 && o.sprt && !o.cl.dir.empty())
+        DIE("only 2 engines for SPRT with -cluster\n");
+
+    // Game pairs play the same opening with colors swapped, and are never split
+    if (o.sprt && o.sprtParam.pentanomial
+        && (!o.repeat || o.games % 2 || o.shardCount > 1))
+        DIE("pentanomial SPRT needs -repeat, an even number of -games, and no -shard\n");
+
+    // Batches of games keep colors balanced, and game pairs together. Pairs are only
+    // known to the process that dispenses jobs, and decided by the ratings, not by SPRT.
+    if (o.pp.mode == PAIRING_INFO
+        && (o.games % 2 || o.sprt || o.shardCount > 1 || !o.cl.dir.empty()))
+        DIE("-pairing info needs an even number of -games, and no -sprt, -shard or "
+            "-cluster\n");
+
+    // Players of a Swiss or knockout match depend on earlier results
+    if ((o.pp.mode == PAIRING_SWISS || o.pp.mode == PAIRING_KNOCKOUT)
+        && (o.gauntlet || o.sprt || o.shardCount > 1 || !o.cl.dir.empty()))
+        DIE("-pairing %s cannot be combined with -gauntlet, -sprt, -shard or -cluster\n",
+            pairing_name(o.pp));
+
+    // Game pairs are the iterations of SPSA, played by the plus and minus variants of
+    // one engine, with the parameters of the process that dispenses jobs
+    if (o.spsa.enabled
+        && (eo.size() != 2 || !o.repeat || o.games % 2 || o.gauntlet || o.sprt
+            || o.pp.mode != PAIRING_FIXED || o.shardCount > 1 || o.coordinator
+            || !o.cl.dir.empty()))
+        DIE("-spsa needs 2 engines, -repeat and an even number of -games, and no "
+            "-gauntlet, -sprt, -pairing, -shard, -coordinator or -cluster\n");
+
+    if (o.resume && o.journal.empty())
+        DIE("-resume needs a -journal file\n");
+
+    // Shards and cluster nodes must agree on the opening of each game
+    if ((o.shardCount > 1 || !o.cl.dir.empty()) && o.random && !o.srand)
+        DIE("-shard and -cluster need a fixed srand with random openings\n");
+
+    if (!o.cl.dir.empty() && (o.shardCount > 1 || o.coordinator || !o.journal.empty()))
+        DIE("-cluster cannot be combined with -shard, -coordinator or -journal\n");
+
+    // Opening statistics are kept by the process that records games. Pruning decides
+    // the opening of each game pair as results come in, so that shards could not agree.
+    if ((!o.op.report.empty() || o.op.prune) && (o.openings.empty() || !o.cl.dir.empty()))
+        DIE("-openings report= and prune= need an opening file, and no -cluster\n");
+
+    if (o.op.prune < 0 || o.op.split <= 0 || o.op.split > 1)
+        DIE("Invalid -openings prune=%d split=%g\n", o.op.prune, o.op.split);
+
+    if (o.op.prune && (!o.repeat || o.games % 2 || o.shardCount > 1))
+        DIE("-openings prune= needs -repeat, an even number of -games, and no -shard\n");
 
     options_print(o, eo);
 }
@@ -375,13 +808,21 @@ void options_print(const Options &o, const std::vector<EngineOptions> &eo)
     std::cout << "---------------------------" << std::endl;
     std::cout << "Global Options:" << std::endl;
     std::cout << "openings = " << o.openings << std::endl;
-    if (!o.openings.empty())
+    if (!o.openings.empty()) {
         std::cout << "openingType = " << openingTypeName(o.openingType) << std::endl;
+        std::cout << "openingReport = " << o.op.report << std::endl;
+        if (o.op.prune)
+            std::cout << "openingPrune = " << o.op.prune << " split " << o.op.split
+                      << std::endl;
+    }
     std::cout << "boardSize = " << o.boardSize << std::endl;
     std::cout << "gameRule = " << o.gameRule << std::endl;
     std::cout << "pgn = " << o.pgn << std::endl;
     std::cout << "sgf = " << o.sgf << std::endl;
     std::cout << "msg = " << o.msg << std::endl;
+    std::cout << "journal = " << o.journal << std::endl;
+    if (!o.journal.empty())
+        std::cout << "resume = " << o.resume << std::endl;
     std::cout << "log = " << o.log << std::endl;
     std::cout << "sample = " << o.sp.fileName << std::endl;
     if (!o.sp.fileName.empty()) {
@@ -393,10 +834,59 @@ void options_print(const Options &o, const std::vector<EngineOptions> &eo)
     std::cout << "repeat = " << o.repeat << std::endl;
     std::cout << "transform = " << o.transform << std::endl;
     std::cout << "sprt = " << o.sprt << std::endl;
+    std::cout << "calibrate = " << o.calibrate << std::endl;
+    if (o.calibrate)
+        std::cout << "calibrate.ref = " << o.cp.refSpeed << std::endl;
     std::cout << "gauntlet = " << o.gauntlet << std::endl;
     if (o.gauntlet)
         std::cout << "loseonly = " << o.saveLoseOnly << std::endl;
+    std::cout << "pairing = " << pairing_name(o.pp) << std::endl;
+    if (o.pp.mode == PAIRING_INFO)
+        std::cout << "pairing.target = " << o.pp.target << std::endl;
+    if (o.pp.mode == PAIRING_KNOCKOUT)
+        std::cout << "pairing.double = " << o.pp.doubleElim << std::endl;
+    std::cout << "simulate = " << o.sim.enabled << std::endl;
+    if (o.sim.enabled) {
+        std::cout << "simulate.elo = " << o.sim.elo << std::endl;
+        std::cout << "simulate.draws = " << o.sim.draws << std::endl;
+        std::cout << "simulate.bias = " << o.sim.bias << std::endl;
+        std::cout << "simulate.runs = " << o.sim.runs << std::endl;
+    }
+    std::cout << "spsa = " << o.spsa.enabled << std::endl;
+    if (o.spsa.enabled) {
+        std::cout << "spsa.file = " << o.spsa.file << std::endl;
+        for (const SPSAParam &p : o.spsa.params)
+            std::cout << "spsa.param = " << p.name << " " << p.start << " [" << p.min
+                      << ", " << p.max << "] c=" << p.c << std::endl;
+        std::cout << "spsa.r = " << o.spsa.r << std::endl;
+        std::cout << "spsa.A = " << o.spsa.A << std::endl;
+        std::cout << "spsa.alpha = " << o.spsa.alpha << std::endl;
+        std::cout << "spsa.gamma = " << o.spsa.gamma << std::endl;
+    }
     std::cout << "concurrency = " << o.concurrency << std::endl;
+    std::cout << "shard = " << o.shardIndex + 1 << "/" << o.shardCount << std::endl;
+    if (!o.cl.dir.empty()) {
+        std::cout << "cluster.dir = " << o.cl.dir << std::endl;
+        std::cout << "cluster.batch = " << o.cl.batch << std::endl;
+        std::cout << "cluster.lease = " << o.cl.lease << std::endl;
+    }
+    std::cout << "coordinator = " << o.coordinator << std::endl;
+    if (o.coordinator) {
+        std::cout << "coordinator.bind = " << o.rp.bind << std::endl;
+        std::cout << "coordinator.port = " << o.rp.port << std::endl;
+        std::cout << "coordinator.workers = " << o.rp.maxWorkers << std::endl;
+    }
+    std::cout << "startLimit = " << o.startLimit << std::endl;
+    std::cout << "drain = " << o.drain << std::endl;
+    std::cout << "weight = " << o.weight << std::endl;
+    std::cout << "cores = " << o.cores << std::endl;
+    std::cout << "adaptive = " << o.ap.enabled << std::endl;
+    if (o.ap.enabled) {
+        std::cout << "adaptive.min = " << o.ap.min << std::endl;
+        std::cout << "adaptive.max = " << o.ap.max << std::endl;
+        std::cout << "adaptive.interval = " << o.ap.interval << std::endl;
+    }
+    std::cout << "prewarm = " << o.prewarm << std::endl;
     std::cout << "games = " << o.games << std::endl;
     std::cout << "rounds = " << o.rounds << std::endl;
     std::cout << "resignCount = " << o.resignCount << std::endl;
@@ -416,6 +906,8 @@ void options_print(const Options &o, const std::vector<EngineOptions> &eo)
         std::cout << "Engine " << ei << " Options:" << std::endl;
         std::cout << "name = " << e1.name << std::endl;
         std::cout << "cmd = " << e1.cmd << std::endl;
+        if (!e1.host.empty())
+            std::cout << "host = " << e1.host << std::endl;
         std::cout << "nodes = " << e1.nodes << std::endl;
         std::cout << "depth = " << e1.depth << std::endl;
         std::cout << "timeoutTurn = " << e1.timeoutTurn << std::endl;
@@ -424,9 +916,25 @@ void options_print(const Options &o, const std::vector<EngineOptions> &eo)
         std::cout << "maxMemory = " << e1.maxMemory << std::endl;
         std::cout << "thread = " << e1.numThreads << std::endl;
         std::cout << "tolerance = " << e1.tolerance << std::endl;
+        if (e1.cpuQuota > 0)
+            std::cout << "cpuQuota = " << e1.cpuQuota << std::endl;
+        if (e1.fastPath)
+            std::cout << "fastPath = " << e1.fastPath << std::endl;
+        if (e1.maxInstances)
+            std::cout << "instances = " << e1.maxInstances << std::endl;
         for (size_t i = 0; i < e1.options.size(); i++) {
             std::cout << "option." << e1.options[i] << std::endl;
         }
     }
     std::cout << "---------------------------" << std::endl;
 }
+
+const char *pairing_name(const PairingParams &pp)
+{
+    switch (pp.mode) {
+    case PAIRING_INFO: return "info";
+    case PAIRING_SWISS: return "swiss";
+    case PAIRING_KNOCKOUT: return "knockout";
+    default: return "fixed";
+    }
+}
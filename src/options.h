@@ -32,35 +32,140 @@ struct SampleParams
     bool         compress = false;
 };
 
+struct CalibrateParams
+{
+    double refSpeed = 1000.0;  // reference machine speed (knps), see calibrate_speed()
+    double speed    = 0.0;     // measured speed of this machine (knps)
+    double factor   = 1.0;     // time control scale factor (refSpeed / speed)
+};
+
+struct RemoteParams
+{
+    std::string bind = "0.0.0.0", port;  // coordinator address
+    int         maxWorkers = 64;         // maximum number of connected workers
+};
+
+struct ClusterParams
+{
+    std::string dir;         // shared directory, empty if not in a cluster
+    int         batch = 16;  // games claimed at once
+    int         lease = 60;  // seconds before the claim of a silent node is taken over
+};
+
+struct AdaptiveParams
+{
+    bool enabled  = false;
+    int  min      = 1;  // active workers, within [min, max]
+    int  max      = 0;  // 0 for concurrency
+    int  interval = 5;  // seconds between decisions
+};
+
+struct SimulateParams
+{
+    bool     enabled = false;
+    double   elo     = 0;      // true Elo difference
+    double   draws   = 0;      // draw ratio
+    double   bias    = 0;      // Elo of moving first
+    int      runs    = 10000;  // simulated runs of the test
+    uint64_t seed    = 0;      // 0 for a random seed
+};
+
+struct SPSAParam
+{
+    std::string name;             // engine option, sent as INFO name value
+    double      start, min, max;  // integers, unless any of them has decimals
+    double      c;                // perturbation at the last iteration
+    bool        integer;
+};
+
+struct SPSAParams
+{
+    bool                   enabled = false;
+    std::string            file;           // checkpoint
+    std::vector<SPSAParam> params;
+    double                 r     = 0.002;  // step at the last iteration, relative to c
+    double                 A     = 0;      // stability constant, 0 for 10% of iterations
+    double                 alpha = 0.602;  // decay of the step
+    double                 gamma = 0.101;  // decay of the perturbation
+};
+
+struct ServerParams
+{
+    std::string dir;          // spool directory, empty if not a server
+    int         port = 5200;  // of the first tournament, the next ones count up
+};
+
+struct OpeningParams
+{
+    std::string report;       // per opening statistics, empty for none
+    int         prune = 0;    // game pairs before an opening can be dropped, 0 for never
+    double      split = 0.8;  // share of pairs split by color that drops an opening
+};
+
+enum PairingMode { PAIRING_FIXED, PAIRING_INFO, PAIRING_SWISS, PAIRING_KNOCKOUT };
+
+struct PairingParams
+{
+    PairingMode mode       = PAIRING_FIXED;
+    double      target     = 0;      // info: Elo error to stop at, 0 for none
+    bool        doubleElim = false;  // knockout: double elimination
+};
+
 struct Options
 {
-    std::string  openings, pgn, sgf, msg;
-    SampleParams sp;
-    SPRTParam    sprtParam   = {.elo0 = 0, .elo1 = 0, .alpha = 0.05, .beta = 0.05};
-    uint64_t     srand       = 0;
-    int          concurrency = 1;
-    int          games = 1, rounds = 1;
-    int          resignCount = 0, resignScore = 0;
-    int          drawCount = 0, drawScore = 0;
-    int          forceDrawAfter = 0;
-    int          boardSize      = 15;
-    GameRule     gameRule       = GOMOKU_FIVE_OR_MORE;
-    OpeningType  openingType    = OPENING_OFFSET;
-    bool         useTURN        = true;
-    bool         log            = false;
-    bool         random         = false;
-    bool         repeat         = false;
-    bool         transform      = false;
-    bool         sprt           = false;
-    bool         gauntlet       = false;
-    bool         saveLoseOnly   = false;
-    bool         fatalError     = false;
-    bool         debug          = false;
+    std::string     openings, pgn, sgf, msg;
+    std::string     journal;
+    std::string     connect;  // coordinator address, in worker mode
+    SampleParams    sp;
+    CalibrateParams cp;
+    RemoteParams    rp;
+    ClusterParams   cl;
+    AdaptiveParams  ap;
+    PairingParams   pp;
+    SimulateParams  sim;
+    SPSAParams      spsa;
+    ServerParams    sv;
+    OpeningParams   op;
+    SPRTParam       sprtParam   = {.elo0        = 0,
+                                   .elo1        = 0,
+                                   .alpha       = 0.05,
+                                   .beta        = 0.05,
+                                   .pentanomial = false};
+    uint64_t        srand       = 0;
+    int             concurrency = 1;
+    int             startLimit  = 0;
+    int             drain       = 60;  // seconds games in progress get, once signaled
+    double          weight      = 1;   // share of the workers of a -server
+    int             cores       = 0;  // core budget of local games, 0 for none
+    int             shardIndex = 0, shardCount = 1;  // -shard K/N: index = K - 1
+    int             games = 1, rounds = 1;
+    int             resignCount = 0, resignScore = 0;
+    int             drawCount = 0, drawScore = 0;
+    int             forceDrawAfter = 0;
+    int             boardSize      = 15;
+    GameRule        gameRule       = GOMOKU_FIVE_OR_MORE;
+    OpeningType     openingType    = OPENING_OFFSET;
+    bool            useTURN        = true;
+    bool            log            = false;
+    bool            random         = false;
+    bool            repeat         = false;
+    bool            transform      = false;
+    bool            sprt           = false;
+    bool            calibrate      = false;
+    bool            prewarm        = false;
+    bool            resume         = false;
+    bool            coordinator    = false;
+    bool            gauntlet       = false;
+    bool            saveLoseOnly   = false;
+    bool            fatalError     = false;
+    bool            debug          = false;
 };
 
 struct EngineOptions
 {
     std::string              cmd, name;
+    std::string              host;   // engine-host address, empty for a local engine
+    std::string              token;  // shared secret of engine-host, empty for none
     std::vector<std::string> options;
 
     // default time control info
@@ -76,10 +181,20 @@ struct EngineOptions
 
     // default tolerance is 3
     int64_t tolerance = 3000;
+
+    // cpu quota in cores (0 as unlimited)
+    double cpuQuota = 0;
+
+    // max games played at once by this engine (0 as unlimited)
+    int maxInstances = 0;
+
+    // offer the shared memory fast path to the engine
+    bool fastPath = false;
 };
 
 void options_parse(int                         argc,
                    const char                **argv,
                    Options                    &o,
                    std::vector<EngineOptions> &eo);
-void options_print(const Options &o, const std::vector<EngineOptions> &eo);
\ No newline at end of file
+void options_print(const Options &o, const std::vector<EngineOptions> &eo);
+const char *pairing_name(const PairingParams &pp);
\ No newline at end of file
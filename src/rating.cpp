@@ -0,0 +1,326 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rating.h"
+
+#include "game.h"
+#include "jobs.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Ratings are estimated in natural units, where engines whose ratings differ by x score
+// 1 / (1 + exp(-x)) against each other, when draws are not modelled
+static const double EloPerUnit = 400 / log(10);
+
+// Gaussian prior on each rating and on the advantage of moving first, so that an engine
+// that never lost (or never won) still gets a finite estimate. Its standard deviation is
+// 1000 Elo, which the results of a few games outweigh.
+static const double PriorPrecision = 1 / ((1000 / EloPerUnit) * (1000 / EloPerUnit));
+
+// Smallest draw Elo when draws are modelled, which keeps their probability positive
+static const double MinDrawElo = 1 / EloPerUnit;
+
+static double logistic(double x)
+{
+    return 1 / (1 + exp(-x));
+}
+
+static double score_to_elo(double score)
+{
+    score = std::clamp(score, 1e-3, 1 - 1e-3);
+    return -EloPerUnit * log(1 / score - 1);
+}
+
+// Probability that a standard normal variable is below x
+static double normal_cdf(double x)
+{
+    return 0.5 * (1 + erf(x / sqrt(2)));
+}
+
+// Invert the n x n symmetric positive definite matrix 'm' in place, by Gauss-Jordan
+// elimination
+static void invert(std::vector<double> &m, int n)
+{
+    std::vector<double> inv(n * n, 0);
+
+    for (int i = 0; i < n; i++)
+        inv[i * n + i] = 1;
+
+    for (int k = 0; k < n; k++) {
+        const double pivot = m[k * n + k];
+
+        for (int j = 0; j < n; j++) {
+            m[k * n + j] /= pivot;
+            inv[k * n + j] /= pivot;
+        }
+
+        for (int i = 0; i < n; i++) {
+            const double f = m[i * n + k];
+
+            if (i == k || f == 0)
+                continue;
+
+            for (int j = 0; j < n; j++) {
+                m[i * n + j] -= f * m[k * n + j];
+                inv[i * n + j] -= f * inv[k * n + j];
+            }
+        }
+    }
+
+    m.swap(inv);
+}
+
+double Ratings::error(int ei) const
+{
+    return 1.96 * sqrt(cov[ei * size() + ei]);
+}
+
+double Ratings::diff_error(int e1, int e2) const
+{
+    const int n = size();
+    return 1.96 * sqrt(cov[e1 * n + e1] - 2 * cov[e1 * n + e2] + cov[e2 * n + e2]);
+}
+
+double Ratings::los(int e1, int e2) const
+{
+    const double sigma = diff_error(e1, e2) / 1.96;
+    return sigma > 0 ? normal_cdf((elo[e1] - elo[e2]) / sigma) : 0.5;
+}
+
+// Games of a pair with one of its engines moving first, from its point of view
+struct Cell
+{
+    int    first, second;
+    double win, draw, loss;
+    double pending;
+};
+
+Ratings rating_estimate(int                        engines,
+                        const std::vector<Result> &results,
+                        const std::vector<int>    &pending,
+                        const Ratings             *start)
+{
+    // Each pair splits into the games that either engine played first. Games in flight
+    // are assumed to alternate colors.
+    std::vector<Cell> cells;
+    bool              draws = false;
+
+    for (size_t k = 0; k < results.size(); k++) {
+        const Result &r = results[k];
+        const double  p = pending.empty() ? 0 : pending[k] / 2.0;
+
+        cells.push_back({.first   = r.ei[0],
+                         .second  = r.ei[1],
+                         .win     = (double)r.first[RESULT_WIN],
+                         .draw    = (double)r.first[RESULT_DRAW],
+                         .loss    = (double)r.first[RESULT_LOSS],
+                         .pending = p});
+        cells.push_back({.first   = r.ei[1],
+                         .second  = r.ei[0],
+                         .win     = (double)r.count[RESULT_LOSS] - r.first[RESULT_LOSS],
+                         .draw    = (double)r.count[RESULT_DRAW] - r.first[RESULT_DRAW],
+                         .loss    = (double)r.count[RESULT_WIN] - r.first[RESULT_WIN],
+                         .pending = p});
+        draws |= r.count[RESULT_DRAW] > 0;
+    }
+
+    // Parameters: ratings, advantage of moving first, and draw Elo if there are draws
+    const int           n = engines, A = n, D = n + 1, m = n + 1 + draws;
+    std::vector<double> x(m, 0), grad(m), info(m * m);
+
+    if (start && start->size() == n) {
+        for (int i = 0; i < n; i++)
+            x[i] = start->elo[i] / EloPerUnit;
+        x[A] = start->advantage / EloPerUnit;
+    }
+
+    if (draws)
+        x[D] = start && start->drawElo > 0 ? start->drawElo / EloPerUnit : 0.5;
+
+    // Fisher scoring: Newton iterations on the log posterior, with the expected
+    // information in place of its Hessian. Pending games only add to the information, so
+    // that the fixed point is the estimate from finished games alone.
+    for (int iter = 0; iter < 100; iter++) {
+        std::fill(grad.begin(), grad.end(), 0);
+        std::fill(info.begin(), info.end(), 0);
+
+        for (int i = 0; i <= A; i++) {
+            grad[i]         = -PriorPrecision * x[i];
+            info[i * m + i] = PriorPrecision;
+        }
+
+        for (const Cell &c : cells) {
+            const double games = c.win + c.draw + c.loss + c.pending;
+            const double d     = x[c.first] - x[c.second] + x[A];
+            const double delta = draws ? x[D] : 0;
+
+            if (games == 0)
+                continue;
+
+            // Probabilities of a win, a loss and a draw, and their derivatives with
+            // respect to d and delta
+            const double pw        = logistic(d - delta);
+            const double pl        = logistic(-d - delta);
+            const double pd        = std::max(1 - pw - pl, 1e-12);
+            const double gw        = pw * (1 - pw);
+            const double gl        = pl * (1 - pl);
+            const double p[3]      = {pw, pl, pd};
+            const double dd[3]     = {gw, -gl, gl - gw};
+            const double ddelta[3] = {-gw, -gl, gw + gl};
+            const double count[3]  = {c.win, c.loss, c.draw};
+
+            double gd = 0, gdelta = 0, fdd = 0, fddelta = 0, fdelta = 0;
+
+            for (int o = 0; o < 2 + draws; o++) {
+                gd += count[o] * dd[o] / p[o];
+                gdelta += count[o] * ddelta[o] / p[o];
+                fdd += games * dd[o] * dd[o] / p[o];
+                fddelta += games * dd[o] * ddelta[o] / p[o];
+                fdelta += games * ddelta[o] * ddelta[o] / p[o];
+            }
+
+            // d = x[first] - x[second] + x[A]
+            const int    idx[3]  = {c.first, c.second, A};
+            const double sign[3] = {1, -1, 1};
+
+            for (int i = 0; i < 3; i++) {
+                grad[idx[i]] += sign[i] * gd;
+
+                for (int j = 0; j < 3; j++)
+                    info[idx[i] * m + idx[j]] += sign[i] * sign[j] * fdd;
+
+                if (draws) {
+                    info[idx[i] * m + D] += sign[i] * fddelta;
+                    info[D * m + idx[i]] += sign[i] * fddelta;
+                }
+            }
+
+            if (draws) {
+                grad[D] += gdelta;
+                info[D * m + D] += fdelta;
+            }
+        }
+
+        invert(info, m);
+
+        // Steps are capped, as far from the estimate the information is a poor guide
+        std::vector<double> step(m, 0);
+        double              largest = 0;
+
+        for (int i = 0; i < m; i++) {
+            for (int j = 0; j < m; j++)
+                step[i] += info[i * m + j] * grad[j];
+            largest = std::max(largest, fabs(step[i]));
+        }
+
+        for (int i = 0; i < m; i++)
+            x[i] += step[i] / std::max(largest, 1.0);
+
+        if (draws)
+            x[D] = std::max(x[D], MinDrawElo);
+
+        if (largest < 1e-6)
+            break;
+    }
+
+    // Ratings and covariance are relative to the average engine, which the results say
+    // nothing about
+    Ratings r;
+    double  mean = 0;
+
+    for (int i = 0; i < n; i++)
+        mean += x[i] / n;
+
+    r.elo.resize(n);
+    r.cov.assign(n * n, 0);
+
+    for (int i = 0; i < n; i++)
+        r.elo[i] = (x[i] - mean) * EloPerUnit;
+
+    r.advantage      = x[A] * EloPerUnit;
+    r.advantageError = 1.96 * sqrt(info[A * m + A]) * EloPerUnit;
+    r.drawElo        = draws ? x[D] * EloPerUnit : 0;
+
+    // Centered covariance: C' = P C P, where P subtracts the mean
+    std::vector<double> rowMean(n, 0);
+    double              allMean = 0;
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++)
+            rowMean[i] += info[i * m + j] / n;
+        allMean += rowMean[i] / n;
+    }
+
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++)
+            r.cov[i * n + j] = (info[i * m + j] - rowMean[i] - rowMean[j] + allMean)
+                             * EloPerUnit * EloPerUnit;
+
+    return r;
+}
+
+// With covariance C, more games between e1 and e2 add w d d' to the information, where
+// d = e1 - e2 and w is their Fisher information. By the Sherman-Morrison formula, the
+// trace of C decreases by w |C d|^2 / (1 + w d' C d).
+double rating_gain(const Ratings &r, int e1, int e2, int games)
+{
+    const int    n = r.size();
+    const double p = 1 / (1 + exp((r.elo[e2] - r.elo[e1]) / EloPerUnit));
+    const double w = games * p * (1 - p) / (EloPerUnit * EloPerUnit);
+    double       norm2 = 0;
+
+    for (int i = 0; i < n; i++) {
+        const double u = r.cov[i * n + e1] - r.cov[i * n + e2];
+        norm2 += u * u;
+    }
+
+    const double quad =
+        r.cov[e1 * n + e1] - 2 * r.cov[e1 * n + e2] + r.cov[e2 * n + e2];
+
+    return w * norm2 / (1 + w * quad);
+}
+
+PairElo pair_elo(const Result &r)
+{
+    const int wins = r.count[RESULT_WIN], losses = r.count[RESULT_LOSS];
+    double    score = 0, var = 0;
+
+    // Mean score, and variance of the mean, over game pairs if any, else over games
+    if (r.pairs()) {
+        for (int i = 0; i < 5; i++)
+            score += i / 4.0 * r.penta[i] / r.pairs();
+        for (int i = 0; i < 5; i++)
+            var += (i / 4.0 - score) * (i / 4.0 - score) * r.penta[i] / r.pairs();
+        var /= r.pairs();
+    }
+    else if (r.total()) {
+        for (int i = 0; i < 3; i++)
+            score += i / 2.0 * r.count[i] / r.total();
+        for (int i = 0; i < 3; i++)
+            var += (i / 2.0 - score) * (i / 2.0 - score) * r.count[i] / r.total();
+        var /= r.total();
+    }
+    else
+        return {.elo = 0, .error = 0, .los = 0.5};
+
+    const double margin = 1.96 * sqrt(var);
+
+    return {.elo   = score_to_elo(score),
+            .error = (score_to_elo(score + margin) - score_to_elo(score - margin)) / 2,
+            .los   = wins + losses ? normal_cdf((wins - losses) / sqrt(wins + losses))
+                                   : 0.5};
+}
@@ -0,0 +1,61 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+
+struct Result;
+
+// Joint rating estimate of all engines, in Elo, from the results of their pairs
+struct Ratings
+{
+    std::vector<double> elo;  // [engine], relative to the average engine
+    std::vector<double> cov;  // [engine * engines + engine]: covariance, in Elo^2
+    double              advantage      = 0;  // Elo of moving first
+    double              advantageError = 0;  // half width of its 95% confidence interval
+    double              drawElo        = 0;  // how likely draws are, 0 if there are none
+
+    int    size() const { return (int)elo.size(); }
+    double error(int ei) const;  // half width of the 95% confidence interval
+    double diff_error(int e1, int e2) const;
+    double los(int e1, int e2) const;  // likelihood that e1 is stronger than e2
+};
+
+// Maximum a posteriori estimate in the model of BayesElo: the first player wins with
+// probability f(d - drawElo) and loses with probability f(-d - drawElo), where d is the
+// rating difference plus the advantage of moving first, and f(x) = 1 / (1 + 10^(-x/400)).
+// 'pending' (per pair, may be empty) counts games in flight: they add the information
+// expected from them at the current estimate, but no result. 'start' (may be null) is an
+// earlier estimate to start from, so that updates take few iterations.
+Ratings rating_estimate(int                        engines,
+                        const std::vector<Result> &results,
+                        const std::vector<int>    &pending,
+                        const Ratings             *start = nullptr);
+
+// Expected decrease of the sum of rating variances, from 'games' more games between
+// engines 'e1' and 'e2'
+double rating_gain(const Ratings &r, int e1, int e2, int games);
+
+// Elo difference of a single pair from its score, the half width of its 95% confidence
+// interval (from game pairs, if any), and the likelihood of superiority of its first
+// engine, from wins and losses
+struct PairElo
+{
+    double elo, error, los;
+};
+
+PairElo pair_elo(const Result &r);
@@ -0,0 +1,625 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "remote.h"
+
+#include "util.h"
+
+#ifndef __MINGW32__
+    #include <fcntl.h>
+    #include <netdb.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <sys/socket.h>
+    #include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+
+#ifndef __MINGW32__
+// Wire protocol between workers and the coordinator is line based, with binary payloads
+// following the line that announces their length. Messages sent by a worker:
+//   HELLO <version> <threads>  answered by ARGS <n>, and the n arguments of the
+//                              coordinator command line, one per line
+//   GET <n>                    ask for up to n jobs, answered by JOBS <m> and m job
+//                              records (none for now if m = 0: ask again later), or by
+//                              DONE once the tournament is over
+//   RESULT <idx> <outcome> <msec> <moves> <black> <len>*7
+//                              finished game, its duration, number of moves and the
+//                              engine that played black, followed by 7 payloads:
+//                              the names of both engines, summary, PGN, SGF, messages,
+//                              and samples
+//   ALIVE                      keepalive, sent when the connection is otherwise idle
+// Job record, followed by the opening string as payload:
+//   JOB <idx> <count> <e0> <e1> <pair> <round> <game> <reverse> <openingRound> <len>
+// An answer to GET implies that all results sent before it have been received.
+
+static const int     ProtocolVersion   = 3;
+static const int64_t KeepaliveInterval = 2000;    // msec between worker keepalives
+static const int64_t SilenceTimeout    = 10000;   // msec of silence from a lost peer
+static const int64_t ReconnectDelay    = 2000;    // msec between connection attempts
+
+static void socket_setup(int threadId, int sock)
+{
+    const int            one = 1;
+    const struct timeval tv  = {.tv_sec  = (time_t)(SilenceTimeout / 1000),
+                                .tv_usec = (suseconds_t)(SilenceTimeout % 1000 * 1000)};
+
+    DIE_IF(threadId, fcntl(sock, F_SETFD, FD_CLOEXEC) < 0);
+    DIE_IF(threadId, setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0);
+    DIE_IF(threadId, setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) < 0);
+    DIE_IF(threadId, setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) < 0);
+}
+
+static void socket_open_files(int threadId, int sock, FILE *&in, FILE *&out)
+{
+    int sockOut;
+    DIE_IF(threadId, (sockOut = fcntl(sock, F_DUPFD_CLOEXEC, 0)) < 0);
+    DIE_IF(threadId, !(in = fdopen(sock, "r")));
+    DIE_IF(threadId, !(out = fdopen(sockOut, "w")));
+}
+
+static bool read_payload(FILE *in, std::string &s, size_t len)
+{
+    s.resize(len);
+    return !len || fread(s.data(), 1, len, in) == len;
+}
+
+static bool write_message(FILE *out, const std::string &msg)
+{
+    return fwrite(msg.data(), 1, msg.size(), out) == msg.size() && fflush(out) == 0;
+}
+
+Coordinator::Coordinator(const std::string              &bind,
+                         const std::string              &port,
+                         const std::vector<std::string> &a,
+                         JobQueue                       *q,
+                         int                             firstShard,
+                         int                             maxWorkers,
+                         PrepareFn                       p,
+                         FinishFn                        f)
+    : args(a)
+    , jq(q)
+    , prepare(std::move(p))
+    , finish(std::move(f))
+    , stopping(false)
+    , listener(-1)
+{
+    // Hand out low shards first
+    for (int i = maxWorkers - 1; i >= 0; i--)
+        freeShards.push_back(firstShard + i);
+
+    struct addrinfo hints = {}, *res = nullptr;
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags    = AI_PASSIVE;
+
+    if (int err = getaddrinfo(bind.c_str(), port.c_str(), &hints, &res))
+        DIE("cannot resolve '%s': %s\n", bind.c_str(), gai_strerror(err));
+
+    const int one = 1;
+    DIE_IF(0,
+           (listener = socket(res->ai_family, res->ai_socktype, res->ai_protocol)) < 0);
+    DIE_IF(0, fcntl(listener, F_SETFD, FD_CLOEXEC) < 0);
+    DIE_IF(0, setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0);
+    DIE_IF(0, ::bind(listener, res->ai_addr, res->ai_addrlen) < 0);
+    DIE_IF(0, listen(listener, 64) < 0);
+    freeaddrinfo(res);
+
+    printf("Coordinator listening on %s:%s\n", bind.c_str(), port.c_str());
+    acceptThread = std::thread(&Coordinator::accept_loop, this);
+}
+
+Coordinator::~Coordinator()
+{
+    // Give idle workers a chance to learn that the tournament is over, before they are
+    // cut off and start trying to reconnect
+    for (const int64_t start = system_msec(); system_msec() - start < SilenceTimeout;
+         system_sleep(100)) {
+        std::lock_guard lock(mtx);
+        if (std::count(socks.begin(), socks.end(), -1) == (long)socks.size())
+            break;
+    }
+
+    // Wake up accept() and all connections, which close themselves
+    stopping = true;
+    shutdown(listener, SHUT_RDWR);
+    acceptThread.join();
+    close(listener);
+
+    {
+        std::lock_guard lock(mtx);
+        for (int sock : socks)
+            if (sock >= 0)
+                shutdown(sock, SHUT_RDWR);
+    }
+
+    for (std::thread &th : threads)
+        th.join();
+}
+
+void Coordinator::accept_loop()
+{
+    for (;;) {
+        int sock;
+
+        if ((sock = accept(listener, nullptr, nullptr)) < 0) {
+            if (stopping)
+                return;
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            DIE_IF(0, true);
+        }
+
+        socket_setup(0, sock);
+
+        // Connections are numbered from 1 by their slot in socks[]
+        std::lock_guard lock(mtx);
+        const int       id = (int)socks.size() + 1;
+        socks.push_back(sock);
+        threads.emplace_back(&Coordinator::serve, this, id, sock);
+    }
+}
+
+void Coordinator::serve(int id, int sock)
+{
+    FILE       *in, *out;
+    std::string line;
+    int         version = 0, workerThreads = 0, shard = -1;
+
+    socket_open_files(0, sock, in, out);
+
+    // Handshake: a shard for the worker, and the tournament it plays
+    if (string_getline(line, in)
+        && sscanf(line.c_str(), "HELLO %d %d", &version, &workerThreads) == 2
+        && version == ProtocolVersion) {
+        std::lock_guard lock(mtx);
+
+        if (!freeShards.empty()) {
+            shard = freeShards.back();
+            freeShards.pop_back();
+        }
+    }
+
+    if (shard >= 0) {
+        std::string msg = format("ARGS %zu\n", args.size());
+        for (const std::string &arg : args)
+            msg += arg + "\n";
+
+        if (write_message(out, msg)) {
+            printf("[coordinator] worker %d connected (%d threads)\n", id, workerThreads);
+
+            while (!stopping && string_getline(line, in)
+                   && serve_request(id, shard, line, in, out))
+                ;
+        }
+    }
+
+    // Connection lost: jobs claimed by the worker go back to the queue
+    size_t requeued = 0;
+
+    {
+        std::lock_guard lock(mtx);
+
+        for (auto it = claims.begin(); it != claims.end();)
+            if (it->second.connection == id) {
+                jq->requeue(it->first);
+                it = claims.erase(it);
+                requeued++;
+            }
+            else
+                ++it;
+
+        if (shard >= 0)
+            freeShards.push_back(shard);
+        socks[id - 1] = -1;
+    }
+
+    if (shard >= 0)
+        printf("[coordinator] worker %d disconnected, %zu jobs requeued\n", id, requeued);
+
+    fclose(in);
+    fclose(out);
+}
+
+bool Coordinator::serve_request(int                id,
+                                int                shard,
+                                const std::string &line,
+                                FILE              *in,
+                                FILE              *out)
+{
+    size_t  idx, len[7];
+    int     n, outcome, moves, black;
+    int64_t duration;
+
+    if (line == "ALIVE")
+        return true;
+
+    if (sscanf(line.c_str(), "GET %d", &n) == 1) {
+        std::vector<RemoteJob> batch;
+
+        for (int i = 0; i < n; i++) {
+            RemoteJob rj;
+
+            if (!jq->pop(shard, rj.job, rj.idx, rj.count))
+                break;
+
+            prepare(rj);
+            batch.push_back(rj);
+
+            std::lock_guard lock(mtx);
+            claims[rj.idx] = {.connection = id, .job = rj.job};
+        }
+
+        std::string msg;
+
+        if (batch.empty() && jq->finished())
+            msg = "DONE\n";
+        else {
+            msg = format("JOBS %zu\n", batch.size());
+
+            for (const RemoteJob &rj : batch) {
+                msg += format("JOB %zu %zu %d %d %d %d %d %d %zu %zu\n",
+                              rj.idx,
+                              rj.count,
+                              rj.job.ei[0],
+                              rj.job.ei[1],
+                              rj.job.pair,
+                              rj.job.round,
+                              rj.job.game,
+                              (int)rj.job.reverse,
+                              rj.openingRound,
+                              rj.opening.size());
+                msg += rj.opening;
+            }
+        }
+
+        return write_message(out, msg);
+    }
+
+    if (sscanf(line.c_str(),
+               "RESULT %zu %d %" SCNd64 " %d %d %zu %zu %zu %zu %zu %zu %zu",
+               &idx,
+               &outcome,
+               &duration,
+               &moves,
+               &black,
+               &len[0],
+               &len[1],
+               &len[2],
+               &len[3],
+               &len[4],
+               &len[5],
+               &len[6])
+        == 12) {
+        GameRecord   r;
+        std::string *payloads[7] =
+            {&r.names[0], &r.names[1], &r.summary, &r.pgn, &r.sgf, &r.msg, &r.samples};
+
+        for (int i = 0; i < 7; i++)
+            if (!read_payload(in, *payloads[i], len[i]))
+                return false;
+
+        r.idx      = idx;
+        r.outcome  = outcome;
+        r.duration = duration;
+        r.moves    = moves;
+        r.black    = black;
+        Job job;
+
+        if (outcome >= 0 && outcome < 3 && accept_result(id, idx, job))
+            finish(shard, job, r);
+
+        return true;
+    }
+
+    printf("[coordinator] invalid message from worker %d: '%s'\n", id, line.c_str());
+    return false;
+}
+
+// A job's result is accepted once: from the worker that claims the job, or, if the job
+// was requeued, from the first worker to return it
+bool Coordinator::accept_result(int id, size_t idx, Job &job)
+{
+    std::lock_guard lock(mtx);
+    auto            it = claims.find(idx);
+
+    if (it != claims.end()) {
+        job = it->second.job;
+        claims.erase(it);
+        return true;
+    }
+
+    if (jq->unqueue(idx)) {
+        job = jq->job_at(idx);
+        return true;
+    }
+
+    printf("[coordinator] dropped late result of game %zu from worker %d\n", idx + 1, id);
+    return false;
+}
+
+RemoteQueue::RemoteQueue(const std::string &addr, int n, int64_t t)
+    : address(addr)
+    , threads(n)
+    , timeout(t)
+    , sock(-1)
+    , in(nullptr)
+    , out(nullptr)
+    , waiting(0)
+    , over(false)
+{
+    std::lock_guard lock(mtx);
+
+    if (!connect()) {
+        over = true;
+        return;
+    }
+
+    keepaliveThread = std::thread(&RemoteQueue::keepalive, this);
+}
+
+RemoteQueue::~RemoteQueue()
+{
+    over = true;
+    if (keepaliveThread.joinable())
+        keepaliveThread.join();
+    disconnect();
+}
+
+// Connect to the coordinator, retrying for up to 'timeout', unless stopped. Returns false
+// if it could not be reached.
+bool RemoteQueue::connect()
+{
+    std::string  host = address, port = COORDINATOR_PORT;
+    const size_t colon = address.rfind(':');
+
+    if (colon != std::string::npos) {
+        host = address.substr(0, colon);
+        port = address.substr(colon + 1);
+    }
+
+    bool warned = false;
+
+    for (const int64_t start = system_msec();; system_sleep(ReconnectDelay)) {
+        struct addrinfo hints = {}, *res = nullptr;
+        hints.ai_family   = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) == 0) {
+            for (struct addrinfo *ai = res; ai && sock < 0; ai = ai->ai_next) {
+                if ((sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0)
+                    continue;
+
+                socket_setup(0, sock);
+
+                if (::connect(sock, ai->ai_addr, ai->ai_addrlen) < 0) {
+                    close(sock);
+                    sock = -1;
+                }
+            }
+
+            freeaddrinfo(res);
+        }
+
+        if (sock >= 0) {
+            socket_open_files(0, sock, in, out);
+
+            // Handshake: the coordinator sends its command line
+            std::string line;
+            size_t      n = 0, i = 0;
+
+            if (write_message(out, format("HELLO %d %d\n", ProtocolVersion, threads))
+                && string_getline(line, in)
+                && sscanf(line.c_str(), "ARGS %zu", &n) == 1) {
+                std::vector<std::string> received(n);
+
+                while (i < n && string_getline(received[i], in))
+                    i++;
+
+                if (i == n) {
+                    if (args.empty())
+                        args = received;
+                    break;
+                }
+            }
+
+            disconnect();
+        }
+
+        if (over || system_msec() - start > timeout)
+            return false;
+
+        if (!warned)
+            printf("Cannot reach coordinator %s, retrying\n", address.c_str());
+        warned = true;
+    }
+
+    printf("Connected to coordinator %s\n", address.c_str());
+
+    // Jobs received on the lost connection were requeued by the coordinator, and results
+    // sent on it may have been lost
+    jobs.clear();
+
+    for (const GameRecord &r : unacked)
+        if (!send_result(r))
+            break;
+
+    return true;
+}
+
+void RemoteQueue::disconnect()
+{
+    if (in)
+        fclose(in);
+    if (out)
+        fclose(out);
+
+    in = out = nullptr;
+    sock     = -1;
+}
+
+bool RemoteQueue::send_result(const GameRecord &r)
+{
+    const std::string *payloads[7] =
+        {&r.names[0], &r.names[1], &r.summary, &r.pgn, &r.sgf, &r.msg, &r.samples};
+    std::string msg = format("RESULT %zu %d %" PRId64 " %d %d",
+                             r.idx,
+                             r.outcome,
+                             r.duration,
+                             r.moves,
+                             r.black);
+
+    for (const std::string *p : payloads)
+        msg += format(" %zu", p->size());
+    msg += "\n";
+
+    for (const std::string *p : payloads)
+        msg += *p;
+
+    return write_message(out, msg);
+}
+
+// Ask for up to n jobs. Returns false if the connection is lost.
+bool RemoteQueue::request(int n)
+{
+    std::string line;
+    size_t      m;
+
+    if (!write_message(out, format("GET %d\n", n)) || !string_getline(line, in))
+        return false;
+
+    if (line == "DONE")
+        over = true;
+    else if (sscanf(line.c_str(), "JOBS %zu", &m) == 1) {
+        for (size_t i = 0; i < m; i++) {
+            RemoteJob rj;
+            int       reverse;
+            size_t    len;
+
+            if (!string_getline(line, in)
+                || sscanf(line.c_str(),
+                          "JOB %zu %zu %d %d %d %d %d %d %zu %zu",
+                          &rj.idx,
+                          &rj.count,
+                          &rj.job.ei[0],
+                          &rj.job.ei[1],
+                          &rj.job.pair,
+                          &rj.job.round,
+                          &rj.job.game,
+                          &reverse,
+                          &rj.openingRound,
+                          &len)
+                       != 10
+                || !read_payload(in, rj.opening, len))
+                return false;
+
+            rj.job.reverse = reverse;
+            jobs.push_back(rj);
+        }
+    }
+    else
+        return false;
+
+    // All results sent so far have been received
+    unacked.clear();
+    return true;
+}
+
+bool RemoteQueue::pop(RemoteJob &rj, bool wait)
+{
+    waiting++;
+    std::unique_lock lock(mtx);
+
+    while (jobs.empty() && !over) {
+        if (!in && !connect()) {
+            printf("Lost coordinator %s\n", address.c_str());
+            over = true;
+        }
+        else if (!request(waiting.load()))
+            disconnect();
+        else if (jobs.empty() && !over) {
+            if (!wait)
+                break;
+
+            // Nothing to play for now, but jobs may be requeued
+            lock.unlock();
+            system_sleep(1000);
+            lock.lock();
+        }
+    }
+
+    waiting--;
+
+    if (jobs.empty())
+        return false;
+
+    rj = jobs.front();
+    jobs.erase(jobs.begin());
+    return true;
+}
+
+void RemoteQueue::push(const GameRecord &r)
+{
+    std::lock_guard lock(mtx);
+
+    unacked.push_back(r);
+
+    if (in && !send_result(r))
+        disconnect();
+}
+
+void RemoteQueue::keepalive()
+{
+    for (int64_t last = system_msec(); !over; system_sleep(100))
+        if (system_msec() - last >= KeepaliveInterval) {
+            std::lock_guard lock(mtx);
+
+            if (in && !write_message(out, "ALIVE\n"))
+                disconnect();
+
+            last = system_msec();
+        }
+}
+
+#else
+
+Coordinator::Coordinator(const std::string &,
+                         const std::string &,
+                         const std::vector<std::string> &,
+                         JobQueue *,
+                         int,
+                         int,
+                         PrepareFn,
+                         FinishFn)
+{
+    DIE("-coordinator is not supported on Windows\n");
+}
+
+Coordinator::~Coordinator() {}
+
+RemoteQueue::RemoteQueue(const std::string &, int, int64_t) : threads(0), timeout(0)
+{
+    DIE("-connect is not supported on Windows\n");
+}
+
+RemoteQueue::~RemoteQueue() {}
+bool RemoteQueue::pop(RemoteJob &, bool) { return false; }
+void RemoteQueue::push(const GameRecord &) {}
+
+#endif
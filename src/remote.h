@@ -0,0 +1,148 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "jobs.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Default TCP port of a coordinator
+#define COORDINATOR_PORT "5151"
+
+// Job to play, with its opening
+struct RemoteJob
+{
+    Job         job;
+    size_t      idx, count;  // game index, and number of games in the tournament
+    size_t      openingRound;
+    std::string opening;
+};
+
+// Finished game, as recorded by the process that owns the outputs
+struct GameRecord
+{
+    size_t      idx;
+    int         outcome;   // from ei[0]'s point of view
+    int64_t     duration;  // time spent playing the game, in msec
+    int         moves;     // played by the engines, after the opening
+    int         black;     // engine that played black: 0 for ei[0], 1 for ei[1]
+    std::string names[2];  // names of engines ei[0] and ei[1]
+    std::string summary;   // "(black vs white): result {reason}"
+    std::string pgn, sgf, msg;
+    std::string samples;  // uncompressed
+};
+
+// Coordinator: serves jobs of a JobQueue to worker processes (-connect) over TCP, and
+// hands the games they finish to 'finish'. Each worker connection gets a shard of the
+// queue of its own. Jobs claimed by a worker are requeued if its connection is lost, and
+// a result that comes in late is accepted only if no other worker returned it first.
+class Coordinator
+{
+public:
+    using PrepareFn = std::function<void(RemoteJob &rj)>;
+    using FinishFn  = std::function<void(int shard, const Job &job, const GameRecord &r)>;
+
+    Coordinator(const std::string              &bind,
+                const std::string              &port,
+                const std::vector<std::string> &args,
+                JobQueue                       *jq,
+                int                             firstShard,
+                int                             maxWorkers,
+                PrepareFn                       prepare,
+                FinishFn                        finish);
+    ~Coordinator();
+
+private:
+    struct Claim
+    {
+        int connection;
+        Job job;
+    };
+
+    const std::vector<std::string> args;  // command line, sent to workers
+    JobQueue                      *jq;
+    PrepareFn                      prepare;
+    FinishFn                       finish;
+
+    std::mutex               mtx;  // guards everything below
+    std::map<size_t, Claim>  claims;
+    std::vector<int>         freeShards;
+    std::vector<int>         socks;  // open connections, -1 once closed
+    std::vector<std::thread> threads;
+    std::atomic<bool>        stopping;
+    int                      listener;
+    std::thread              acceptThread;
+
+    void accept_loop();
+    void serve(int id, int sock);
+    bool serve_request(int id, int shard, const std::string &line, FILE *in, FILE *out);
+    bool accept_result(int id, size_t idx, Job &job);
+};
+
+// RemoteQueue: job queue of a coordinator, seen from a worker process (thread safe). The
+// connection is reopened whenever it is lost, for up to 'timeout' msec, and results that
+// the coordinator may not have received are sent again. If the coordinator cannot be
+// reached in the first place, the queue is done from the start.
+class RemoteQueue
+{
+public:
+    static constexpr int64_t ReconnectTimeout = 600000;
+
+    RemoteQueue(const std::string &address,
+                int                threads,
+                int64_t            timeout = ReconnectTimeout);
+    ~RemoteQueue();
+
+    // Command line of the coordinator, which defines the tournament
+    const std::vector<std::string> &coordinator_args() const { return args; }
+
+    // False once the tournament is over, or if there is nothing to play for now and
+    // 'wait' is false
+    bool pop(RemoteJob &rj, bool wait = true);
+    void push(const GameRecord &r);
+    bool done() const { return over; }
+    void stop() { over = true; }  // no more jobs, results are still sent
+
+private:
+    const std::string        address;
+    const int                threads;
+    const int64_t            timeout;
+    std::vector<std::string> args;
+
+    std::mutex              mtx;  // guards everything below
+    int                     sock;
+    FILE                   *in, *out;
+    std::vector<RemoteJob>  jobs;     // received, not yet popped
+    std::vector<GameRecord> unacked;  // sent, maybe not received
+    std::atomic<int>        waiting;  // threads waiting in pop()
+    std::atomic<bool>       over;
+    std::thread             keepaliveThread;
+
+    bool connect();
+    void disconnect();
+    bool send_result(const GameRecord &r);
+    bool request(int n);
+    void keepalive();
+};
@@ -0,0 +1,223 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// sample-engine: a random mover, implementing the shared memory fast path (see
+// shmchannel.h) on top of a minimal Gomocup text protocol. It is meant for testing the
+// extension, and as an example for engine authors.
+
+#include "../shmchannel.h"
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <sys/mman.h>
+#include <thread>
+
+static const int MaxSize = 22;
+
+static std::mutex            mtx;  // guards everything below
+static int                   boardSize = 15;
+static int                   board[MaxSize][MaxSize];  // 0: empty, 1: own, 2: opponent
+static std::mt19937          rng(12345);
+static ShmChannel           *channel;
+static std::atomic<uint32_t> linesRead;
+
+static void reply(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+static void reply(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    putchar('\n');
+    fflush(stdout);
+}
+
+static void clear_board()
+{
+    memset(board, 0, sizeof(board));
+}
+
+// Pick a random empty square and play it
+static bool think(int &x, int &y)
+{
+    int empty = 0;
+    for (int i = 0; i < boardSize; i++)
+        for (int j = 0; j < boardSize; j++)
+            empty += !board[i][j];
+
+    if (!empty)
+        return false;
+
+    for (int k = (int)(rng() % empty), i = 0; i < boardSize; i++)
+        for (int j = 0; j < boardSize; j++)
+            if (!board[i][j] && k-- == 0) {
+                x = i, y = j;
+                board[x][y] = 1;
+                return true;
+            }
+
+    return false;
+}
+
+static bool on_board(int x, int y)
+{
+    return x >= 0 && y >= 0 && x < boardSize && y < boardSize;
+}
+
+// Fast path: serve move requests posted on the ring
+static void serve_channel()
+{
+    ShmMessage m;
+
+    while (channel->toEngine.pop(m)) {
+        // Text commands sent before this message must be handled first
+        while (linesRead.load(std::memory_order_acquire) < m.lines)
+            std::this_thread::yield();
+
+        std::lock_guard lock(mtx);
+        bool            go = false;
+
+        switch (m.type) {
+        case SHM_BEGIN: go = true; break;
+        case SHM_TURN:
+            if (on_board(m.x, m.y))
+                board[m.x][m.y] = 2;
+            go = true;
+            break;
+        case SHM_BOARD:
+            if (on_board(m.x, m.y))
+                board[m.x][m.y] = m.arg == 1 ? 1 : 2;
+            break;
+        case SHM_DONE: go = true; break;
+        default: break;  // SHM_TIME_LEFT: a random mover does not care
+        }
+
+        if (go) {
+            int x = -1, y = -1;
+            think(x, y);
+
+            ShmMessage best = {.type  = SHM_BEST,
+                               .lines = 0,
+                               .x     = (int16_t)x,
+                               .y     = (int16_t)y,
+                               .arg   = 1,
+                               .value = 0};
+            channel->toCli.push(best);
+            channel->toCli.publish();
+        }
+    }
+}
+
+static void open_channel(const char *path)
+{
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    void *p =
+        mmap(nullptr, sizeof(ShmChannel), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (p == MAP_FAILED)
+        return;
+
+    channel = (ShmChannel *)p;
+
+    if (channel->magic != ShmChannelMagic || channel->version != ShmChannelVersion) {
+        munmap(p, sizeof(ShmChannel));
+        channel = nullptr;
+        return;
+    }
+
+    channel->engineAck.store(ShmChannelVersion);
+    std::thread(serve_channel).detach();
+}
+
+int main()
+{
+    std::string line;
+    bool        inBoard = false;
+
+    while (std::getline(std::cin, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        {
+            std::lock_guard lock(mtx);
+            int             x, y, stone, size;
+            char            path[4096];
+
+            if (inBoard) {
+                if (line == "DONE") {
+                    inBoard = false;
+                    if (think(x, y))
+                        reply("%d,%d", x, y);
+                }
+                else if (sscanf(line.c_str(), "%d,%d,%d", &x, &y, &stone) == 3
+                         && on_board(x, y))
+                    board[x][y] = stone == 1 ? 1 : 2;
+            }
+            else if (sscanf(line.c_str(), "START %d", &size) == 1) {
+                if (size >= 5 && size <= MaxSize) {
+                    boardSize = size;
+                    clear_board();
+                    reply("OK");
+                }
+                else
+                    reply("ERROR unsupported board size");
+            }
+            else if (line == "RESTART") {
+                clear_board();
+                reply("OK");
+            }
+            else if (line == "BEGIN") {
+                if (think(x, y))
+                    reply("%d,%d", x, y);
+            }
+            else if (sscanf(line.c_str(), "TURN %d,%d", &x, &y) == 2) {
+                if (on_board(x, y))
+                    board[x][y] = 2;
+                if (think(x, y))
+                    reply("%d,%d", x, y);
+            }
+            else if (line == "BOARD") {
+                clear_board();
+                inBoard = true;
+            }
+            else if (sscanf(line.c_str(), "INFO shm_channel %4095s", path) == 1) {
+                if (!channel)
+                    open_channel(path);
+            }
+            else if (line == "ABOUT")
+                reply("name=\"sample-engine\", version=\"1.0\", author=\"c-gomoku-cli\"");
+            else if (line == "END")
+                return EXIT_SUCCESS;
+            // Anything else (INFO keys, YXSTOP...) is ignored
+        }
+
+        linesRead.fetch_add(1, std::memory_order_release);
+    }
+
+    return EXIT_SUCCESS;
+}
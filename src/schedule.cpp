@@ -0,0 +1,360 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "schedule.h"
+
+#include "util.h"
+
+#include <algorithm>
+#include <tuple>
+
+// Players that resolve() returns, other than engines
+static const int Bye     = -1;
+static const int Unknown = -2;
+
+Schedule::Schedule(const PairingParams &pp, int n, int rnd)
+    : swiss(pp.mode == PAIRING_SWISS)
+    , engines(n)
+    , rounds(rnd)
+{
+    if (swiss) {
+        // Matches of round r come after those of earlier rounds, n/2 per round
+        byes.assign(rounds, -1);
+        results.resize((size_t)rounds * (engines / 2));
+        return;
+    }
+
+    // Seeds in bracket order, so that the best seeds meet last: 0 1 -> 0 3 1 2 -> ...
+    std::vector<int> order = {0};
+
+    while ((int)order.size() < engines) {
+        std::vector<int> next;
+
+        for (int s : order) {
+            next.push_back(s);
+            next.push_back(2 * (int)order.size() - 1 - s);
+        }
+
+        order.swap(next);
+    }
+
+    // Winners bracket. Seeds past the last engine are byes: the best seeds skip the
+    // first round.
+    std::vector<std::vector<int>> wb(1);
+    int                           stage = 0;
+
+    for (size_t i = 0; i < order.size(); i += 2)
+        wb[0].push_back(add_node(seed(order[i]), seed(order[i + 1]), stage));
+
+    while (wb.back().size() > 1) {
+        const std::vector<int> &prev = wb.back();
+        std::vector<int>        next;
+
+        stage++;
+        for (size_t i = 0; i < prev.size(); i += 2)
+            next.push_back(add_node(winner(prev[i]), winner(prev[i + 1]), stage));
+
+        wb.push_back(next);
+    }
+
+    // Losers bracket (double elimination): losers of the first round play each other,
+    // then each loser of a later round of the winners bracket drops in against a survivor
+    // of the losers bracket, in reverse order to delay rematches. Its last survivor
+    // meets the winner of the winners bracket in a single grand final.
+    if (pp.doubleElim) {
+        const int        final = wb.back()[0];
+        std::vector<int> lb;
+        Source           last = loser(final);
+
+        if (wb.size() > 1) {
+            stage = 0;
+            for (size_t i = 0; i < wb[0].size(); i += 2)
+                lb.push_back(add_node(loser(wb[0][i]), loser(wb[0][i + 1]), stage));
+
+            for (size_t r = 1; r < wb.size(); r++) {
+                stage++;
+                for (size_t i = 0; i < lb.size(); i++) {
+                    const Source drop = loser(wb[r][lb.size() - 1 - i]);
+                    lb[i]             = add_node(winner(lb[i]), drop, stage);
+                }
+
+                if (lb.size() > 1) {
+                    std::vector<int> next;
+
+                    stage++;
+                    for (size_t i = 0; i < lb.size(); i += 2)
+                        next.push_back(add_node(winner(lb[i]), winner(lb[i + 1]), stage));
+
+                    lb.swap(next);
+                }
+            }
+
+            last = winner(lb[0]);
+        }
+
+        add_node(winner(final), last, stage + 1);
+    }
+
+    // Only matches between two engines have games to play
+    for (size_t i = 0; i < nodes.size(); i++)
+        if (!is_bye(nodes[i].src[0]) && !is_bye(nodes[i].src[1])) {
+            nodes[i].match = (int)matchNodes.size();
+            matchNodes.push_back((int)i);
+        }
+
+    results.resize(matchNodes.size());
+}
+
+int Schedule::matches() const
+{
+    return (int)results.size();
+}
+
+// The loser of 'node' plays on, instead of being eliminated
+Schedule::Source Schedule::loser(int node)
+{
+    nodes[node].loserOut = false;
+    return {.kind = SOURCE_LOSER, .value = node};
+}
+
+int Schedule::add_node(Source s0, Source s1, int stage)
+{
+    nodes.push_back({.src = {s0, s1}, .stage = stage, .match = -1, .loserOut = true});
+    return (int)nodes.size() - 1;
+}
+
+// A bye is known from the bracket alone: the winner of a match is a bye if both its
+// players are, and its loser if either is
+bool Schedule::is_bye(const Source &s) const
+{
+    if (s.kind == SOURCE_SEED)
+        return s.value >= engines;
+
+    const Node &nd = nodes[s.value];
+
+    return s.kind == SOURCE_WINNER ? is_bye(nd.src[0]) && is_bye(nd.src[1])
+                                   : is_bye(nd.src[0]) || is_bye(nd.src[1]);
+}
+
+// Engine of a source, Bye, or Unknown until the matches it depends on are played
+int Schedule::resolve(const Source &s) const
+{
+    if (s.kind == SOURCE_SEED)
+        return s.value < engines ? s.value : Bye;
+
+    const Node &nd = nodes[s.value];
+
+    // Against a bye, an engine goes through without playing
+    if (is_bye(nd.src[0]) || is_bye(nd.src[1])) {
+        if (s.kind == SOURCE_LOSER)
+            return Bye;
+
+        const int e = resolve(nd.src[0]);
+        return e == Bye ? resolve(nd.src[1]) : e;
+    }
+
+    const Match &r = results[nd.match];
+
+    if (!r.done)
+        return Unknown;
+
+    return s.kind == SOURCE_WINNER ? r.winner : r.ei[0] + r.ei[1] - r.winner;
+}
+
+bool Schedule::players(int m, int ei[2])
+{
+    if (swiss) {
+        const int boards = engines / 2;
+
+        // Rounds are paired in order, each once the previous one is finished
+        while ((int)pairings.size() < 2 * (m / boards + 1) * boards) {
+            const int r = (int)pairings.size() / (2 * boards);
+
+            for (int i = (r - 1) * boards; r > 0 && i < r * boards; i++)
+                if (!results[i].done)
+                    return false;
+
+            pair_round(r);
+        }
+
+        ei[0] = pairings[2 * m];
+        ei[1] = pairings[2 * m + 1];
+        return true;
+    }
+
+    const Node &nd = nodes[matchNodes[m]];
+
+    ei[0] = resolve(nd.src[0]);
+    ei[1] = resolve(nd.src[1]);
+    return ei[0] >= 0 && ei[1] >= 0;
+}
+
+void Schedule::finish(int m, const int ei[2], const int score[2])
+{
+    Match &r = results[m];
+
+    r.ei[0]    = ei[0];
+    r.ei[1]    = ei[1];
+    r.score[0] = score[0];
+    r.score[1] = score[1];
+    r.winner   = score[0] > score[1]   ? ei[0]
+                 : score[1] > score[0] ? ei[1]
+                                       : std::min(ei[0], ei[1]);
+    r.done     = true;
+}
+
+// Pair Swiss round 'r' from the standings after the previous rounds: an odd engine out
+// gets a bye (a match won), which goes to the lowest ranked engine with the fewest byes.
+// Then, from the top of the standings, each engine plays the next one down that it has
+// not met yet, if any, else the next one down.
+void Schedule::pair_round(int r)
+{
+    const int                   boards = engines / 2;
+    const std::vector<Standing> table  = tally(r * boards);
+    std::vector<int>            order  = ranking(table);
+    std::vector<bool>           met((size_t)engines * engines);
+
+    for (int i = 0; i < r * boards; i++)
+        met[pairings[2 * i] * engines + pairings[2 * i + 1]] =
+            met[pairings[2 * i + 1] * engines + pairings[2 * i]] = true;
+
+    if (engines % 2) {
+        auto byeCount = [&](int e) { return std::count(byes.begin(), byes.end(), e); };
+        int  bye      = order.back();
+
+        for (auto it = order.rbegin(); it != order.rend(); ++it)
+            if (byeCount(*it) < byeCount(bye))
+                bye = *it;
+
+        byes[r] = bye;
+        order.erase(std::find(order.begin(), order.end(), bye));
+    }
+
+    std::vector<bool> paired(engines);
+
+    for (size_t i = 0; i < order.size(); i++) {
+        const int a = order[i];
+        int       b = -1;
+
+        if (paired[a])
+            continue;
+
+        for (size_t j = i + 1; j < order.size(); j++)
+            if (!paired[order[j]]) {
+                if (b < 0)
+                    b = order[j];
+
+                if (!met[a * engines + order[j]]) {
+                    b = order[j];
+                    break;
+                }
+            }
+
+        paired[a] = paired[b] = true;
+        pairings.push_back(a);
+        pairings.push_back(b);
+    }
+}
+
+// Standings from the matches before 'matchEnd', and Swiss byes of the rounds they cover
+std::vector<Schedule::Standing> Schedule::tally(int matchEnd) const
+{
+    std::vector<Standing> table(engines, Standing{});
+
+    for (int m = 0; m < matchEnd; m++) {
+        const Match &r = results[m];
+
+        if (!r.done)
+            continue;
+
+        for (int i = 0; i < 2; i++) {
+            Standing &s = table[r.ei[i]];
+
+            s.score += r.score[i];
+            s.played += (r.score[0] + r.score[1]) / 2;
+
+            if (swiss)
+                s.points += r.score[i] > r.score[1 - i]    ? 2
+                            : r.score[i] == r.score[1 - i] ? 1
+                                                           : 0;
+            else if (r.ei[i] == r.winner)
+                s.points++;
+            else {
+                const Node &nd = nodes[matchNodes[m]];
+
+                s.lost++;
+                if (nd.loserOut)
+                    s.eliminated = nd.stage + 1;
+            }
+        }
+    }
+
+    for (int r = 0; swiss && r < matchEnd / (engines / 2); r++)
+        if (byes[r] >= 0)
+            table[byes[r]].points += 2;
+
+    return table;
+}
+
+// Engines from first to last. Swiss: by points, then score. Knockout: engines still in
+// first, then by how late they were eliminated, then by matches won. Ties go to the
+// better seed.
+std::vector<int> Schedule::ranking(const std::vector<Standing> &table) const
+{
+    std::vector<int> order(engines);
+
+    for (int e = 0; e < engines; e++)
+        order[e] = e;
+
+    auto key = [&](int e) {
+        const Standing &s = table[e];
+        const int       out = s.eliminated ? s.eliminated : 1 << 30;
+
+        return swiss ? std::make_tuple(s.points, s.score, -e)
+                     : std::make_tuple(out, s.points, -e);
+    };
+
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return key(a) > key(b); });
+    return order;
+}
+
+std::string Schedule::standings(const std::vector<std::string> &names) const
+{
+    const std::vector<Standing> table = tally(matches());
+    const std::vector<int>      order = ranking(table);
+    std::string                 out;
+
+    for (size_t i = 0; i < order.size(); i++) {
+        const Standing &s = table[order[i]];
+
+        if (swiss)
+            out += format("%3zu. %s: %.1f points, score %.1f/%d\n",
+                          i + 1,
+                          names[order[i]],
+                          s.points / 2.0,
+                          s.score / 2.0,
+                          s.played);
+        else
+            out += format("%3zu. %s: %d won, %d lost%s\n",
+                          i + 1,
+                          names[order[i]],
+                          s.points,
+                          s.lost,
+                          s.eliminated ? "" : ", still in");
+    }
+
+    return out;
+}
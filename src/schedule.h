@@ -0,0 +1,94 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "options.h"
+
+#include <string>
+#include <vector>
+
+// Swiss and knockout tournaments (-pairing swiss|knockout): matches of -games games
+// between two engines, whose players are only known once earlier results are in. Matches
+// with games to play are numbered in a fixed order, from the structure of the tournament
+// alone, so that the jobs of a match do not depend on when it is played, and a journal
+// can resume the tournament. Engines are seeded in command line order, and a tied
+// knockout match goes to the better seed.
+class Schedule
+{
+public:
+    Schedule(const PairingParams &pp, int engines, int rounds);
+
+    int  matches() const;
+    bool players(int m, int ei[2]);  // false until the players of match 'm' are known
+    void finish(int m, const int ei[2], const int score[2]);  // score in half points
+    std::string standings(const std::vector<std::string> &names) const;
+
+private:
+    // Knockout: each player of a match is a seed (a bye past the last engine), or the
+    // winner or the loser of an earlier match
+    enum SourceKind { SOURCE_SEED, SOURCE_WINNER, SOURCE_LOSER };
+
+    struct Source
+    {
+        SourceKind kind;
+        int        value;  // seed, or node
+    };
+
+    struct Node
+    {
+        Source src[2];
+        int    stage;     // round of the bracket, in the order they are played
+        int    match;     // or -1 for a bye
+        bool   loserOut;  // loser is eliminated
+    };
+
+    struct Match
+    {
+        int  ei[2];
+        int  score[2];  // in half points
+        int  winner;    // knockout
+        bool done;
+    };
+
+    struct Standing
+    {
+        int points;      // Swiss: in half match points, knockout: matches won
+        int score;       // in half points of games
+        int played;      // games
+        int lost;        // matches
+        int eliminated;  // knockout: stage + 1 of the match that eliminated it, or 0
+    };
+
+    const bool         swiss;
+    const int          engines, rounds;
+    std::vector<Node>  nodes;       // knockout bracket, including matches with a bye
+    std::vector<int>   matchNodes;  // knockout: [match]: node
+    std::vector<int>   pairings;    // Swiss: engines of each match paired so far
+    std::vector<int>   byes;        // Swiss: [round]: engine with a bye, or -1
+    std::vector<Match> results;     // [match]
+
+    Source seed(int s) const { return {.kind = SOURCE_SEED, .value = s}; }
+    Source winner(int node) const { return {.kind = SOURCE_WINNER, .value = node}; }
+    Source loser(int node);
+    int    add_node(Source s0, Source s1, int stage);
+    bool   is_bye(const Source &s) const;
+    int    resolve(const Source &s) const;
+    void   pair_round(int r);
+
+    std::vector<Standing> tally(int matchEnd) const;
+    std::vector<int>      ranking(const std::vector<Standing> &table) const;
+};
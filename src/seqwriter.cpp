@@ -16,6 +16,8 @@
 
 #include "seqwriter.h"
 
+#include "util.h"
+
 #include <algorithm>
 #include <cassert>
 #include <cstring>
@@ -26,19 +28,30 @@ template <typename T> auto insert_sorted(std::vector<T> &vec, T &&item)
     return vec.insert(pos, std::move(item));
 }
 
-SeqWriter::SeqWriter(const char *fileName, const char *mode) : idxNext(0)
+SeqWriter::SeqWriter(const char      *fileName,
+                     const char      *mode,
+                     size_t           idxStart,
+                     SeqWriteCallback callback)
+    : idxNext(idxStart)
+    , onWrite(std::move(callback))
 {
-    out = fopen(fileName, mode);
+    DIE_IF(0, !(out = fopen(fileName, mode)));
 }
 
 SeqWriter::~SeqWriter()
 {
-    // write out all records even if not sequential
-    write_to_i(buf.size());
-
+    flush();
     fclose(out);
 }
 
+void SeqWriter::flush()
+{
+    std::lock_guard lock(mtx);
+
+    onWrite = nullptr;
+    write_to_i(buf.size());
+}
+
 void SeqWriter::push(size_t idx, std::string_view str)
 {
     std::lock_guard lock(mtx);
@@ -61,10 +74,21 @@ void SeqWriter::push(size_t idx, std::string_view str)
 void SeqWriter::write_to_i(size_t i)
 {
     // Write buf[0..i-1] to file
+    std::vector<long> offsets;
+
     for (size_t j = 0; j < i; j++) {
-        fputs(buf[j].str.c_str(), out);
+        fwrite(buf[j].str.data(), 1, buf[j].str.size(), out);
+        if (onWrite)
+            offsets.push_back(ftell(out));
+    }
+
+    if (onWrite) {
+        DIE_IF(0, !file_sync(out));
+        for (size_t j = 0; j < i; j++)
+            onWrite(idxNext + j + 1, offsets[j]);
     }
-    fflush(out);
+    else
+        fflush(out);
 
     // Delete buf[0..i-1]
     buf.erase(buf.begin(), buf.begin() + i);
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <cstdio>
+#include <functional>
 #include <mutex>
 #include <string>
 #include <string_view>
@@ -30,19 +31,31 @@ struct SeqStr
     bool operator<(const SeqStr &other) const { return idx < other.idx; }
 };
 
+// Called with the number of records written so far, and the file offset after the last
+// one, once that record is on stable storage
+using SeqWriteCallback = std::function<void(size_t count, long offset)>;
+
 class SeqWriter
 {
 public:
-    SeqWriter(const char *fileName, const char *mode);
+    SeqWriter(const char      *fileName,
+              const char      *mode,
+              size_t           idxStart = 0,
+              SeqWriteCallback onWrite  = nullptr);
     ~SeqWriter();
 
     void push(size_t idx, std::string_view str);
 
+    // Write out all records pushed so far, even if not in sequence (but do not report
+    // them as written in sequence)
+    void flush();
+
 private:
     std::mutex          mtx;
     std::vector<SeqStr> buf;
     FILE               *out;
     size_t              idxNext;
+    SeqWriteCallback    onWrite;
 
     void write_to_i(size_t i);
 };
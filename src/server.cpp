@@ -0,0 +1,371 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "server.h"
+
+#include "util.h"
+
+#ifndef __MINGW32__
+    #include <fcntl.h>
+    #include <signal.h>
+    #include <sys/wait.h>
+    #include <unistd.h>
+    #ifdef __linux__
+        #include <sys/prctl.h>
+    #endif
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#ifndef __MINGW32__
+
+static const int64_t ScanInterval   = 1000;   // msec between scans of the spool directory
+static const int64_t ConnectTimeout = 10000;  // msec for a coordinator to be reachable
+static const int64_t StartupGrace   = 500;    // msec for a bad command line to show up
+
+// Split the command line of a tournament file into arguments
+static std::vector<std::string> read_args(const std::string &fileName)
+{
+    std::ifstream            in(fileName);
+    std::stringstream        ss;
+    std::vector<std::string> args;
+    std::string              arg;
+    bool                     quoted = false, inArg = false;
+
+    ss << in.rdbuf();
+    const std::string text = ss.str();
+
+    for (const char *p = text.c_str(); *p; p++) {
+        if (*p == '#' && !quoted && !inArg) {
+            while (p[1] && p[1] != '\n')
+                p++;
+        }
+        else if (*p == '"') {
+            quoted = !quoted;
+            inArg  = true;
+        }
+        else if (!quoted && isspace((unsigned char)*p)) {
+            if (inArg)
+                args.push_back(arg);
+            arg.clear();
+            inArg = false;
+        }
+        else {
+            arg += *p;
+            inArg = true;
+        }
+    }
+
+    if (inArg)
+        args.push_back(arg);
+
+    return args;
+}
+
+TournamentServer::TournamentServer(const ServerParams &sv,
+                                   const std::string  &exe,
+                                   int                 n,
+                                   ParseFn             p)
+    : dir(sv.dir)
+    , self(exe)
+    , threads(n)
+    , parse(std::move(p))
+    , nextPort(sv.port)
+    , stopped(false)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec)
+        DIE("cannot create spool directory '%s': %s\n",
+            dir.c_str(),
+            ec.message().c_str());
+
+    printf("Server: waiting for tournaments in %s\n", dir.c_str());
+    scanThread = std::thread(&TournamentServer::scan_loop, this);
+}
+
+// Coordinators are stopped once the games in progress are in: they write their outputs
+// and final results, and can be resumed from their journal
+TournamentServer::~TournamentServer()
+{
+    stop();
+
+    // A tournament that cannot be parsed makes the scan thread itself exit the program
+    if (scanThread.get_id() == std::this_thread::get_id())
+        scanThread.detach();
+    else
+        scanThread.join();
+
+    for (auto &t : tournaments) {
+        delete t->remote;
+
+        if (t->pid > 0) {
+            kill(t->pid, SIGTERM);
+            waitpid(t->pid, nullptr, 0);
+            printf("Server: tournament %s stopped\n", t->name.c_str());
+        }
+    }
+}
+
+TournamentServer::Tournament *TournamentServer::pop(RemoteJob &rj)
+{
+    std::unique_lock lock(mtx);
+
+    while (!stopped) {
+        // Fewest games in progress relative to weight first
+        std::vector<Tournament *> order;
+
+        for (auto &t : tournaments)
+            if (t->remote && !t->cancelled && !t->remote->done())
+                order.push_back(t.get());
+
+        std::stable_sort(order.begin(), order.end(), [](Tournament *a, Tournament *b) {
+            return a->playing / a->options.weight < b->playing / b->options.weight;
+        });
+
+        // The job is requested without the lock, while 'playing' keeps the tournament
+        for (Tournament *t : order) {
+            t->playing++;
+            lock.unlock();
+            const bool popped = t->remote->pop(rj, false);
+            lock.lock();
+
+            if (popped)
+                return t;
+
+            t->playing--;
+        }
+
+        cv.wait_for(lock, std::chrono::milliseconds(100));
+    }
+
+    return nullptr;
+}
+
+void TournamentServer::push(Tournament *t, const GameRecord &r)
+{
+    t->remote->push(r);
+
+    std::lock_guard lock(mtx);
+    t->playing--;
+}
+
+void TournamentServer::stop()
+{
+    stopped = true;
+    cv.notify_all();
+}
+
+void TournamentServer::scan_loop()
+{
+    while (!stopped) {
+        scan();
+        reap();
+
+        const int64_t start = system_msec();
+
+        while (!stopped && system_msec() - start < ScanInterval)
+            system_sleep(100);
+    }
+}
+
+// Start new tournaments, and cancel those whose file was deleted
+void TournamentServer::scan()
+{
+    std::vector<std::string> names, current;
+    std::error_code          ec;
+
+    for (const auto &entry : std::filesystem::directory_iterator(dir, ec))
+        if (entry.path().extension() == ".tour")
+            names.push_back(entry.path().stem().string());
+
+    std::sort(names.begin(), names.end());
+
+    {
+        std::lock_guard lock(mtx);
+        for (auto &t : tournaments)
+            current.push_back(t->name);
+    }
+
+    for (const std::string &name : names)
+        if (std::find(current.begin(), current.end(), name) == current.end())
+            start(name);
+
+    std::lock_guard lock(mtx);
+
+    for (auto &t : tournaments)
+        if (t->pid > 0 && !t->cancelled
+            && std::find(names.begin(), names.end(), t->name) == names.end()) {
+            printf("Server: tournament %s cancelled\n", t->name.c_str());
+            t->cancelled = true;
+            t->remote->stop();
+            kill(t->pid, SIGTERM);
+        }
+}
+
+void TournamentServer::start(const std::string &name)
+{
+    const std::string              work = dir + "/" + name;
+    const std::vector<std::string> args = read_args(work + ".tour");
+    const int                      port = nextPort++;
+    std::error_code                ec;
+
+    std::filesystem::create_directories(work, ec);
+
+    // The coordinator runs the tournament, and leaves the games to this server
+    std::vector<std::string> argv = {self};
+    argv.insert(argv.end(), args.begin(), args.end());
+    argv.insert(argv.end(),
+                {"-coordinator",
+                 "bind=127.0.0.1",
+                 format("port=%d", port),
+                 "-concurrency",
+                 "0"});
+
+    std::vector<char *> cargv;
+    for (std::string &arg : argv)
+        cargv.push_back(arg.data());
+    cargv.push_back(nullptr);
+
+    const std::string log = name + ".log";
+    int               pid;
+    DIE_IF(0, (pid = fork()) < 0);
+
+    if (pid == 0) {
+    #ifdef __linux__
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+    #endif
+        // Signals sent to the server (from a terminal) are not for the coordinator
+        setpgid(0, 0);
+
+        int fd;
+        if (chdir(work.c_str()) < 0
+            || (fd = open(log.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644)) < 0
+            || dup2(fd, STDOUT_FILENO) < 0 || dup2(fd, STDERR_FILENO) < 0)
+            _exit(EXIT_FAILURE);
+
+        execv(self.c_str(), cargv.data());
+        _exit(EXIT_FAILURE);
+    }
+
+    // A command line that cannot be parsed makes the coordinator exit at once, instead
+    // of listening
+    bool exited = false;
+
+    for (int64_t start = system_msec(); !exited && system_msec() - start < StartupGrace;
+         system_sleep(50))
+        exited = waitpid(pid, nullptr, WNOHANG) == pid;
+
+    auto t = std::make_unique<Tournament>();
+    t->name      = name;
+    t->pid       = pid;
+    t->playing   = 0;
+    t->cancelled = false;
+    t->remote    = exited ? nullptr
+                          : new RemoteQueue(format("127.0.0.1:%d", port),
+                                            threads,
+                                            ConnectTimeout);
+
+    // A tournament that fails to start reports why in its log
+    if (!t->remote || t->remote->done()) {
+        delete t->remote;
+
+        if (!exited) {
+            kill(pid, SIGTERM);
+            waitpid(pid, nullptr, 0);
+        }
+
+        printf("Server: tournament %s failed to start, see %s/%s\n",
+               name.c_str(),
+               work.c_str(),
+               log.c_str());
+        std::filesystem::rename(work + ".tour", work + ".failed", ec);
+        return;
+    }
+
+    parse(t->remote->coordinator_args(), t->options, t->eo);
+    printf("Server: tournament %s started on port %d, weight %g\n",
+           name.c_str(),
+           port,
+           t->options.weight);
+
+    std::lock_guard lock(mtx);
+    tournaments.push_back(std::move(t));
+    cv.notify_all();
+}
+
+// Tournaments whose coordinator exited are over, and removed once their games are in
+void TournamentServer::reap()
+{
+    std::lock_guard lock(mtx);
+
+    for (auto &t : tournaments) {
+        int status;
+
+        // Once all games are in, the connection is closed, so that the coordinator exits
+        if (t->remote && t->remote->done() && !t->playing) {
+            delete t->remote;
+            t->remote = nullptr;
+        }
+
+        if (t->pid > 0 && waitpid(t->pid, &status, WNOHANG) == t->pid) {
+            t->pid = 0;
+            if (t->remote)
+                t->remote->stop();
+            finish(*t, WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+        }
+    }
+
+    tournaments.erase(std::remove_if(tournaments.begin(),
+                                     tournaments.end(),
+                                     [](auto &t) { return !t->pid && !t->remote; }),
+                      tournaments.end());
+}
+
+void TournamentServer::finish(Tournament &t, bool ok)
+{
+    const std::string base = dir + "/" + t.name;
+    std::error_code   ec;
+
+    if (t.cancelled)
+        printf("Server: tournament %s stopped\n", t.name.c_str());
+    else {
+        printf("Server: tournament %s %s\n", t.name.c_str(), ok ? "finished" : "failed");
+        std::filesystem::rename(base + ".tour", base + (ok ? ".done" : ".failed"), ec);
+    }
+}
+
+#else
+
+TournamentServer::TournamentServer(const ServerParams &,
+                                   const std::string &,
+                                   int,
+                                   ParseFn)
+    : threads(0)
+{
+    DIE("-server is not supported on Windows\n");
+}
+
+TournamentServer::~TournamentServer() {}
+TournamentServer::Tournament *TournamentServer::pop(RemoteJob &) { return nullptr; }
+void TournamentServer::push(Tournament *, const GameRecord &) {}
+void TournamentServer::stop() {}
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "options.h"
+#include "remote.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Tournament server (-server): plays the games of any number of tournaments on one pool
+// of workers. Tournaments are defined by files of a spool directory:
+//   NAME.tour       command line of the tournament (whitespace separated, "quoted"
+//                   arguments, # comments), added at any time; deleting it cancels
+//                   the tournament
+//   NAME/           working directory of the tournament, for its outputs and journal
+//   NAME/NAME.log   standard output of the tournament
+//   NAME.done       definition of a finished tournament (NAME.failed if it failed)
+// Each tournament runs as a coordinator process of its own (on 127.0.0.1, from the base
+// port up), which keeps results, outputs and SPRT, and which the server connects to as a
+// worker. Workers take their next game from the tournament with the fewest games in
+// progress relative to its weight (-weight), among those that have a game to play.
+class TournamentServer
+{
+public:
+    struct Tournament
+    {
+        std::string                name;
+        Options                    options;
+        std::vector<EngineOptions> eo;
+        RemoteQueue               *remote;   // nullptr once all games are in
+        int                        pid;      // of the coordinator, 0 once it exited
+        int                        playing;  // games in progress, or being popped
+        bool                       cancelled;
+    };
+
+    // Parse the command line of a tournament, as received from its coordinator
+    using ParseFn = std::function<void(const std::vector<std::string> &args,
+                                       Options                        &o,
+                                       std::vector<EngineOptions>     &eo)>;
+
+    TournamentServer(const ServerParams &sv,
+                     const std::string  &self,
+                     int                 threads,
+                     ParseFn             parse);
+    ~TournamentServer();
+
+    // Next game to play, and its tournament. Returns nullptr once stopped.
+    Tournament *pop(RemoteJob &rj);
+    void        push(Tournament *t, const GameRecord &r);
+
+    void stop();  // no more games, and no new tournament
+    bool done() const { return stopped; }
+
+private:
+    const std::string dir;
+    const std::string self;  // path of this executable
+    const int         threads;
+    ParseFn           parse;
+    int               nextPort;
+
+    std::mutex                               mtx;  // guards everything below
+    std::condition_variable                  cv;
+    std::vector<std::unique_ptr<Tournament>> tournaments;  // active, or still playing
+    std::atomic<bool>                        stopped;
+    std::thread                              scanThread;
+
+    void scan_loop();
+    void scan();
+    void start(const std::string &name);
+    void reap();
+    void finish(Tournament &t, bool ok);
+};
@@ -0,0 +1,143 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Shared memory fast path: an optional extension of the Gomocup protocol, for engines
+// playing hundreds of moves per second (eg. fixed nodes data generation), where text
+// formatting and pipe I/O dominate. Linux only (futex).
+//
+// Negotiation: after ABOUT, the cli sends 'INFO shm_channel <path>'. An engine that
+// supports the extension maps <path> (see ShmChannel), checks magic and version, and
+// stores ShmChannelVersion in 'engineAck' before answering the next START with OK.
+// Other engines ignore the INFO key, and the cli keeps using the text protocol.
+//
+// Once acknowledged, each move request (in place of INFO time_left and BEGIN, TURN or
+// BOARD) is a batch of ShmMessage posted on the 'toEngine' ring:
+//   SHM_TIME_LEFT value=msec
+//   SHM_BEGIN | SHM_TURN x,y | SHM_BOARD x,y,arg=stone (1: own, 2: opponent)... SHM_DONE
+// and the engine answers with one message on the 'toCli' ring:
+//   SHM_BEST x,y arg=depth value=eval
+// All other commands (START, INFO, YXSTOP, END...) and engine output (MESSAGE...) still
+// go through the text channel. To keep both channels in order, each message carries the
+// number of text lines sent before it: the engine must have read that many lines from
+// stdin before handling the message.
+//
+// This header is self contained, so that engines can include it as is.
+
+#pragma once
+#ifdef __linux__
+    #include <atomic>
+    #include <cerrno>
+    #include <climits>
+    #include <cstdint>
+    #include <ctime>
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+
+static const uint32_t ShmChannelMagic   = 0x474d4b53;  // "SKMG"
+static const uint32_t ShmChannelVersion = 1;
+
+enum ShmMessageType : uint32_t {
+    SHM_TIME_LEFT = 1,
+    SHM_BEGIN,
+    SHM_TURN,
+    SHM_BOARD,
+    SHM_DONE,
+    SHM_BEST,
+};
+
+struct ShmMessage
+{
+    uint32_t type;
+    uint32_t lines;  // text lines sent before this message
+    int16_t  x, y;
+    int32_t  arg;
+    int64_t  value;
+};
+
+// Single producer, single consumer ring. 'head' is the futex word the consumer sleeps
+// on, and 'sleeping' saves the producer a syscall when the consumer is busy.
+struct ShmRing
+{
+    static const uint32_t Size = 1024;  // more than a full BOARD request
+
+    alignas(64) std::atomic<uint32_t> head;  // written by producer
+    alignas(64) std::atomic<uint32_t> tail;  // written by consumer
+    std::atomic<uint32_t> sleeping;
+    ShmMessage            slots[Size];
+
+    // Producer: queue a message, returns false when the ring is full
+    bool push(const ShmMessage &m)
+    {
+        const uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= Size)
+            return false;
+
+        slots[h % Size] = m;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Producer: wake up the consumer, once queued messages form a complete batch
+    void publish()
+    {
+        if (sleeping.load(std::memory_order_seq_cst))
+            syscall(SYS_futex, &head, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+
+    // Consumer: dequeue a message, waiting at most timeoutMsec (-1: forever). Returns
+    // false on timeout.
+    bool pop(ShmMessage &m, int64_t timeoutMsec = -1)
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed), h;
+
+        while ((h = head.load(std::memory_order_acquire)) == t) {
+            if (timeoutMsec == 0)
+                return false;
+
+            struct timespec ts = {.tv_sec  = (time_t)(timeoutMsec / 1000),
+                                  .tv_nsec = (long)(timeoutMsec % 1000) * 1000000};
+
+            sleeping.store(1, std::memory_order_seq_cst);
+            // Check again, as the producer may have published before it saw us sleeping
+            const bool empty = head.load(std::memory_order_seq_cst) == t;
+            const long r     = empty ? syscall(SYS_futex,
+                                           &head,
+                                           FUTEX_WAIT,
+                                           h,
+                                           timeoutMsec < 0 ? nullptr : &ts,
+                                           nullptr,
+                                           0)
+                                     : 0;
+            sleeping.store(0, std::memory_order_relaxed);
+
+            if (r < 0 && errno == ETIMEDOUT)
+                timeoutMsec = 0;
+        }
+
+        m = slots[t % Size];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+struct ShmChannel
+{
+    uint32_t              magic, version;
+    std::atomic<uint32_t> engineAck;
+    ShmRing               toEngine, toCli;
+};
+#endif
@@ -0,0 +1,169 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "simulate.h"
+
+#include "game.h"
+#include "jobs.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+enum SimVerdict { SIM_H0, SIM_H1, SIM_UNDECIDED };
+
+struct SimRun
+{
+    SimVerdict verdict;
+    int        games;  // played until the test stopped
+};
+
+static double elo_to_score(double elo)
+{
+    return 1 / (1 + exp(-elo * log(10) / 400));
+}
+
+// One run of the test, checked after each game, or after each game pair with the
+// pentanomial model, as in a tournament. prob[c] are the probabilities of each outcome
+// of the engine under test, moving first (c = 0) or second (c = 1), which alternate.
+static SimRun simulate_run(const SPRTParam &sp,
+                           const double     prob[2][NB_RESULT],
+                           int              maxGames,
+                           uint64_t         seed)
+{
+    std::mt19937_64                        rng(seed);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    double                                 lower, upper;
+    Result                                 r     = {};
+    int                                    first = 0;  // outcome of the pair's 1st game
+
+    sp.bounds(lower, upper);
+
+    for (int g = 0; g < maxGames; g++) {
+        const double *p = prob[g % 2];
+        const double  x = uniform(rng);
+        const int     outcome = x < p[RESULT_LOSS]                      ? RESULT_LOSS
+                                : x < p[RESULT_LOSS] + p[RESULT_DRAW] ? RESULT_DRAW
+                                                                        : RESULT_WIN;
+
+        r.count[outcome]++;
+
+        if (g % 2 == 0)
+            first = outcome;
+        else
+            r.penta[first + outcome]++;
+
+        if (sp.pentanomial && g % 2 == 0)
+            continue;
+
+        const double llr = sp.llr(r);
+
+        if (llr > upper)
+            return {.verdict = SIM_H1, .games = g + 1};
+        else if (llr < lower)
+            return {.verdict = SIM_H0, .games = g + 1};
+    }
+
+    return {.verdict = SIM_UNDECIDED, .games = maxGames};
+}
+
+void simulate_sprt(const Options &o)
+{
+    const SimulateParams &sim      = o.sim;
+    const int             maxGames = o.rounds * o.games;
+    const int             threads  = std::max(1, o.concurrency);
+    const uint64_t        seed     = sim.seed ? sim.seed : std::random_device()();
+    double                prob[2][NB_RESULT];
+
+    // The engine under test scores elo_to_score(elo +/- bias) moving first or second, and
+    // draws with the same probability either way
+    for (int c = 0; c < 2; c++) {
+        const double score = elo_to_score(sim.elo + (c ? -sim.bias : sim.bias));
+
+        if (sim.draws > 2 * std::min(score, 1 - score))
+            DIE("-simulate: draw ratio %g is too high for a score of %g\n",
+                sim.draws,
+                score);
+
+        prob[c][RESULT_WIN]  = score - sim.draws / 2;
+        prob[c][RESULT_DRAW] = sim.draws;
+        prob[c][RESULT_LOSS] = 1 - score - sim.draws / 2;
+    }
+
+    // Runs are spread across threads, each run with a seed of its own, so that results
+    // do not depend on the number of threads
+    std::vector<SimRun>      runs(sim.runs);
+    std::vector<std::thread> pool;
+    const int64_t            start = system_msec();
+
+    for (int t = 0; t < threads; t++)
+        pool.emplace_back([&, t]() {
+            for (int i = t; i < sim.runs; i += threads)
+                runs[i] = simulate_run(o.sprtParam,
+                                       prob,
+                                       maxGames,
+                                       seed + 0x9E3779B97F4A7C15ULL * (i + 1));
+        });
+
+    for (std::thread &th : pool)
+        th.join();
+
+    // Report outcomes, and percentiles of the number of games
+    int              verdicts[3] = {0, 0, 0};
+    std::vector<int> games;
+    double           mean = 0;
+
+    for (const SimRun &run : runs) {
+        verdicts[run.verdict]++;
+        games.push_back(run.games);
+        mean += (double)run.games / runs.size();
+    }
+
+    std::sort(games.begin(), games.end());
+    auto percentile = [&](double q) { return games[(size_t)(q * (games.size() - 1))]; };
+
+    printf("SPRT simulation: %d runs of up to %d games, with elo0=%g elo1=%g alpha=%g "
+           "beta=%g (%s), true Elo %g, draws %g%%, first move bias %g Elo\n",
+           sim.runs,
+           maxGames,
+           o.sprtParam.elo0,
+           o.sprtParam.elo1,
+           o.sprtParam.alpha,
+           o.sprtParam.beta,
+           o.sprtParam.pentanomial ? "pentanomial" : "trinomial",
+           sim.elo,
+           sim.draws * 100,
+           sim.bias);
+    printf("H1 accepted: %.2f%%\n", 100.0 * verdicts[SIM_H1] / sim.runs);
+    printf("H0 accepted: %.2f%%\n", 100.0 * verdicts[SIM_H0] / sim.runs);
+    printf("Undecided: %.2f%%\n", 100.0 * verdicts[SIM_UNDECIDED] / sim.runs);
+    printf("Games to termination: mean %.0f, 5%% %d, 25%% %d, median %d, 75%% %d, "
+           "95%% %d, max %d\n",
+           mean,
+           percentile(0.05),
+           percentile(0.25),
+           percentile(0.5),
+           percentile(0.75),
+           percentile(0.95),
+           games.back());
+    printf("Simulated in %.1f seconds, on %d threads\n",
+           (system_msec() - start) / 1000.0,
+           threads);
+}
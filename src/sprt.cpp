@@ -17,6 +17,7 @@
 #include "sprt.h"
 
 #include "game.h"
+#include "jobs.h"
 
 #include <cmath>
 
@@ -25,18 +26,29 @@ static double elo_to_score(double elo)
     return 1 / (1 + exp(-elo * log(10) / 400));
 }
 
-// Uses asymptotic LLR approximation in the trinomial GSPRT model. See:
+// Uses asymptotic LLR approximation in the GSPRT model, over a sample whose scores are
+// i/(k-1) with count[i] occurrences: games (k=3), or game pairs (k=5). See:
 // http://hardy.uhasselt.be/Toga/GSPRT_approximation.pdf
-static double sprt_llr(int wldCount[NB_RESULT], double elo0, double elo1)
+static double sprt_llr(const int count[], int k, double elo0, double elo1)
 {
-    // at least 2 among 3 must be non zero
-    if (!!wldCount[0] + !!wldCount[1] + !!wldCount[2] < 2)
+    // at least 2 among k must be non zero
+    int n = 0, nonZero = 0;
+    for (int i = 0; i < k; i++) {
+        n += count[i];
+        nonZero += !!count[i];
+    }
+
+    if (nonZero < 2)
         return 0;
 
-    const int    n = wldCount[RESULT_WIN] + wldCount[RESULT_LOSS] + wldCount[RESULT_DRAW];
-    const double w = (double)wldCount[RESULT_WIN] / n,
-                 l = (double)wldCount[RESULT_LOSS] / n, d = 1 - w - l;
-    const double s = w + d / 2, var = (w + d / 4) - s * s;
+    double s = 0, s2 = 0;
+    for (int i = 0; i < k; i++) {
+        const double x = (double)i / (k - 1);
+        s += x * count[i] / n;
+        s2 += x * x * count[i] / n;
+    }
+
+    const double var = s2 - s * s;
     const double s0 = elo_to_score(elo0), s1 = elo_to_score(elo1);
 
     return (s1 - s0) * (2 * s - s0 - s1) / (2 * var / n);
@@ -47,22 +59,39 @@ bool SPRTParam::validate() const
     return 0 < alpha && alpha < 1 && 0 < beta && beta < 1 && elo0 < elo1;
 }
 
-bool SPRTParam::done(int wldCount[NB_RESULT]) const
+// Log likelihood ratio of H1 over H0, from games or game pairs
+double SPRTParam::llr(const Result &r) const
 {
-    const double lbound = log(beta / (1 - alpha));
-    const double ubound = log((1 - beta) / alpha);
-    const double llr    = sprt_llr(wldCount, elo0, elo1);
+    return pentanomial ? sprt_llr(r.penta, 5, elo0, elo1)
+                       : sprt_llr(r.count, NB_RESULT, elo0, elo1);
+}
+
+// The test accepts H0 once the LLR falls below 'lower', and H1 once it rises above
+// 'upper'
+void SPRTParam::bounds(double &lower, double &upper) const
+{
+    lower = log(beta / (1 - alpha));
+    upper = log((1 - beta) / alpha);
+}
+
+// Print the LLR, and return the accepted hypothesis, or NULL while the test goes on
+const char *SPRTParam::verdict(const Result &r) const
+{
+    double lbound, ubound;
+    bounds(lbound, ubound);
+
+    const double value = llr(r);
 
-    if (llr > ubound) {
-        printf("SPRT: LLR = %.3f [%.3f,%.3f]. H1 accepted.\n", llr, lbound, ubound);
-        return true;
+    if (value > ubound) {
+        printf("SPRT: LLR = %.3f [%.3f,%.3f]. H1 accepted.\n", value, lbound, ubound);
+        return "H1 accepted";
     }
-    else if (llr < lbound) {
-        printf("SPRT: LLR = %.3f [%.3f,%.3f]. H0 accepted.\n", llr, lbound, ubound);
-        return true;
+    else if (value < lbound) {
+        printf("SPRT: LLR = %.3f [%.3f,%.3f]. H0 accepted.\n", value, lbound, ubound);
+        return "H0 accepted";
     }
     else
-        printf("SPRT: LLR = %.3f [%.3f,%.3f]\n", llr, lbound, ubound);
+        printf("SPRT: LLR = %.3f [%.3f,%.3f]\n", value, lbound, ubound);
 
-    return false;
+    return nullptr;
 }
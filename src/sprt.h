@@ -16,10 +16,16 @@
 
 #pragma once
 
+struct Result;
+
 struct SPRTParam
 {
     double elo0, elo1, alpha, beta;
+    bool   pentanomial;  // test on game pairs (-repeat), instead of single games
 
-    bool validate() const;
-    bool done(int wldCount[3]) const;
+    bool        validate() const;
+    double      llr(const Result &r) const;
+    void        bounds(double &lower, double &upper) const;
+    const char *verdict(const Result &r) const;
+    bool        done(const Result &r) const { return verdict(r) != nullptr; }
 };
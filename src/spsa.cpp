@@ -0,0 +1,192 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "spsa.h"
+
+#include "game.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+SPSA::SPSA(const SPSAParams &sp_, int iterations_, bool resume, uint64_t seed_)
+    : sp(sp_)
+    , seed(seed_)
+    , iterations(iterations_)
+    , started(0)
+    , done(0)
+{
+    for (const SPSAParam &p : sp.params)
+        theta.push_back(p.start);
+
+    FILE *in = fopen(sp.file.c_str(), "r");
+    if (!in)
+        return;
+
+    // Checkpoint: "iteration K of N", then one "NAME VALUE" line per parameter
+    int    total = 0;
+    char   name[256];
+    double x;
+
+    if (fscanf(in, "iteration %d of %d", &done, &total) != 2)
+        DIE("Invalid SPSA checkpoint %s\n", sp.file.c_str());
+
+    while (fscanf(in, "%255s %lf", name, &x) == 2) {
+        size_t i = 0;
+        while (i < sp.params.size() && sp.params[i].name != name)
+            i++;
+
+        if (i == sp.params.size())
+            DIE("Unknown param '%s' in SPSA checkpoint %s\n", name, sp.file.c_str());
+
+        theta[i] = x;
+    }
+
+    fclose(in);
+
+    // A resumed tournament plays the rest of the iterations planned, a new one plays
+    // iterations of its own on top of those checkpointed
+    started    = done;
+    iterations = resume ? std::max(total, done) : done + iterations;
+
+    printf("SPSA: resume from checkpoint %s at iteration %d of %d\n",
+           sp.file.c_str(),
+           done,
+           iterations);
+}
+
+void SPSA::perturb(size_t idx, EngineOptions variant[2])
+{
+    std::scoped_lock lock(mtx);
+    const size_t     pair = idx / 2;
+    auto             it   = pending.find(pair);
+
+    // The first game of a pair starts the iteration, and decides the perturbation
+    if (it == pending.end()) {
+        Iteration iter  = {.k     = ++started,
+                           .base  = theta,
+                           .delta = {},
+                           .games = 0,
+                           .score = 0};
+        uint64_t  state = seed + (uint64_t)iter.k * 0xD1B54A32D192ED03;
+        const int n     = iter.k;
+
+        for (const SPSAParam &p : sp.params) {
+            const double c = p.c * pow((double)std::max(iterations, n) / n, sp.gamma);
+            iter.delta.push_back(prng(state) & 1 ? c : -c);
+        }
+
+        it = pending.emplace(pair, iter).first;
+    }
+
+    for (int side = 0; side < 2; side++) {
+        std::vector<std::string> &options = variant[side].options;
+
+        for (size_t i = 0; i < sp.params.size(); i++) {
+            const SPSAParam  &p = sp.params[i];
+            const double      x = it->second.base[i]
+                                  + (side ? -it->second.delta[i] : it->second.delta[i]);
+            const std::string option =
+                p.name + "=" + value(i, std::clamp(x, p.min, p.max));
+
+            // Tuned values replace those given on the command line
+            auto same = std::find_if(options.begin(), options.end(), [&](auto &o) {
+                return !o.compare(0, p.name.size() + 1, p.name + "=");
+            });
+
+            if (same != options.end())
+                *same = option;
+            else
+                options.push_back(option);
+        }
+    }
+}
+
+void SPSA::add_result(size_t idx, int outcome)
+{
+    std::scoped_lock lock(mtx);
+    auto             it = pending.find(idx / 2);
+
+    // Pairs started in a previous run, without a checkpoint, are left out
+    if (it == pending.end())
+        return;
+
+    Iteration &iter = it->second;
+    iter.score += outcome - RESULT_DRAW;  // wins - losses of the plus variant
+
+    if (++iter.games < 2)
+        return;
+
+    // theta += a_k * score / (c_k * delta), with a step that reaches r * c^2 at the last
+    // iteration
+    const int    n = std::max(iterations, iter.k);
+    const double A = sp.A ? sp.A : 0.1 * n;
+
+    for (size_t i = 0; i < sp.params.size(); i++) {
+        const SPSAParam &p = sp.params[i];
+        const double     a = sp.r * p.c * p.c * pow((A + n) / (A + iter.k), sp.alpha);
+
+        theta[i] = std::clamp(theta[i] + a * iter.score / iter.delta[i], p.min, p.max);
+    }
+
+    pending.erase(it);
+    done++;
+    save();
+
+    std::string values;
+    for (size_t i = 0; i < sp.params.size(); i++)
+        values += format(" %s=%s", sp.params[i].name, value(i, theta[i]));
+
+    printf("SPSA iteration %d of %d:%s\n", done, n, values.c_str());
+}
+
+std::string SPSA::report()
+{
+    std::scoped_lock lock(mtx);
+    std::string      out = format("SPSA parameters after %d iterations:\n", done);
+
+    for (size_t i = 0; i < sp.params.size(); i++)
+        out += format("  %s = %s (%.3f)\n",
+                      sp.params[i].name,
+                      value(i, theta[i]),
+                      theta[i]);
+
+    return out;
+}
+
+std::string SPSA::value(size_t i, double x) const
+{
+    return sp.params[i].integer ? format("%ld", lround(x)) : format("%g", x);
+}
+
+// Write to a temporary file, renamed over the checkpoint, so that it is never left half
+// written
+void SPSA::save() const
+{
+    const std::string tmp = sp.file + ".tmp";
+    FILE             *out = fopen(tmp.c_str(), "w");
+    DIE_IF(0, !out);
+
+    fprintf(out, "iteration %d of %d\n", done, std::max(iterations, done));
+    for (size_t i = 0; i < sp.params.size(); i++)
+        fprintf(out, "%s %.17g\n", sp.params[i].name.c_str(), theta[i]);
+
+    DIE_IF(0, !file_sync(out));
+    DIE_IF(0, fclose(out));
+    DIE_IF(0, rename(tmp.c_str(), sp.file.c_str()));
+}
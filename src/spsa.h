@@ -0,0 +1,67 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "options.h"
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// SPSA tuning (-spsa): each game pair is an iteration, played between a plus and a minus
+// variant of the engine, whose tuned options are perturbed in opposite directions by a
+// random vector of +/-c_k. The values are sent as INFO lines at the start of each game,
+// and the parameters move towards the variant that scored best once the pair is over.
+// As pairs are played concurrently, an iteration is applied to the parameters current
+// when it ends, not those it started from. Progress is checkpointed to a file, after
+// each iteration, and resumed from it.
+class SPSA
+{
+public:
+    SPSA(const SPSAParams &sp, int iterations, bool resume, uint64_t seed);
+
+    // Options of the plus (side 0) and minus (side 1) variants that play game 'idx'
+    void perturb(size_t idx, EngineOptions variant[2]);
+
+    // Result of game 'idx' from the point of view of the plus variant
+    void add_result(size_t idx, int outcome);
+
+    std::string report();
+
+private:
+    struct Iteration
+    {
+        int                 k;      // from 1
+        std::vector<double> base;   // parameters when the pair started
+        std::vector<double> delta;  // c_k times +/-1, for each parameter
+        int                 games, score;
+    };
+
+    const SPSAParams sp;
+    const uint64_t   seed;
+
+    std::mutex                  mtx;  // guards everything below
+    std::vector<double>         theta;
+    int                         iterations;     // planned, the gains are scaled to it
+    int                         started, done;  // iterations, including previous runs
+    std::map<size_t, Iteration> pending;        // by game pair
+
+    std::string value(size_t i, double x) const;
+    void        save() const;
+};
@@ -0,0 +1,718 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined(__MINGW32__)
+    #include <fcntl.h>
+    #include <io.h>
+    #include <windows.h>
+#elif defined(__linux__)
+    #define _GNU_SOURCE
+    #include <fcntl.h>
+    #include <netdb.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <poll.h>
+    #include <sys/prctl.h>
+    #include <sys/socket.h>
+    #include <sys/wait.h>
+    #include <unistd.h>
+#else
+    #include <fcntl.h>
+    #include <netdb.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <sys/wait.h>
+    #include <unistd.h>
+#endif
+
+#include "transport.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstring>
+#include <mutex>
+#include <signal.h>
+
+#ifdef __MINGW32__
+// Argument quoting is non trivial on Windows: we need to take care of character
+// escaping, and better only add quotes when it is actually needed. Adopted from
+// <https://docs.microsoft.com/en-gb/archive/blogs/twistylittlepassagesallalike/everyone-quotes-command-line-arguments-the-wrong-way>
+static std::string argvQuote(std::string_view arg)
+{
+    std::string cmdline;
+
+    // Don't quote unless we actually need to do so -- hopefully
+    // avoid problems if programs won't parse quotes properly
+    if (!arg.empty() && arg.find_first_of(" \t\n\v\"") == arg.npos)
+        cmdline = arg;
+    else {
+        cmdline.push_back('"');
+
+        for (auto it = arg.begin();; ++it) {
+            unsigned numBlackslashes = 0;
+
+            while (it != arg.end() && *it == '\\') {
+                ++it;
+                ++numBlackslashes;
+            }
+
+            // Escape all backslashes, but let the terminating double quotation
+            // mark we add below be interpreted as a metacharacter.
+            if (it == arg.end()) {
+                cmdline.append(numBlackslashes * 2, '\\');
+                break;
+            }
+            // Escape all backslashes and the following double quotation mark.
+            else if (*it == '"')
+                cmdline.append(numBlackslashes * 2 + 1, '\\').push_back(*it);
+            // Backslashes aren't special here.
+            else
+                cmdline.append(numBlackslashes, '\\').push_back(*it);
+        }
+
+        cmdline.push_back('"');
+    }
+
+    return cmdline;  // NRVO
+}
+#endif
+
+std::string transport_read_token(const char *fileName)
+{
+    FILE       *in;
+    std::string token;
+
+    DIE_IF(0, !(in = fopen(fileName, "r" FOPEN_TEXT)));
+    string_getline(token, in);
+    DIE_IF(0, fclose(in) < 0);
+
+    if (token.empty())
+        DIE("no token in file '%s'\n", fileName);
+
+    return token;
+}
+
+void transport_parse_cmd(const char               *cmd,
+                         std::string              &cwd,
+                         std::string              &run,
+                         std::vector<std::string> &args)
+{
+    // Isolate the first token being the command to run.
+    std::string token;
+
+    // Read a token from source string, returns pointer to the tail string.
+    auto readToken = [&token](const char *src) {
+        if (*src == '"') {
+            // Argument with spaces is assumed to be (esacped) quoted
+            const char *next = string_tok_esc(token, src, '"', '\\');
+            // Skip next space between argv[i] and argv[i+1]
+            return next + (next && *next == ' ');
+        }
+        else
+            return string_tok_esc(token, src, ' ', '\\');
+    };
+
+    // Read argv[0] (engine path)
+    const char *tail = readToken(cmd);
+
+    // Split token into (cwd, run). Possible cases:
+    // (a) unqualified path, like "demolito" (which evecvp() will search in PATH)
+    // (b) qualified path (absolute starting with "/", or relative starting with "./" or
+    // "../") For (b), we want to separate into executable and directory, so instead of
+    // running
+    // "../Engines/demolito" from the cwd, we execute run="./demolito" from
+    // cwd="../Engines"
+    cwd                   = "./";
+    run                   = token;
+    const char *lastSlash = strrchr(token.c_str(), '/');
+
+    if (lastSlash) {
+        cwd = std::string(token, 0, (size_t)(lastSlash - token.c_str()));
+        run = format("./%s", lastSlash + 1);
+    }
+
+    // Collect the arguments into a vec of string, args[]
+    args.push_back(run);  // argv[0] is the executed command
+
+    while ((tail = readToken(tail)))
+        args.push_back(token);
+}
+
+PipeTransport::PipeTransport(int id)
+    : threadId(id)
+    , in(nullptr)
+    , out(nullptr)
+    , pid(0)
+    , cgroup(id)
+{}
+
+PipeTransport::~PipeTransport()
+{
+    if (pid)
+        terminate(true, 0);
+}
+
+void PipeTransport::spawn(const char *cmd, bool readStdErr)
+{
+    // Parse cmd into (cwd, run, args): we want to execute run from cwd with args.
+    std::string              cwd, run;
+    std::vector<std::string> args;
+    transport_parse_cmd(cmd, cwd, run, args);
+
+    // execvp() needs NULL terminated char **, not vec of string. Prepare a char **, whose
+    // elements point to the C-string buffers of the elements of args, with the required
+    // NULL at the end.
+    char **argv = new char *[args.size() + 1] { nullptr };
+
+    for (size_t i = 0; i < args.size(); i++) {
+        argv[i] = args[i].data();
+    }
+
+    // Put the engine in its own cgroup, if it runs under a cpu quota
+    if (cpuQuota > 0)
+        cgroup.create(cpuQuota);
+
+    // Spawn child process and plug pipes
+    spawn_argv(cwd.c_str(), run.c_str(), argv, readStdErr);
+
+    delete[] argv;
+}
+
+void PipeTransport::spawn_argv(const char *cwd,
+                               const char *run,
+                               char      **argv,
+                               bool        readStdErr)
+{
+    assert(argv[0]);
+
+#ifdef __MINGW32__
+    // Setup the global job handle and job info, then bind parent process to it.
+    // (This will only be called once)
+    [[maybe_unused]] static HANDLE handleJob = [this]() {
+        HANDLE hJob = CreateJobObject(NULL, NULL);
+        DIE_IF(threadId, !hJob);
+
+        JOBOBJECT_BASIC_LIMIT_INFORMATION    jobBasicInfo;
+        JOBOBJECT_EXTENDED_LIMIT_INFORMATION jobExtendedInfo;
+        ZeroMemory(&jobBasicInfo, sizeof(JOBOBJECT_BASIC_LIMIT_INFORMATION));
+        ZeroMemory(&jobExtendedInfo, sizeof(JOBOBJECT_EXTENDED_LIMIT_INFORMATION));
+
+        jobBasicInfo.LimitFlags               = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+        jobExtendedInfo.BasicLimitInformation = jobBasicInfo;
+        DIE_IF(threadId,
+               !SetInformationJobObject(hJob,
+                                        JobObjectExtendedLimitInformation,
+                                        &jobExtendedInfo,
+                                        sizeof(JOBOBJECT_EXTENDED_LIMIT_INFORMATION)));
+
+        DIE_IF(threadId, !AssignProcessToJobObject(hJob, GetCurrentProcess()));
+        return hJob;
+    }();
+
+    // Setup structs needed to create process
+    SECURITY_ATTRIBUTES saAttr;
+    saAttr.nLength              = sizeof(SECURITY_ATTRIBUTES);
+    saAttr.bInheritHandle       = TRUE;
+    saAttr.lpSecurityDescriptor = NULL;
+    PROCESS_INFORMATION piProcInfo;
+    STARTUPINFOA        siStartInfo;
+    ZeroMemory(&piProcInfo, sizeof(PROCESS_INFORMATION));
+    ZeroMemory(&siStartInfo, sizeof(STARTUPINFOA));
+    siStartInfo.cb = sizeof(STARTUPINFOA);
+    siStartInfo.dwFlags |= STARTF_USESTDHANDLES;
+
+    // Construct full commandline using run and argv
+    std::string fullrun, fullcmd;
+    fullrun = format("%s%s", cwd, run + 1);  // we need an path relative to the cli
+
+    // Note: all arguments in argv needs to quoted
+    // Use an absolute path for engine argv[0]
+    char absPathBuf[4096];
+    DIE_IF(threadId,
+           !GetFullPathNameA(fullrun.c_str(), sizeof(absPathBuf), absPathBuf, nullptr));
+
+    fullcmd = argvQuote(absPathBuf);
+    for (size_t i = 1; argv[i]; i++)  // argv[0] == run
+        fullcmd += format(" %s", argvQuote(argv[i]));
+
+    // Pipe handler: read=0, write=1
+    HANDLE p_stdin[2], p_stdout[2];
+
+    // Process and pipe creation should be sequential to avoid handle inheritance bug
+    static std::mutex mtx;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        // Create a pipe for child process's STDOUT
+        DIE_IF(threadId, !CreatePipe(&p_stdout[0], &p_stdout[1], &saAttr, 0));
+        DIE_IF(threadId, !SetHandleInformation(p_stdout[0], HANDLE_FLAG_INHERIT, 0));
+
+        // Create a pipe for child process's STDIN
+        DIE_IF(threadId, !CreatePipe(&p_stdin[0], &p_stdin[1], &saAttr, 0));
+        DIE_IF(threadId, !SetHandleInformation(p_stdin[1], HANDLE_FLAG_INHERIT, 0));
+
+        // Create the child process
+        siStartInfo.hStdOutput = p_stdout[1];
+        siStartInfo.hStdInput  = p_stdin[0];
+        if (readStdErr) {
+            HANDLE p_stderr;
+            DIE_IF(threadId,
+                   !DuplicateHandle(GetCurrentProcess(),
+                                    p_stdout[1],
+                                    GetCurrentProcess(),
+                                    &p_stderr,
+                                    0,
+                                    TRUE,
+                                    DUPLICATE_SAME_ACCESS));
+            siStartInfo.hStdError = p_stderr;
+        }
+
+        const int flag = CREATE_NO_WINDOW | BELOW_NORMAL_PRIORITY_CLASS;
+        if (!CreateProcessA(fullrun.c_str(),  // application name
+                            fullcmd.data(),   // command line (non-const)
+                            nullptr,          // process security attributes
+                            nullptr,          // primary thread security attributes
+                            true,             // handles are inherited
+                            flag,             // creation flags
+                            nullptr,          // use parent's environment
+                            cwd,              // child process's current directory
+                            &siStartInfo,     // STARTUPINFO pointer
+                            &piProcInfo       // receives PROCESS_INFORMATION
+                            )) {
+            // Give a more elaborated error report on wrong engine path
+            DIE_OR_ERR(false, "[%d] failed to load engine \"%s\"\n", threadId, run);
+            DIE_IF(threadId, true);  // extra error message from OS
+        }
+
+        // Close handles to the stdin and stdout pipes no longer needed
+        DIE_IF(threadId, !CloseHandle(p_stdin[0]));
+        DIE_IF(threadId, !CloseHandle(p_stdout[1]));
+    }
+
+    // Keep the handle to the child process
+    this->pid      = piProcInfo.dwProcessId;
+    this->hProcess = piProcInfo.hProcess;
+    // Close the handle to the child's primary thread
+    DIE_IF(threadId, !CloseHandle(piProcInfo.hThread));
+
+    // Reopen stdin and stdout pipes using C style FILE
+    int stdin_fd  = _open_osfhandle((intptr_t)p_stdin[1], _O_TEXT);
+    int stdout_fd = _open_osfhandle((intptr_t)p_stdout[0], _O_TEXT);
+    DIE_IF(threadId, stdin_fd == -1);
+    DIE_IF(threadId, stdout_fd == -1);
+    DIE_IF(threadId, !(this->in = _fdopen(stdout_fd, "r")));
+    DIE_IF(threadId, !(this->out = _fdopen(stdin_fd, "w")));
+
+    // Bind child process to the global job, so child process is killed when
+    // parent process exits. (This is not needed actually, when parent process
+    // already belongs to one job, all subprocesses it creates will automatically
+    // be binded to the job by default).
+    // DIE_IF(threadId, !AssignProcessToJobObject(handleJob, this->hProcess));
+#else
+    // Pipe diagram: Parent -> [1]into[0] -> Child -> [1]outof[0] -> Parent
+    // 'into' and 'outof' are pipes, each with 2 ends: read=0, write=1
+    int outof[2] = {0}, into[2] = {0};
+
+    #ifdef __linux__
+    DIE_IF(threadId, pipe2(outof, O_CLOEXEC) < 0);
+    DIE_IF(threadId, pipe2(into, O_CLOEXEC) < 0);
+    #else
+    DIE_IF(threadId, pipe(outof) < 0);
+    DIE_IF(threadId, pipe(into) < 0);
+    #endif
+
+    DIE_IF(threadId, (this->pid = fork()) < 0);
+
+    if (this->pid == 0) {
+    #ifdef __linux__
+        prctl(PR_SET_PDEATHSIG, SIGHUP);  // delegate zombie purge to the kernel
+    #endif
+        cgroup.attach_self();
+
+        // We ignore SIGPIPE, the engine should not inherit that
+        signal(SIGPIPE, SIG_DFL);
+
+        // Plug stdin and stdout
+        DIE_IF(threadId, dup2(into[0], STDIN_FILENO) < 0);
+        DIE_IF(threadId, dup2(outof[1], STDOUT_FILENO) < 0);
+
+        // For stderr we have 2 choices:
+        // - readStdErr=true: dump it into stdout, like doing '2>&1' in bash. This is
+        // useful, if we want to see error messages from engines in their respective log
+        // file (notably assert() writes to stderr). Of course, such error messages should
+        // not be UCI commands, otherwise we will be fooled into parsing them as such.
+        // - readStdErr=false: do nothing, which means stderr is inherited from the parent
+        // process. Typcically, this means all engines write their error messages to the
+        // terminal (unless redirected otherwise).
+        if (readStdErr)
+            DIE_IF(threadId, dup2(outof[1], STDERR_FILENO) < 0);
+
+    #ifndef __linux__
+        // Ugly (and slow) workaround for non-Linux POSIX systems that lack the ability to
+        // atomically set O_CLOEXEC when creating pipes.
+        for (int fd = 3; fd < sysconf(FOPEN_MAX); close(fd++))
+            ;
+    #endif
+
+        // Set cwd as current directory, and execute run with argv[]
+        DIE_IF(threadId, chdir(cwd) < 0);
+        DIE_IF(threadId, execvp(run, argv) < 0);
+    }
+    else {
+        assert(this->pid > 0);
+
+        // in the parent process
+        DIE_IF(threadId, close(into[0]) < 0);
+        DIE_IF(threadId, close(outof[1]) < 0);
+
+        DIE_IF(threadId, !(this->in = fdopen(outof[0], "r")));
+        DIE_IF(threadId, !(this->out = fdopen(into[1], "w")));
+    }
+#endif
+}
+
+void PipeTransport::terminate(bool force, int64_t waitTime)
+{
+    if (!pid)
+        return;
+
+#ifdef __MINGW32__
+    // On windows, wait for waitTime milliseconds, then force terminate child process if
+    // it fails to exit in time
+    DWORD result = WaitForSingleObject(hProcess, force ? 0 : waitTime);
+    DIE_IF(threadId, result == WAIT_FAILED);
+    if (result == WAIT_TIMEOUT)
+        DIE_IF(threadId, !TerminateProcess(hProcess, 0));
+    DIE_IF(threadId, !CloseHandle(hProcess));
+#else
+    (void)waitTime;
+
+    if (force) {
+        if (waitpid(pid, NULL, WNOHANG) == 0)
+            DIE_IF(threadId, kill(pid, SIGTERM) < 0);
+        cgroup.kill();
+    }
+    else {
+        // On unix/linux, wait until deadline
+        waitpid(pid, NULL, 0);
+        cgroup.destroy();
+    }
+#endif
+
+    if (in)
+        DIE_IF(threadId, fclose(in) < 0);
+    if (out)
+        DIE_IF(threadId, fclose(out) < 0);
+
+    // Reset pid, in, out
+    pid = 0;
+    in = out = nullptr;
+}
+
+bool PipeTransport::readln(std::string &line, int64_t &stamp)
+{
+    if (!string_getline(line, in))
+        return false;
+
+    stamp = system_msec();
+    return true;
+}
+
+bool PipeTransport::input_ready() const
+{
+#ifdef __MINGW32__
+    return true;
+#else
+    // Peek one character without blocking: it comes from the stdio buffer if there are
+    // lines left in it, otherwise from the pipe, which is only non-blocking meanwhile
+    const int fd    = fileno(in);
+    const int flags = fcntl(fd, F_GETFL);
+    DIE_IF(threadId, flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0);
+
+    const int  c     = getc(in);
+    const bool ready = c != EOF || feof(in);
+
+    if (c != EOF)
+        ungetc(c, in);
+    else if (!ready)
+        clearerr(in);  // EAGAIN: nothing to read yet
+
+    DIE_IF(threadId, fcntl(fd, F_SETFL, flags) < 0);
+    return ready;
+#endif
+}
+
+bool PipeTransport::writeln(const char *buf)
+{
+    DIE_IF(threadId, fputs(buf, out) < 0);
+    DIE_IF(threadId, fputc('\n', out) < 0);
+
+    // We take fflush error as engine crashed signal
+    return fflush(out) >= 0;
+}
+
+void PipeTransport::close_channel()
+{
+    DIE_IF(threadId, fclose(in) < 0);
+    DIE_IF(threadId, fclose(out) < 0);
+    in = out = nullptr;
+}
+
+#ifndef __MINGW32__
+// Wire protocol between TcpTransport and engine-host is line based. Commands sent to the
+// host:
+//   AUTH <token>           shared secret, sent first if the host requires one, which
+//                          answers DENIED and hangs up if it does not match
+//   PING <msec>            clock probe, answered by PONG <msec> <host_msec>
+//   QUOTA <cores>          run the next engine under a cpu quota
+//   SPAWN <0|1> <cmd>      start engine (1: merge its stderr), answered by SPAWNED, or
+//                          by DENIED if cmd is outside the engine directory of the host
+//   ><line>                forward line to engine stdin
+// Messages received from the host:
+//   <<host_msec> <line>    line read from engine stdout, stamped with host clock
+//   ALIVE <host_msec>      keepalive, sent when the connection is otherwise idle
+//   EXIT                   engine process exited (crash, unless asked to quit)
+// Closing the connection kills the remote engine.
+
+TcpTransport::TcpTransport(int                id,
+                           const char        *addr,
+                           const std::string &secret,
+                           int64_t            timeoutMsec)
+    : threadId(id)
+    , address(addr)
+    , token(secret)
+    , timeout(timeoutMsec)
+    , sock(-1)
+    , in(nullptr)
+    , out(nullptr)
+    , running(false)
+    , clockOffset(0)
+    , rtt(0)
+{}
+
+TcpTransport::~TcpTransport()
+{
+    if (running)
+        terminate(true, 0);
+}
+
+static void socket_set_timeout(int threadId, int sock, int64_t msec)
+{
+    const struct timeval tv = {.tv_sec  = (time_t)(msec / 1000),
+                               .tv_usec = (suseconds_t)(msec % 1000 * 1000)};
+    DIE_IF(threadId, setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0);
+    DIE_IF(threadId, setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) < 0);
+}
+
+void TcpTransport::connect_host()
+{
+    // Split address into host and port
+    std::string  host = address, port = ENGINE_HOST_PORT;
+    const size_t colon = address.rfind(':');
+
+    if (colon != std::string::npos) {
+        host = address.substr(0, colon);
+        port = address.substr(colon + 1);
+    }
+
+    struct addrinfo hints = {}, *res = nullptr;
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if (int err = getaddrinfo(host.c_str(), port.c_str(), &hints, &res))
+        DIE("[%d] cannot resolve engine host '%s': %s\n",
+            threadId,
+            address.c_str(),
+            gai_strerror(err));
+
+    for (struct addrinfo *ai = res; ai && sock < 0; ai = ai->ai_next) {
+        if ((sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0)
+            continue;
+
+        // Engines spawned by other workers must not inherit the connection
+        DIE_IF(threadId, fcntl(sock, F_SETFD, FD_CLOEXEC) < 0);
+        socket_set_timeout(threadId, sock, timeout);
+
+        if (connect(sock, ai->ai_addr, ai->ai_addrlen) < 0) {
+            close(sock);
+            sock = -1;
+        }
+    }
+
+    freeaddrinfo(res);
+
+    if (sock < 0)
+        DIE("[%d] cannot connect to engine host '%s': %s\n",
+            threadId,
+            address.c_str(),
+            strerror(errno));
+
+    // Moves are single short lines: send them right away. Keepalive lets the kernel
+    // notice a dead peer even when no engine output is expected.
+    const int one = 1;
+    DIE_IF(threadId, setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) < 0);
+    DIE_IF(threadId, setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one)) < 0);
+
+    int sockOut;
+    DIE_IF(threadId, (sockOut = fcntl(sock, F_DUPFD_CLOEXEC, 0)) < 0);
+    DIE_IF(threadId, !(in = fdopen(sock, "r")));
+    DIE_IF(threadId, !(out = fdopen(sockOut, "w")));
+}
+
+// Reads a control message from the host, skipping keepalives. Returns false on EOF.
+bool TcpTransport::read_control(std::string &line)
+{
+    do {
+        if (!string_getline(line, in))
+            return false;
+    } while (string_prefix(line.c_str(), "ALIVE"));
+
+    return true;
+}
+
+// Estimate round trip time and host clock offset, keeping the probe with the smallest
+// round trip time (Cristian's algorithm).
+void TcpTransport::sync_clock()
+{
+    std::string line;
+    rtt = INT64_MAX;
+
+    for (int i = 0; i < 4; i++) {
+        const int64_t sent = system_msec();
+        DIE_IF(threadId, fprintf(out, "PING %" PRId64 "\n", sent) < 0 || fflush(out) < 0);
+
+        long long echo = 0, hostTime = 0;
+
+        do {
+            if (!read_control(line))
+                DIE("[%d] engine host '%s' closed connection during handshake\n",
+                    threadId,
+                    address.c_str());
+
+            if (line == "DENIED")
+                DIE("[%d] engine host '%s' refused the token\n",
+                    threadId,
+                    address.c_str());
+        } while (sscanf(line.c_str(), "PONG %lld %lld", &echo, &hostTime) != 2
+                 || echo != sent);
+
+        const int64_t received = system_msec();
+
+        if (received - sent < rtt) {
+            rtt         = received - sent;
+            clockOffset = hostTime - (sent + rtt / 2);
+        }
+    }
+}
+
+void TcpTransport::spawn(const char *cmd, bool readStdErr)
+{
+    connect_host();
+
+    if (!token.empty())
+        DIE_IF(threadId, fprintf(out, "AUTH %s\n", token.c_str()) < 0);
+
+    sync_clock();
+
+    if (cpuQuota > 0)
+        DIE_IF(threadId, fprintf(out, "QUOTA %g\n", cpuQuota) < 0);
+
+    DIE_IF(threadId,
+           fprintf(out, "SPAWN %d %s\n", readStdErr, cmd) < 0 || fflush(out) < 0);
+
+    std::string line;
+
+    if (!read_control(line) || line != "SPAWNED")
+        DIE("[%d] engine host '%s' failed to start engine '%s'\n",
+            threadId,
+            address.c_str(),
+            cmd);
+
+    // Engine I/O is guarded by worker deadlines, not by socket timeouts
+    socket_set_timeout(threadId, sock, 0);
+    running = true;
+}
+
+void TcpTransport::terminate(bool force, int64_t waitTime)
+{
+    if (!running)
+        return;
+
+    if (force) {
+        // Unblocks a concurrent readln(). The host kills the engine as the connection
+        // drops.
+        shutdown(sock, SHUT_RDWR);
+    }
+    else if (in) {
+        // Wait for the host to report engine exit, within waitTime
+        std::string line;
+        socket_set_timeout(threadId, sock, std::max<int64_t>(waitTime, 1));
+
+        while (string_getline(line, in) && line != "EXIT")
+            ;
+    }
+
+    if (in)
+        DIE_IF(threadId, fclose(in) < 0);
+    if (out)
+        DIE_IF(threadId, fclose(out) < 0);
+
+    running = false;
+    in = out = nullptr;
+    sock     = -1;
+}
+
+bool TcpTransport::readln(std::string &line, int64_t &stamp)
+{
+    while (read_control(line)) {
+        if (line[0] == '<') {
+            char     *tail     = nullptr;
+            const int64_t host = strtoll(line.c_str() + 1, &tail, 10);
+
+            // Translate host timestamp to local clock, so that network delay on the way
+            // back is not charged to the engine
+            stamp = std::min(host - clockOffset, system_msec());
+            line.erase(0, tail - line.c_str() + (*tail == ' '));
+            return true;
+        }
+        else if (line == "EXIT")
+            return false;  // engine exited on its own
+    }
+
+    return false;
+}
+
+bool TcpTransport::writeln(const char *buf)
+{
+    DIE_IF(threadId, fputc('>', out) < 0);
+    DIE_IF(threadId, fputs(buf, out) < 0);
+    DIE_IF(threadId, fputc('\n', out) < 0);
+
+    return fflush(out) >= 0;
+}
+
+void TcpTransport::close_channel()
+{
+    DIE_IF(threadId, fclose(in) < 0);
+    DIE_IF(threadId, fclose(out) < 0);
+    in = out = nullptr;
+    sock     = -1;
+}
+#endif
@@ -0,0 +1,157 @@
+/*
+ *  c-gomoku-cli, a command line interface for Gomocup engines. Copyright 2021 Chao Ma.
+ *  c-gomoku-cli is derived from c-chess-cli, originally authored by lucasart 2020.
+ *
+ *  c-gomoku-cli is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ *  c-gomoku-cli is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include "cgroup.h"
+
+#ifndef __MINGW32__
+    #include <sys/types.h>
+#endif
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Default TCP port of engine-host
+#define ENGINE_HOST_PORT "5150"
+
+// Transport: line based channel to an engine process. Engine speaks Gomocup protocol
+// through it, regardless of whether the process is a local child or a remote one.
+class Transport
+{
+public:
+    virtual ~Transport() = default;
+
+    // Start the engine process described by cmd (see README for the cmd syntax). If
+    // readStdErr is set, the engine's stderr is merged into its stdout.
+    virtual void spawn(const char *cmd, bool readStdErr) = 0;
+
+    // Reap the engine process and close the channel. When force is false, the engine
+    // has been told to quit and is granted waitTime msec to do so, otherwise it is
+    // killed right away. Force terminate may be called from another thread, while the
+    // owner thread is blocked in readln().
+    virtual void terminate(bool force, int64_t waitTime) = 0;
+
+    // Read one line. stamp receives the local time (msec) at which the engine produced
+    // it. Returns false on EOF.
+    virtual bool readln(std::string &line, int64_t &stamp) = 0;
+
+    // Write one line. Returns false when the channel is broken.
+    virtual bool writeln(const char *buf) = 0;
+
+    // Close the channel after an I/O failure, which flags the engine as crashed
+    virtual void close_channel() = 0;
+
+    virtual bool is_running() const   = 0;  // process spawned and not yet reaped
+    virtual bool is_connected() const = 0;  // channel still open
+
+    // Returns true when engine output or EOF is pending, so that readln() would not
+    // block for long, or when the transport can not tell. Lines already buffered count.
+    // Must not run concurrently with terminate(), which closes the channel.
+    virtual bool input_ready() const { return true; }
+
+    // One-way latency (msec) for a line to reach the engine
+    virtual int64_t send_delay() const { return 0; }
+
+    // Limit the engine to 'quota' cores (0 for no limit). Applies to the next spawn().
+    void set_cpu_quota(double quota) { cpuQuota = quota; }
+
+protected:
+    double cpuQuota = 0;
+};
+
+// Local child process, plugged through pipes
+class PipeTransport : public Transport
+{
+public:
+    explicit PipeTransport(int threadId);
+    ~PipeTransport() override;
+
+    void spawn(const char *cmd, bool readStdErr) override;
+    void terminate(bool force, int64_t waitTime) override;
+    bool readln(std::string &line, int64_t &stamp) override;
+    bool writeln(const char *buf) override;
+    void close_channel() override;
+
+    bool is_running() const override { return pid != 0; }
+    bool is_connected() const override { return in && out; }
+    bool input_ready() const override;
+
+private:
+    const int threadId;
+    FILE     *in, *out;
+
+#ifdef __MINGW32__
+    long  pid;
+    void *hProcess;
+#else
+    pid_t pid;
+#endif
+
+    CpuGroup cgroup;  // engine cgroup, when running under a cpu quota
+
+    void spawn_argv(const char *cwd, const char *run, char **argv, bool readStdErr);
+};
+
+#ifndef __MINGW32__
+// Remote process, started by engine-host on another machine and relayed over TCP
+class TcpTransport : public Transport
+{
+public:
+    TcpTransport(int                threadId,
+                 const char        *address,
+                 const std::string &token,
+                 int64_t            timeout);
+    ~TcpTransport() override;
+
+    void spawn(const char *cmd, bool readStdErr) override;
+    void terminate(bool force, int64_t waitTime) override;
+    bool readln(std::string &line, int64_t &stamp) override;
+    bool writeln(const char *buf) override;
+    void close_channel() override;
+
+    bool    is_running() const override { return running; }
+    bool    is_connected() const override { return in && out; }
+    int64_t send_delay() const override { return rtt / 2; }
+
+private:
+    const int         threadId;
+    const std::string address;  // "host:port"
+    const std::string token;    // shared secret of engine-host, empty if none
+    const int64_t     timeout;  // msec allowed for connection and handshake
+    int               sock;
+    FILE             *in, *out;
+    bool              running;
+    int64_t           clockOffset;  // host clock - local clock (msec)
+    int64_t           rtt;          // round trip time (msec)
+
+    void connect_host();
+    void sync_clock();
+    bool read_control(std::string &line);
+};
+#endif
+
+// Read the shared secret of engine-host: the first line of 'fileName', which is kept out
+// of command lines (visible to all users of a machine)
+std::string transport_read_token(const char *fileName);
+
+// Split cmd into (cwd, run, args): we want to execute run from cwd with args, where
+// args[0] is run itself.
+void transport_parse_cmd(const char               *cmd,
+                         std::string              &cwd,
+                         std::string              &run,
+                         std::vector<std::string> &args);
@@ -23,6 +23,9 @@
 #include <ctime>
 #ifdef __MINGW32__
     #include <Windows.h>
+    #include <io.h>
+#else
+    #include <unistd.h>
 #endif
 #include "util.h"
 
@@ -72,6 +75,18 @@ FileLock::~FileLock()
 #endif
 }
 
+bool file_sync(FILE *f)
+{
+    if (fflush(f) != 0)
+        return false;
+
+#ifdef __MINGW32__
+    return _commit(_fileno(f)) == 0;
+#else
+    return fsync(fileno(f)) == 0;
+#endif
+}
+
 [[noreturn]] void die_errno(const int threadId, const char *fileName, int line)
 {
 #ifdef __MINGW32__
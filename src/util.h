@@ -34,6 +34,9 @@ struct FileLock
     ~FileLock();
 };
 
+// Flush file 'f', and its data to stable storage. Returns false on error.
+bool file_sync(FILE *f);
+
 #define DIE_OR_ERR(die, ...)          \
     do {                              \
         FileLock flOutErr(stdout);    \
@@ -2,10 +2,18 @@
 
 #include "util.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
 
-Worker::Worker(int i, const char *logName) : id(i + 1), seed(i), log(nullptr)
+Worker::Worker(int i, const char *logName, StartupGovernor *startup, DeadlineService *ds)
+    : id(i + 1)
+    , seed(i)
+    , log(nullptr)
+    , governor(startup)
+    , deadlines(ds)
+    , starting(0)
+    , startupWait(0)
 {
     if (*logName) {
         log = fopen(logName, "w" FOPEN_TEXT);
@@ -27,10 +35,12 @@ void Worker::deadline_set(const char           *engineName,
                           std::function<void()> callback)
 {
     assert(timeLimit > 0);
+    uint64_t generation;
 
     {
         std::lock_guard lock(deadline.mtx);
 
+        generation           = ++deadline.generation;
         deadline.set         = true;
         deadline.called      = false;
         deadline.engineName  = engineName;
@@ -39,6 +49,9 @@ void Worker::deadline_set(const char           *engineName,
         deadline.callback    = callback;
     }
 
+    if (deadlines)
+        deadlines->schedule(this, timeLimit, generation);
+
     if (log)
         DIE_IF(id,
                fprintf(log,
@@ -65,42 +78,252 @@ void Worker::deadline_clear()
                    < 0);
 }
 
-void Worker::deadline_callback_once()
+// Returns true if the callback was fired by this call
+bool Worker::deadline_callback_once(uint64_t generation)
 {
     std::lock_guard lock(deadline.mtx);
 
-    if (deadline.set && !deadline.called) {
-        deadline.called = true;
-        if (deadline.callback)
-            deadline.callback();
-
-        if (log) {
-            DIE_IF(id,
-                   fprintf(log,
-                           "deadline: %s exceeded [%s] after %" PRId64 "\n",
-                           deadline.engineName.c_str(),
-                           deadline.description.c_str(),
-                           deadline.timeLimit)
-                       < 0);
-            fflush(log);
-        }
+    if (!deadline.set || deadline.generation != generation || deadline.called)
+        return false;
+
+    deadline.called = true;
+    if (deadline.callback)
+        deadline.callback();
+
+    if (log) {
+        DIE_IF(id,
+               fprintf(log,
+                       "deadline: %s exceeded [%s] after %" PRId64 "\n",
+                       deadline.engineName.c_str(),
+                       deadline.description.c_str(),
+                       deadline.timeLimit)
+                   < 0);
+        fflush(log);
     }
+
+    return true;
 }
 
-int64_t Worker::deadline_overdue()
+// Returns how late the deadline is, with a copy of its details: they may be set again by
+// the worker as soon as the lock is released
+int64_t Worker::deadline_overdue(uint64_t     generation,
+                                 std::string &engineName,
+                                 std::string &description,
+                                 int64_t     &timeLimit)
 {
     const int64_t time = system_msec();
 
     std::lock_guard lock(deadline.mtx);
 
-    if (deadline.set && time > deadline.timeLimit)
-        return time - deadline.timeLimit;
-    else
+    if (!deadline.set || deadline.generation != generation || time <= deadline.timeLimit)
         return 0;
+
+    engineName  = deadline.engineName;
+    description = deadline.description;
+    timeLimit   = deadline.timeLimit;
+    return time - deadline.timeLimit;
 }
 
 void Worker::wait_callback_done()
 {
     deadline.mtx.lock();
     deadline.mtx.unlock();
-}
\ No newline at end of file
+}
+
+int64_t Worker::startup_enter()
+{
+    if (governor && starting++ == 0)
+        startupWait = governor->acquire();
+
+    return startupWait;
+}
+
+void Worker::startup_leave()
+{
+    assert(!governor || starting > 0);
+
+    if (governor && --starting == 0)
+        governor->release();
+}
+
+DeadlineService::DeadlineService() : stopping(false), thread(&DeadlineService::run, this)
+{}
+
+DeadlineService::~DeadlineService()
+{
+    {
+        std::lock_guard lock(mtx);
+        stopping = true;
+    }
+
+    cv.notify_one();
+
+    // An unresponsive engine makes the service thread itself exit the program
+    if (thread.get_id() == std::this_thread::get_id())
+        thread.detach();
+    else
+        thread.join();
+}
+
+void DeadlineService::schedule(Worker *w, int64_t timeLimit, uint64_t generation)
+{
+    bool nearest;
+
+    {
+        std::lock_guard lock(mtx);
+        heap.push({.time = timeLimit, .w = w, .generation = generation});
+        nearest = heap.top().generation == generation && heap.top().w == w;
+    }
+
+    // Only a new nearest deadline changes what the service thread waits for
+    if (nearest)
+        cv.notify_one();
+}
+
+void DeadlineService::run()
+{
+    std::unique_lock lock(mtx);
+
+    while (!stopping) {
+        if (heap.empty()) {
+            cv.wait(lock);
+            continue;
+        }
+
+        // A deadline is overdue from the msec after its time limit
+        const int64_t wait = heap.top().time + 1 - system_msec();
+
+        if (wait > 0) {
+            cv.wait_for(lock, std::chrono::milliseconds(wait));
+            continue;
+        }
+
+        const Entry e = heap.top();
+        heap.pop();
+
+        lock.unlock();
+        expire(e);
+        lock.lock();
+    }
+}
+
+// Fire the callback of an overdue deadline, and check again later that the worker got
+// unstuck. Deadlines cleared or replaced since are not overdue.
+void DeadlineService::expire(const Entry &e)
+{
+    Worker       *w       = e.w;
+    std::string   engineName, description;
+    int64_t       timeLimit;
+    const int64_t overdue =
+        w->deadline_overdue(e.generation, engineName, description, timeLimit);
+
+    if (overdue <= 0)
+        return;
+
+    if (w->deadline_callback_once(e.generation))
+        schedule(w, e.time + UnresponsiveDelay, e.generation);
+    else if (overdue > UnresponsiveDelay) {
+        if (w->log)
+            fprintf(w->log,
+                    "deadline: %s is unresponsive [%s] after %" PRId64 "\n",
+                    engineName.c_str(),
+                    description.c_str(),
+                    timeLimit);
+
+        DIE("[%d] engine %s is unresponsive to [%s]\n",
+            w->id,
+            engineName.c_str(),
+            description.c_str());
+    }
+}
+
+StartupGovernor::StartupGovernor(int n) : maxStarting(n), starting(0) {}
+
+int64_t StartupGovernor::acquire()
+{
+    const int64_t start = system_msec();
+
+    std::unique_lock lock(mtx);
+    cv.wait(lock, [this] { return !maxStarting || starting < maxStarting; });
+    starting++;
+
+    return system_msec() - start;
+}
+
+void StartupGovernor::release()
+{
+    {
+        std::lock_guard lock(mtx);
+        starting--;
+    }
+
+    cv.notify_one();
+}
+
+CoreBudget::CoreBudget(int n, std::vector<int> c, std::vector<int> m)
+    : cores(n)
+    , costs(std::move(c))
+    , caps(std::move(m))
+    , playing(costs.size())
+    , used(0)
+    , nextTicket(0)
+{}
+
+// One of the engines plays as many games as its cap allows
+bool CoreBudget::capped(const int ei[2]) const
+{
+    for (int i = 0; i < 2; i++)
+        if (caps[ei[i]] && playing[ei[i]] >= caps[ei[i]])
+            return true;
+
+    return false;
+}
+
+bool CoreBudget::fits(const int ei[2]) const
+{
+    return !cores || !used || used + costs[ei[0]] + costs[ei[1]] <= cores;
+}
+
+int64_t CoreBudget::acquire(const int ei[2])
+{
+    const int64_t start = system_msec();
+
+    std::unique_lock lock(mtx);
+    const uint64_t   ticket = nextTicket++;
+    waiters.push_back({.ticket = ticket, .ei = {ei[0], ei[1]}});
+
+    // Go once the game fits, unless an earlier game is waiting for cores only
+    cv.wait(lock, [&] {
+        for (const Waiter &w : waiters) {
+            if (w.ticket == ticket)
+                return !capped(ei) && fits(ei);
+            if (!capped(w.ei))
+                return false;
+        }
+        return false;
+    });
+
+    waiters.erase(std::find_if(waiters.begin(), waiters.end(), [&](const Waiter &w) {
+        return w.ticket == ticket;
+    }));
+    used += costs[ei[0]] + costs[ei[1]];
+    playing[ei[0]]++;
+    playing[ei[1]]++;
+
+    // The next waiter may fit too
+    cv.notify_all();
+
+    return system_msec() - start;
+}
+
+void CoreBudget::release(const int ei[2])
+{
+    {
+        std::lock_guard lock(mtx);
+        used -= costs[ei[0]] + costs[ei[1]];
+        playing[ei[0]]--;
+        playing[ei[1]]--;
+    }
+
+    cv.notify_all();
+}
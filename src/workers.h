@@ -15,12 +15,109 @@
  */
 
 #pragma once
+#include <condition_variable>
+#include <cstdint>
 #include <cstdio>
 #include <functional>
 #include <mutex>
+#include <queue>
 #include <string>
+#include <thread>
 #include <vector>
 
+// Limits the number of workers starting engines (spawn, ABOUT and first START) at the
+// same time. Engines loading large files and allocating hash tables all at once would
+// otherwise miss their deadlines.
+class StartupGovernor
+{
+public:
+    explicit StartupGovernor(int maxStarting);
+
+    // Wait for a free startup slot, and return the time waited (msec)
+    int64_t acquire();
+    void    release();
+
+private:
+    std::mutex              mtx;
+    std::condition_variable cv;
+    const int               maxStarting;  // 0 for no limit
+    int                     starting;
+};
+
+// Core budget (-cores) and per engine caps on simultaneous games. A game costs the cores
+// of both its engines, and starts only while they are free (a game that costs more than
+// the whole budget starts alone). Games waiting for cores are served in arrival order,
+// so that costly games are not starved by cheap ones, but a game held back by an engine
+// cap lets the others by.
+class CoreBudget
+{
+public:
+    CoreBudget(int cores, std::vector<int> costs, std::vector<int> caps);
+
+    // Wait until engines ei[0] and ei[1] can play a game, and return the time waited
+    // (msec)
+    int64_t acquire(const int ei[2]);
+    void    release(const int ei[2]);
+
+private:
+    struct Waiter
+    {
+        uint64_t ticket;
+        int      ei[2];
+    };
+
+    std::mutex              mtx;
+    std::condition_variable cv;
+    const int               cores;  // 0 for no budget
+    const std::vector<int>  costs;  // [engine]: cores used by an instance
+    const std::vector<int>  caps;   // [engine]: max instances playing, 0 for no cap
+    std::vector<int>        playing;  // [engine]: instances playing
+    std::vector<Waiter>     waiters;  // in arrival order
+    int                     used;
+    uint64_t                nextTicket;
+
+    bool capped(const int ei[2]) const;
+    bool fits(const int ei[2]) const;
+};
+
+class Worker;
+
+// Enforces the deadlines of all workers from a thread of its own, which waits for the
+// nearest one only: deadlines are kept in a heap ordered by time limit, and entries of
+// deadlines cleared or replaced in the meantime are dropped as they come up. An overdue
+// deadline has its callback fired at once (typically killing the engine), and if the
+// worker is still stuck on it UnresponsiveDelay msec later, the engine is unresponsive
+// even to that, which is an unrecoverable error.
+class DeadlineService
+{
+public:
+    static constexpr int64_t UnresponsiveDelay = 3000;
+
+    DeadlineService();
+    ~DeadlineService();
+
+    void schedule(Worker *w, int64_t timeLimit, uint64_t generation);
+
+private:
+    struct Entry
+    {
+        int64_t  time;  // first msec at which the deadline is overdue
+        Worker  *w;
+        uint64_t generation;
+
+        bool operator>(const Entry &e) const { return time > e.time; }
+    };
+
+    std::mutex                                                         mtx;
+    std::condition_variable                                            cv;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+    bool                                                               stopping;
+    std::thread                                                        thread;
+
+    void run();
+    void expire(const Entry &e);
+};
+
 // Per thread data
 class Worker
 {
@@ -32,8 +129,9 @@ public:
         std::string           engineName;
         std::string           description;
         std::function<void()> callback;
-        bool                  set    = false;
-        bool                  called = false;
+        uint64_t              generation = 0;  // of the latest deadline set
+        bool                  set        = false;
+        bool                  called     = false;
     };
 
     const int  id;  // starts at 1 (0 is for main thread)
@@ -41,7 +139,10 @@ public:
     uint64_t   seed;  // seed for prng()
     FILE      *log;
 
-    Worker(int id, const char *logName);
+    Worker(int              id,
+           const char      *logName,
+           StartupGovernor *startup   = nullptr,
+           DeadlineService *deadlines = nullptr);
     ~Worker();
 
     void    deadline_set(const char           *engineName,
@@ -49,7 +150,23 @@ public:
                          const char           *description,
                          std::function<void()> callback = nullptr);
     void    deadline_clear();
-    void    deadline_callback_once();
-    int64_t deadline_overdue();
+    bool    deadline_callback_once(uint64_t generation);
+    int64_t deadline_overdue(uint64_t     generation,
+                             std::string &engineName,
+                             std::string &description,
+                             int64_t     &timeLimit);
     void    wait_callback_done();
+
+    // An engine of this worker enters (leaves) its startup phase. The worker holds one
+    // startup slot while any of its engines is starting, so that it never waits for a
+    // slot while holding one. Returns the time this worker waited for its slot.
+    int64_t startup_enter();
+    void    startup_leave();
+
+private:
+    StartupGovernor *const governor;
+    DeadlineService *const deadlines;
+    int                    starting;     // number of engines in their startup phase
+    int64_t                startupWait;  // time waited for the current startup slot
 };
+